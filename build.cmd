@@ -12,7 +12,7 @@ del /Q /F /S obj\* bin\%LIB_NAME%-%VERSION%.dll lib\lib%LIB_NAME%.a
 
 :: Make the library.
 
-@for %%m in (parse image tex utf8 error text) do (
+@for %%m in (parse binary image raster tex utf8 error text atlas bundle) do (
     %CXX% %CFLAGS% -I include\text-gl -c src\%%m.cpp -o obj\%%m.o -fPIC
 
     @if %ERRORLEVEL% neq 0 (
@@ -20,17 +20,47 @@ del /Q /F /S obj\* bin\%LIB_NAME%-%VERSION%.dll lib\lib%LIB_NAME%.a
     )
 )
 
-%CXX% obj\parse.o obj\image.o obj\tex.o obj\utf8.o obj\error.o obj\text.o -lxml2 -lcairo -lopengl32 ^
+%CXX% obj\parse.o obj\binary.o obj\image.o obj\raster.o obj\tex.o obj\utf8.o obj\error.o obj\text.o obj\atlas.o obj\bundle.o -lxml2 -lcairo -lz -lopengl32 ^
 -o bin\%LIB_NAME%-%VERSION%.dll -shared -fPIC -Wl,--out-implib,lib\lib%LIB_NAME%.a
 @if %ERRORLEVEL% neq 0 (
     goto end
 )
 
+:: Make the tools.
+
+%CXX% %CFLAGS% -I include tools\compile_font.cpp lib\lib%LIB_NAME%.a -o bin\compile_font.exe
+@if %ERRORLEVEL% neq 0 (
+    goto end
+)
+
+%CXX% %CFLAGS% -I include tools\bake_font.cpp lib\lib%LIB_NAME%.a -o bin\bake_font.exe
+@if %ERRORLEVEL% neq 0 (
+    goto end
+)
+
 :: Make the tests.
 
 %CXX% %CFLAGS% -I include -fexec-charset=UTF-8 tests\encoding.cpp lib\lib%LIB_NAME%.a ^
 -lboost_unit_test_framework -o bin\test_encoding.exe && bin\test_encoding.exe
 
+%CXX% %CFLAGS% -I include tests\binary.cpp lib\lib%LIB_NAME%.a ^
+-lboost_unit_test_framework -o bin\test_binary.exe && bin\test_binary.exe
+
+%CXX% %CFLAGS% -I include tests\parse.cpp lib\lib%LIB_NAME%.a ^
+-lboost_unit_test_framework -lz -o bin\test_parse.exe && bin\test_parse.exe
+
+%CXX% %CFLAGS% -I include tests\raster.cpp lib\lib%LIB_NAME%.a ^
+-lboost_unit_test_framework -o bin\test_raster.exe && bin\test_raster.exe
+
+%CXX% %CFLAGS% -I include tests\cache.cpp lib\lib%LIB_NAME%.a ^
+-lboost_unit_test_framework -o bin\test_cache.exe && bin\test_cache.exe
+
+%CXX% %CFLAGS% -I include tests\atlas.cpp lib\lib%LIB_NAME%.a ^
+-lboost_unit_test_framework -o bin\test_atlas.exe && bin\test_atlas.exe
+
+%CXX% %CFLAGS% -I include tests\text.cpp lib\lib%LIB_NAME%.a ^
+-lboost_unit_test_framework -lopengl32 -lmingw32 -lSDL2 -o bin\test_text.exe && bin\test_text.exe
+
 %CXX% %CFLAGS% -I include tests\visual.cpp lib\lib%LIB_NAME%.a ^
 -lxml2 -lcairo -lopengl32 -lglew32 -lmingw32 -lSDL2main -lSDL2 -o bin\test_visual.exe && bin\test_visual.exe data\sample1.svg
 
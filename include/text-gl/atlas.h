@@ -0,0 +1,221 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <list>
+#include <vector>
+
+#include "image.h"
+
+
+namespace TextGL
+{
+    struct AtlasParams
+    {
+        size_t maxWidth = 2048, maxHeight = 2048;  // of each atlas image
+
+        /**
+         *  Transparent pixels between the glyphs and along the edges, so that
+         *  filtering doesn't pick up pixels of the neighbouring glyphs.
+         */
+        size_t padding = 1;
+
+        /**
+         *  Leave out the fully transparent borders of the glyph images.
+         *  Without this, every glyph takes up the font's whole bounding box.
+         */
+        bool trim = true;
+    };
+
+    /**
+     *  Where the glyph's image is in the atlas. Rows are in the same order as in the glyph's image.
+     *  Glyphs that have no visible pixels, like spaces, get an empty rectangle.
+     */
+    struct AtlasRect
+    {
+        size_t image,  // index of the atlas image
+               x, y, width, height,  // in pixels, within the atlas image
+               offsetX, offsetY,  // where the rectangle starts within the glyph's own image
+               imageWidth, imageHeight;  // of the glyph's own image
+
+        float u0, v0, u1, v1;  // texture coordinates of the rectangle's corners
+    };
+
+    struct GlyphAtlasStats
+    {
+        size_t glyphCount,  // distinct images with visible pixels
+               imageCount,
+               glyphPixels,  // covered by glyph rectangles, without padding
+               atlasPixels;  // of all atlas images together
+    };
+
+    /**
+     *  The glyph images of a font, packed together into one or more larger images.
+     *  Doesn't need an OpenGL context, the images can be uploaded as textures later.
+     */
+    class GlyphAtlas
+    {
+        private:
+            std::vector<Image *> mImages;
+            std::vector<AtlasRect> mRects;  // one per distinct glyph image
+
+            std::unordered_map<UTF8Char, const AtlasRect *> mCharacterRects;
+            const AtlasRect *mMissingRect;  // NULL if the font has no missing glyph
+
+            GlyphAtlasStats mStats;
+
+            GlyphAtlas(void);
+            ~GlyphAtlas(void);
+
+            void operator=(const GlyphAtlas &) = delete;
+            GlyphAtlas(const GlyphAtlas &) = delete;
+        public:
+            size_t GetImageCount(void) const;
+            const Image *GetImage(const size_t index) const;
+
+            const AtlasRect *GetRect(const UTF8Char) const;
+
+            /**
+             *  Doesn't throw, returns the missing glyph's rectangle or NULL instead.
+             */
+            const AtlasRect *FindRect(const UTF8Char) const noexcept;
+
+            GlyphAtlasStats GetStats(void) const;
+
+        friend GlyphAtlas *MakeGlyphAtlas(const ImageFont *, const AtlasParams &);
+        friend void DestroyGlyphAtlas(GlyphAtlas *);
+        friend void MakeFontBundle(const ImageFont *, FontBundle &, const AtlasParams &);
+    };
+
+    /**
+     *  Packs the glyphs tallest first, with the skyline bottom-left method.
+     *  Characters that share a glyph image share the rectangle too.
+     *  When an atlas image is full, the next one is started. The width of the images is
+     *  a power of two, their height is only as large as needed.
+     *
+     *  A lazily rendered font renders all its glyphs for this, they're held beyond
+     *  the font's budget until the atlas is made. Then those beyond the budget are evicted,
+     *  but not freed: other threads may still use them, so that's left to FreeEvictedGlyphs.
+     *
+     *  Throws FontImageError if a glyph doesn't fit in an atlas image of the maximum size.
+     */
+    GlyphAtlas *MakeGlyphAtlas(const ImageFont *, const AtlasParams &params=AtlasParams());
+    void DestroyGlyphAtlas(GlyphAtlas *);
+
+    struct DynamicAtlasParams
+    {
+        size_t width = 1024, height = 1024;  // of each atlas image
+        size_t maxImageCount = 1;  // beyond that, glyphs are evicted
+        size_t padding = 1;
+    };
+
+    /**
+     *  A part of an atlas image that changed, to be uploaded again.
+     *  Rows are 'width' pixels apart in the atlas image's data.
+     */
+    struct AtlasDirtyRect
+    {
+        size_t image,
+               x, y, width, height;
+    };
+
+    struct DynamicAtlasStats
+    {
+        size_t hits, misses, evictions,
+               glyphCount, imageCount;  // currently in the atlas
+    };
+
+    class AtlasPage;
+
+    /**
+     *  An atlas that glyphs are put in when they're first used, for when the characters
+     *  aren't known in advance. Glyphs go on shelves of about their own height. When all
+     *  images are full, the glyphs that were used longest ago make room, but never those
+     *  that were used in the current frame.
+     *
+     *  The atlas images are kept on the CPU side. Changes are collected as dirty rectangles,
+     *  so that only those parts need to be uploaded again.
+     *
+     *  The font must outlive the atlas. Its glyphs are copied in, so a lazily rendered
+     *  font may have a small budget. Not safe to use from multiple threads at once.
+     */
+    class DynamicGlyphAtlas
+    {
+        private:
+            struct Entry
+            {
+                UTF8Char c;
+                bool missing;  // holds the missing glyph, instead of c's own
+                AtlasRect rect;
+                size_t lastFrame;
+            };
+
+            const ImageFont *mpFont;
+            DynamicAtlasParams mParams;
+
+            std::vector<AtlasPage *> mPages;
+            std::vector<AtlasDirtyRect> mDirtyRects;
+
+            std::list<Entry> mEntries;  // most recently used first
+            std::unordered_map<UTF8Char, std::list<Entry>::iterator> mCharacterEntries;
+            std::list<Entry>::iterator mMissingEntry;  // mEntries.end() if not in the atlas
+
+            size_t mFrame,
+                   mHits, mMisses, mEvictions;
+
+            void operator=(const DynamicGlyphAtlas &) = delete;
+            DynamicGlyphAtlas(const DynamicGlyphAtlas &) = delete;
+
+            void Insert(const ImageGlyph *, AtlasRect &);
+            void Evict(void);
+            void AddDirtyRect(const AtlasDirtyRect &);
+        public:
+            DynamicGlyphAtlas(const ImageFont *, const DynamicAtlasParams &params=DynamicAtlasParams());
+            ~DynamicGlyphAtlas(void);
+
+            /**
+             *  Puts the character's glyph in the atlas, if it isn't there yet. Falls back to the
+             *  missing glyph. returns NULL if the font has no missing glyph either.
+             *  The rectangle stays valid until a later frame evicts it.
+             *
+             *  Throws FontImageError if the glyph doesn't fit in an atlas image at all,
+             *  or if the glyphs of this frame take up all atlas images.
+             */
+            const AtlasRect *FindRect(const UTF8Char);
+
+            /**
+             *  Glyphs used before this may be evicted from now on.
+             */
+            void NextFrame(void);
+
+            /**
+             *  returns what changed since the last call. Neighbouring changes on a shelf are joined.
+             *  A new image is reported as a whole.
+             */
+            std::vector<AtlasDirtyRect> TakeDirtyRects(void);
+
+            size_t GetImageCount(void) const;
+            const Image *GetImage(const size_t index) const;
+
+            DynamicAtlasStats GetStats(void) const;
+            void ResetStats(void);
+    };
+}
+
+#endif  // ATLAS_H
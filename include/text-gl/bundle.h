@@ -0,0 +1,86 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "atlas.h"
+
+
+namespace TextGL
+{
+    struct FontBundleImage
+    {
+        size_t width, height;
+        std::vector<uint32_t> pixels;  // premultiplied ARGB32, as the atlas made them
+    };
+
+    struct FontBundleGlyph
+    {
+        GlyphMetrics mMetrics;  // transformed by size
+        AtlasRect mRect;
+    };
+
+    /**
+     *  A font that was rendered and packed into atlas images ahead of time,
+     *  with everything that's needed to make a GLTextureFont out of it.
+     */
+    struct FontBundle
+    {
+        FontStyle mStyle;
+        FontMetrics mMetrics;  // transformed by size
+        double mScale;  // from font units to pixels
+
+        // The kerning is kept unscaled, like the fonts it's made from do.
+        std::shared_ptr<const FontMetricsStore> mUnscaled;
+
+        std::unordered_map<UTF8Char, FontBundleGlyph> mGlyphs;
+
+        bool mHasMissingGlyph = false;
+        FontBundleGlyph mMissingGlyph;
+
+        std::vector<FontBundleImage> mImages;
+    };
+
+    /**
+     *  Packs the font's glyphs into an atlas, see MakeGlyphAtlas.
+     *  Of a font with a character set, only the kerning between those characters is kept.
+     */
+    void MakeFontBundle(const ImageFont *, FontBundle &, const AtlasParams &params=AtlasParams());
+
+    /**
+     *  Writes the bundle in a versioned binary format, in native byte order.
+     *  The pixels are stored as they are uploaded, so reading them back takes no conversion.
+     */
+    void WriteFontBundle(std::ostream &, const FontBundle &);
+
+    /**
+     *  Throws FontParseError if the data isn't a valid bundle.
+     */
+    void ReadFontBundle(const char *data, const size_t length, FontBundle &);
+
+    /**
+     *  Maps the file into memory and reads the bundle from it.
+     */
+    void ReadFontBundleFile(const char *path, FontBundle &);
+}
+
+#endif  // BUNDLE_H
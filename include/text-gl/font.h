@@ -17,8 +17,12 @@
 #ifndef FONT_H
 #define FONT_H
 
+#include <cstdint>
 #include <unordered_map>
-#include <list>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <string>
 #include <iostream>
 
 #include "utf8.h"
@@ -47,7 +51,35 @@ namespace TextGL
     };
 
 
-    typedef std::unordered_map<UTF8Char, std::unordered_map<UTF8Char, double>> KernTable;
+    /**
+     *  Fixed point number with 6 fractional bits: a value of 64 means 1.0
+     */
+    typedef int32_t Fixed26_6;
+
+    Fixed26_6 ToFixed26_6(const double);  // rounds to the nearest 1/64, clamps to the range of int32_t
+    double FromFixed26_6(const Fixed26_6);
+
+    /**
+     *  Memory that the maps of a font data are allocated from, freed all at once.
+     *  A copy gets an arena of its own, but copied maps don't use it.
+     *  Moved maps keep using the arena they came from, so that's shared then.
+     *  Assigning keeps the arena, the maps copy or move their elements into it.
+     */
+    class FontArena
+    {
+        private:
+            std::shared_ptr<std::pmr::memory_resource> pResource;
+        public:
+            FontArena(void);
+            FontArena(const FontArena &);
+            FontArena(FontArena &&);
+            FontArena &operator=(const FontArena &);
+            FontArena &operator=(FontArena &&);
+
+            std::pmr::memory_resource *Get(void) const;
+    };
+
+    typedef std::pmr::unordered_map<UTF8Char, std::pmr::unordered_map<UTF8Char, double>> KernTable;
 
     /**
      *  returns 0.0 if the combination doesn't exist.
@@ -56,46 +88,174 @@ namespace TextGL
 
     enum GlyphPathElementType
     {
-        ELEMENT_MOVETO,  // uses x, y
-        ELEMENT_LINETO,  // uses x, y
-        ELEMENT_CURVETO,  // uses x1, y1, x2, y2, x, y
-        ELEMENT_ARCTO,  // uses rx, ry, rotate(radians), largeArc, sweep, x, y
-        ELEMENT_CLOSEPATH  // has no arguments
+        ELEMENT_MOVETO,  // x, y
+        ELEMENT_LINETO,  // x, y
+        ELEMENT_CURVETO,  // x1, y1, x2, y2, x, y
+        ELEMENT_ARCTO,  // rx, ry, rotate(radians), largeArc, sweep, x, y
+        ELEMENT_CLOSEPATH  // has no coordinates
     };
 
-    struct GlyphPathElement
+    /**
+     *  How many coordinates each element type has, indexed by GlyphPathElementType.
+     *  The arc flags count as coordinates, 1.0 for true and 0.0 for false.
+     */
+    const uint8_t PATH_ELEMENT_COORD_COUNTS[] = {2, 2, 6, 7, 0};
+
+    /**
+     *  All glyph paths of one font, packed together:
+     *  one type byte per element, followed by the coordinates of all elements in order.
+     */
+    struct GlyphPathStore
     {
-        GlyphPathElementType type;
+        std::vector<uint8_t> mElementTypes;
+        std::vector<float> mCoords;
+    };
+
+    const uint32_t NO_PATH_TEXT = UINT32_MAX;
 
-        union
-        {
-            struct
-            {
-                double x1, y1, x2, y2;
-            };
-            struct
-            {
-                double rx, ry, rotate;
-                bool largeArc, sweep;
-            };
-        };
-        double x, y;
+    /**
+     *  A range of elements in the path store of the font data, that the glyph belongs to.
+     *  If the paths are parsed lazily, textOffset points to the path text instead.
+     */
+    struct GlyphPath
+    {
+        uint32_t firstElement = 0,
+                 elementCount = 0,
+                 firstCoord = 0,
+                 textOffset = NO_PATH_TEXT;
     };
 
+    /**
+     *  Points to the elements of one glyph path.
+     */
+    struct GlyphPathView
+    {
+        const uint8_t *pElementTypes;
+        const float *pCoords;
+        uint32_t elementCount;
+    };
+
+    class LazyPathCache;
+
     struct GlyphData
     {
         GlyphMetrics mMetrics;
-        std::list<GlyphPathElement> mPath;
+        GlyphPath mPath;
+    };
+
+    /**
+     *  The metrics and kerning of a font data, before scaling to any size.
+     *  Fonts of all sizes made from the same font data refer to one of these.
+     */
+    struct FontMetricsStore
+    {
+        FontArena mArena;  // must outlive the table
+
+        FontMetrics mMetrics;
+        KernTable mHorizontalKernTable{mArena.Get()};
     };
 
     struct FontData
     {
+        FontArena mArena;  // must outlive the maps
+
         FontMetrics mMetrics;
-        std::unordered_map<UTF8Char, GlyphData> mGlyphs;
-        KernTable mHorizontalKernTable;
+        std::pmr::unordered_map<UTF8Char, GlyphData> mGlyphs{mArena.Get()};
+        KernTable mHorizontalKernTable{mArena.Get()};
+
+        GlyphPathStore mPathStore;  // holds the paths of all glyphs below
+
+        /**
+         *  When parsed lazily, the 'd' attributes of the glyphs, separated by NULL characters.
+         *  These are parsed into the cache on first use.
+         */
+        std::string mPathText;
+        std::shared_ptr<LazyPathCache> mLazyPaths;
+
+        /**
+         *  Drawn for characters that have no glyph, if mHasMissingGlyph is set.
+         *  The parser takes it from the <missing-glyph> tag, but any other
+         *  glyph may be put here before making a font out of this data.
+         */
+        bool mHasMissingGlyph = false;
+        GlyphData mMissingGlyph;
+
+        /**
+         *  Copied from the metrics and kerning above, when the first font is made out of this data.
+         *  Reset it, when changing those afterwards. The parse and read functions above do so themselves.
+         */
+        mutable std::shared_ptr<const FontMetricsStore> mMetricsStore;
+    };
+
+    /**
+     *  Reads a number like SVG writes them. Doesn't depend on the locale and rounds
+     *  correctly, like strtod does in the "C" locale. Reads no further than 'end'.
+     *
+     *  returns the pointer to the text after the number, NULL if there's no number.
+     */
+    const char *ParseDouble(const char *text, const char *end, double &);
+
+    struct FontParseParams
+    {
+        /**
+         *  Only parse the glyph metrics. The path text is kept and
+         *  parsed when GetGlyphPath is first called for the glyph.
+         */
+        bool lazyPaths = false;
+
+        /**
+         *  Number of threads to parse glyph paths and kerning on, 0 for one per core.
+         *  The XML itself is read on the calling thread. The result doesn't depend on this:
+         *  kerning is applied in document order either way.
+         */
+        unsigned int nThreads = 1;
+
+        /**
+         *  If set, only the glyphs of these characters are kept, with the kerning
+         *  between them. The missing glyph is always kept.
+         */
+        const CharacterSet *pCharacters = NULL;
     };
 
-    void ParseSVGFontData(std::istream &, FontData &);
+    /**
+     *  These also take gzip compressed input, as in .svgz files. It's recognized by its
+     *  first bytes and inflated a buffer at a time, while the parser reads it.
+     */
+    void ParseSVGFontData(std::istream &, FontData &, const FontParseParams &params=FontParseParams());
+
+    /**
+     *  Parses the data in place, for example from a loaded asset pack.
+     *  The data doesn't need to be NULL-terminated.
+     */
+    void ParseSVGFontData(const char *data, const size_t length, FontData &,
+                          const FontParseParams &params=FontParseParams());
+
+    /**
+     *  Maps the file into memory and parses it in one piece.
+     */
+    void ParseSVGFontFile(const char *path, FontData &, const FontParseParams &params=FontParseParams());
+
+    /**
+     *  Parses the glyph's path if that hasn't been done yet. May be called from
+     *  several threads at once, as long as the font data isn't changed meanwhile.
+     *  The view stays valid as long as the font data does.
+     *
+     *  Throws FontParseError if lazily parsed path text turns out to be invalid.
+     */
+    GlyphPathView GetGlyphPath(const FontData &, const GlyphData &);
+
+    /**
+     *  Writes the font data in a versioned binary format, that can be read back
+     *  without any parsing. The format is in native byte order.
+     */
+    void WriteBinaryFontData(std::ostream &, const FontData &);
+
+    void ReadBinaryFontData(const char *data, const size_t length, FontData &);
+
+    /**
+     *  Maps the file into memory and reads the records straight from it.
+     */
+    void ReadBinaryFontFile(const char *path, FontData &);
 
     class FontParseError: public TextGLError
     {
@@ -124,6 +284,12 @@ namespace TextGL
         LINECAP_BUTT, LINECAP_ROUND, LINECAP_SQUARE
     };
 
+    enum GlyphRasterizer
+    {
+        RASTERIZER_CAIRO,
+        RASTERIZER_NATIVE  // built in and faster, but only fills: glyphs with a stroke still go to cairo
+    };
+
     struct FontStyle
     {
         double size, strokeWidth;
@@ -131,6 +297,7 @@ namespace TextGL
               strokeColor;
         LineJoinType lineJoin;
         LineCapType lineCap;
+        GlyphRasterizer rasterizer = RASTERIZER_CAIRO;
     };
 
     class Font
@@ -138,8 +305,19 @@ namespace TextGL
         public:
             virtual const FontMetrics *GetMetrics(void) const = 0;
             virtual const FontStyle *GetStyle(void) const = 0;
-            virtual const KernTable *GetHorizontalKernTable(void) const = 0;
+
+            /**
+             *  returns 0.0 if the combination doesn't exist.
+             *  Fonts of all sizes share one unscaled table, so this scales on every call.
+             */
+            virtual double GetHorizontalKern(const UTF8Char first, const UTF8Char second) const = 0;
             virtual const GlyphMetrics *GetGlyphMetrics(const UTF8Char) const = 0;
+
+            /**
+             *  Doesn't throw. Falls back to the missing glyph, if the character has no glyph.
+             *  returns NULL if the font has no missing glyph either.
+             */
+            virtual const GlyphMetrics *FindGlyphMetrics(const UTF8Char) const noexcept = 0;
     };
 }
 
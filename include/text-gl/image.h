@@ -17,6 +17,9 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <list>
+#include <map>
+
 #include "font.h"
 
 
@@ -24,6 +27,11 @@ namespace TextGL
 {
     class GLTextureGlyph;
     class GLTextureFont;
+    class GlyphCache;
+    class Arena;
+    class GlyphAtlas;
+    struct AtlasParams;
+    struct FontBundle;
 
 
     enum ImageDataFormat
@@ -35,6 +43,8 @@ namespace TextGL
     class Image
     {
         public:
+            virtual ~Image(void) {}
+
             virtual const void *GetData(void) const = 0;
             virtual ImageDataFormat GetFormat(void) const = 0;
             virtual void GetDimensions(size_t &w, size_t &h) const = 0;
@@ -54,22 +64,38 @@ namespace TextGL
             ImageGlyph(const ImageGlyph &) = delete;
         public:
             const GlyphMetrics *GetMetrics(void) const;
+            const Image *GetImage(void) const;
 
         friend ImageGlyph *MakeImageGlyph(const FontData &,
                                           const FontStyle &,
-                                          const GlyphData &);
-        friend GLTextureGlyph *MakeGLTextureGlyph(const ImageGlyph *);
+                                          const GlyphData &,
+                                          Arena *);
+        friend GLTextureGlyph *MakeGLTextureGlyph(const ImageGlyph *, Arena *);
         friend void DestroyImageGlyph(ImageGlyph *);
     };
 
+    struct GlyphCacheStats
+    {
+        size_t hits, misses, evictions,
+               glyphCount, bytes,  // currently in the cache
+               evictedBytes;  // not yet freed
+    };
+
     class ImageFont: public Font
     {
         private:
             FontMetrics mMetrics;  // transformed by size
             FontStyle style;
 
-            std::unordered_map<UTF8Char, ImageGlyph *> mGlyphs;
-            KernTable mHorizontalKernTable;  // transformed by size
+            std::unordered_map<UTF8Char, ImageGlyph *> mGlyphs;  // empty if rendered lazily
+            ImageGlyph *mMissingGlyph;  // NULL if the font data has none
+
+            std::shared_ptr<const FontMetricsStore> mUnscaled;  // shared with the font data
+            double mScale;
+            bool mSubset;  // only kern characters that have a glyph
+
+            GlyphCache *mCache;  // NULL unless rendered lazily
+            Arena *mArena;  // holds the glyphs rendered up front, NULL if rendered lazily
 
             ImageFont(void);
             ~ImageFont(void);
@@ -79,18 +105,169 @@ namespace TextGL
         public:
             const FontStyle *GetStyle(void) const;
             const FontMetrics *GetMetrics(void) const;
-            const KernTable *GetHorizontalKernTable(void) const;
+            double GetHorizontalKern(const UTF8Char first, const UTF8Char second) const;
             const GlyphMetrics *GetGlyphMetrics(const UTF8Char) const;
+            const GlyphMetrics *FindGlyphMetrics(const UTF8Char) const noexcept;
             const ImageGlyph *GetGlyph(const UTF8Char) const;
 
-        friend ImageFont *MakeImageFont(const FontData &, const FontStyle &);
+            /**
+             *  returns false if the character would get the missing glyph. Doesn't render.
+             */
+            bool HasGlyph(const UTF8Char) const noexcept;
+
+            /**
+             *  Doesn't throw, returns the missing glyph or NULL instead.
+             *  That includes when a lazily rendered glyph fails to render.
+             */
+            const ImageGlyph *FindGlyph(const UTF8Char) const noexcept;
+
+            /**
+             *  For lazily rendered fonts, a pinned glyph is rendered now and kept until unpinned.
+             *  Pins are counted. Fonts that were rendered up front keep all glyphs anyway.
+             */
+            void PinGlyph(const UTF8Char);
+            void UnpinGlyph(const UTF8Char);
+
+            /**
+             *  Destroys the glyphs that a lazily rendered font evicted. Must not be called
+             *  while other threads use glyphs of this font, for example once per frame.
+             */
+            void FreeEvictedGlyphs(void);
+
+            /**
+             *  All zero for fonts that were rendered up front.
+             */
+            GlyphCacheStats GetCacheStats(void) const;
+            void ResetCacheStats(void);
+
+        friend ImageFont *MakeImageFont(const FontData &, const FontStyle &, const CharacterSet *);
+        friend ImageFont *MakeLazyImageFont(const FontData &, const FontStyle &, const size_t, const CharacterSet *);
         friend GLTextureFont *MakeGLTextureFont(const ImageFont *);
+        friend GlyphAtlas *MakeGlyphAtlas(const ImageFont *, const AtlasParams &);
+        friend void MakeFontBundle(const ImageFont *, FontBundle &, const AtlasParams &);
         friend void DestroyImageFont(ImageFont *);
+        friend class ImageFontCache;
     };
 
-    ImageFont *MakeImageFont(const FontData &, const FontStyle &);
+    /**
+     *  If a character set is given, only those glyphs are rendered, with the kerning
+     *  between them. The missing glyph is always rendered.
+     */
+    ImageFont *MakeImageFont(const FontData &, const FontStyle &, const CharacterSet *pCharacters=NULL);
+
+    /**
+     *  Renders each glyph when it's first asked for, so the font data must outlive the font.
+     *  Keeps at most maxBytes of glyph images, 0 for no limit. Beyond that, glyphs that weren't
+     *  used lately are evicted, unless they're pinned. Only the missing glyph is rendered up front.
+     *
+     *  Glyphs may be asked for from several threads at once. Those that are there are found
+     *  without locking and each glyph is rendered only once, however many threads ask for it.
+     *  A glyph from GetGlyph or FindGlyph stays valid until the next call to FreeEvictedGlyphs.
+     */
+    ImageFont *MakeLazyImageFont(const FontData &, const FontStyle &, const size_t maxBytes=0,
+                                 const CharacterSet *pCharacters=NULL);
+
+    struct SizedImageFont
+    {
+        ImageFont *pFont;
+        double scale;  // draw the font's glyphs this much larger, to get the size that was asked for
+    };
+
+    struct ImageFontCacheStats
+    {
+        size_t hits,  // the size's own bucket was there
+               reuses,  // a nearby bucket was used instead
+               misses, evictions,
+               fontCount, bytes;  // currently in the cache
+    };
+
+    /**
+     *  Keeps lazily rendered fonts per font data and style, for when the size changes often.
+     *  Sizes are rounded to buckets, bucketsPerOctave of them per doubling of the size.
+     *  If the size's bucket isn't there yet, but another bucket of the same data and style
+     *  is no more than maxReuseScale times smaller or larger, that one is used instead.
+     *  Only if there's none, a font is made for the bucket.
+     *
+     *  All fonts share one budget of maxBytes of glyph images, split evenly between the fonts
+     *  in the cache. Each font evicts its own glyphs beyond its part. If pinned glyphs still
+     *  take more than the budget, Trim destroys the least recently used fonts. Fonts from GetFont
+     *  and their glyphs stay valid until then, so call Trim when none of them are in use,
+     *  for example once per frame.
+     *
+     *  Entries are keyed by font data pointer, so the font data must outlive the cache.
+     *  Not safe to use from multiple threads at once, but the fonts are.
+     */
+    class ImageFontCache
+    {
+        private:
+            struct Entry
+            {
+                const FontData *pFontData;
+                FontStyle style;
+                int bucket;
+                ImageFont *pFont;
+            };
+
+            // Font data and style, with the size left out.
+            struct StyleKey
+            {
+                const FontData *pFontData;
+                FontStyle style;
+            };
+            struct StyleKeyHash
+            {
+                size_t operator()(const StyleKey &) const;
+            };
+            struct StyleKeyEqual
+            {
+                bool operator()(const StyleKey &, const StyleKey &) const;
+            };
+
+            size_t mMaxBytes;
+            unsigned int mBucketsPerOctave;
+            double mMaxReuseScale;
+
+            std::list<Entry> mEntries;  // most recently used first
+            std::unordered_map<StyleKey, std::map<int, std::list<Entry>::iterator>,
+                               StyleKeyHash, StyleKeyEqual> mBuckets;
+
+            size_t mHits, mReuses, mMisses, mEvictions;
+
+            void operator=(const ImageFontCache &) = delete;
+            ImageFontCache(const ImageFontCache &) = delete;
+
+            double GetBucketSize(const int bucket) const;
+            void SplitBudget(void);
+        public:
+            ImageFontCache(const size_t maxBytes, const unsigned int bucketsPerOctave=8,
+                           const double maxReuseScale=1.25);
+            ~ImageFontCache(void);
+
+            SizedImageFont GetFont(const FontData &, const FontStyle &);
+
+            /**
+             *  Destroys fonts until the glyph images fit in the budget, keeping the most recently used one.
+             *  Also frees the glyphs that the fonts evicted.
+             */
+            void Trim(void);
+
+            /**
+             *  Destroys all fonts.
+             */
+            void Clear(void);
+
+            ImageFontCacheStats GetStats(void) const;
+            void ResetStats(void);
+    };
     void DestroyImageFont(ImageFont *);
 
+    /**
+     *  Fills the path by the nonzero rule, without cairo, into one byte of coverage per pixel
+     *  and 'stride' bytes per row. A path point (x, y) lands on pixel (x * scale + dx, y * scale + dy).
+     */
+    void RasterizePathCoverage(const GlyphPathView &, const double scale, const double dx, const double dy,
+                               const size_t width, const size_t height, uint8_t *coverage, const size_t stride);
+
     class FontImageError: public TextGLError
     {
         public:
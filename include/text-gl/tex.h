@@ -27,13 +27,23 @@
 
 namespace TextGL
 {
+    class DynamicGlyphAtlas;
+    struct FontBundle;
+
     class GLTextureGlyph
     {
         private:
             GlyphMetrics mMetrics;  // transformed by size
 
             GLuint texture;
-            GLsizei textureWidth, textureHeight;  // Never smaller than the metrics.
+            GLsizei textureWidth, textureHeight;  // of the glyph's image, never smaller than the metrics
+
+            /*
+             *  The part of the glyph's image that is in the texture, the rest is transparent.
+             *  A texture of its own holds the whole image, an atlas only the visible part.
+             */
+            GLsizei rectX, rectY, rectWidth, rectHeight;
+            GLfloat u0, v0, u1, v1;
 
             GLTextureGlyph(void);
             ~GLTextureGlyph(void);
@@ -45,8 +55,16 @@ namespace TextGL
             GLuint GetTexture(void) const;
             void GetTextureDimensions(GLsizei &width, GLsizei &height) const;
 
-        friend GLTextureGlyph *MakeGLTextureGlyph(const ImageGlyph *);
-        friend void DestroyGLTextureGlyph(GLTextureGlyph *);
+            /**
+             *  The part of the glyph's image that should be drawn, rows counted from the bottom,
+             *  and its texture coordinates.
+             */
+            void GetTextureRect(GLsizei &x, GLsizei &y, GLsizei &width, GLsizei &height) const;
+            void GetTextureCoords(GLfloat &u0, GLfloat &v0, GLfloat &u1, GLfloat &v1) const;
+
+        friend GLTextureGlyph *MakeGLTextureGlyph(const ImageGlyph *, Arena *);
+        friend GLTextureFont *MakeGLTextureFont(const FontBundle &);
+        friend void DestroyGLTextureFont(GLTextureFont *);
     };
 
     class GLTextureFont: public Font
@@ -56,7 +74,13 @@ namespace TextGL
             FontStyle style;
 
             std::unordered_map<UTF8Char, GLTextureGlyph *> mGlyphs;
-            KernTable mHorizontalKernTable;  // transformed by size
+            GLTextureGlyph *mMissingGlyph;  // NULL if the image font has none
+
+            std::shared_ptr<const FontMetricsStore> mUnscaled;  // shared with the image font
+            double mScale;
+            bool mSubset;  // only kern characters that have a glyph
+
+            Arena *mArena;  // holds the glyphs
 
             GLTextureFont(void);
             ~GLTextureFont(void);
@@ -68,16 +92,39 @@ namespace TextGL
             const FontStyle *GetStyle(void) const;
             const GLTextureGlyph *GetGlyph(const UTF8Char) const;
             const GlyphMetrics *GetGlyphMetrics(const UTF8Char) const;
-            const KernTable *GetHorizontalKernTable(void) const;
+
+            /**
+             *  Doesn't throw, returns the missing glyph or NULL instead.
+             */
+            const GLTextureGlyph *FindGlyph(const UTF8Char) const noexcept;
+            const GlyphMetrics *FindGlyphMetrics(const UTF8Char) const noexcept;
+            double GetHorizontalKern(const UTF8Char first, const UTF8Char second) const;
 
         friend GLTextureFont *MakeGLTextureFont(const ImageFont *);
+        friend GLTextureFont *MakeGLTextureFont(const FontBundle &);
         friend void DestroyGLTextureFont(GLTextureFont *);
     };
 
-    // A valid GL context is required to call these functions.
+    /**
+     *  A valid GL context is required to call these functions.
+     *  A lazily rendered image font renders its glyphs meanwhile. The ones it evicts
+     *  are left for FreeEvictedGlyphs, as other threads may still use them.
+     */
     GLTextureFont *MakeGLTextureFont(const ImageFont *);
+
+    /**
+     *  Uploads the bundle's atlas images as they are, no glyphs are rendered.
+     *  The glyphs share the atlas textures.
+     */
+    GLTextureFont *MakeGLTextureFont(const FontBundle &);
     void DestroyGLTextureFont(GLTextureFont *);
 
+    /**
+     *  Uploads what changed in the atlas since the last call, with one texture per atlas image.
+     *  A texture is made when the atlas gets another image. Delete them with glDeleteTextures.
+     */
+    void UploadGlyphAtlas(DynamicGlyphAtlas *, std::vector<GLuint> &textures);
+
     class GLError: public TextGLError
     {
         public:
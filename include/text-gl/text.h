@@ -18,6 +18,10 @@
 #define TEXT_H
 
 #include <cfloat>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "tex.h"
 
@@ -69,6 +73,98 @@ namespace TextGL
 
     GLfloat GetLineHeight(const GLTextureFont *);
 
+    /**
+     *  Remembers word widths per font, so that repeated words don't need to be
+     *  measured again. Holds at most 'capacity' words, evicting the least recently used.
+     *
+     *  Entries are keyed by font pointer, so Clear the cache when destroying a font.
+     *  Not safe to use from multiple threads at once.
+     */
+    class WordWidthCache
+    {
+        private:
+            struct Entry
+            {
+                const Font *pFont;
+                uint64_t hash;
+                std::string word;
+                GLfloat width;
+            };
+
+            size_t mCapacity;
+            std::list<Entry> mEntries;  // most recently used first
+            std::unordered_multimap<uint64_t, std::list<Entry>::iterator> mIndex;
+
+            size_t mHits, mMisses;
+
+            void operator=(const WordWidthCache &) = delete;
+            WordWidthCache(const WordWidthCache &) = delete;
+        public:
+            WordWidthCache(const size_t capacity);
+
+            /**
+             *  The word is the byte range from start up to (not including) end.
+             *  returns false if the word isn't in the cache.
+             */
+            bool Find(const Font *, const int8_t *start, const int8_t *end, GLfloat &width);
+            void Insert(const Font *, const int8_t *start, const int8_t *end, const GLfloat width);
+
+            void Clear(void);
+
+            size_t GetSize(void) const;
+            size_t GetHitCount(void) const;
+            size_t GetMissCount(void) const;
+            void ResetCounts(void);
+    };
+
+    struct ShapedGlyph
+    {
+        UTF8Char c;
+        size_t offset;  // in bytes, from the start of the text
+        bool hasGlyph;  // if not, it's left out: it takes no space and isn't kerned with
+        GLfloat advance,
+                kern;  // with the previous character that has a glyph, not applied at the start of a line
+        Fixed26_6 fixedAdvance, fixedKern;
+    };
+
+    /**
+     *  A word and the spaces preceeding it, as a range of glyph indices.
+     */
+    struct ShapedWord
+    {
+        size_t start,  // first glyph, a space if the word has spaces preceeding it
+               wordStart,  // first glyph after the spaces
+               end;  // past the last glyph
+        GLfloat width,  // including the spaces
+                trimmedWidth;  // without the spaces, for when the word starts a line
+        Fixed26_6 fixedWidth, fixedTrimmedWidth;
+        bool endsLine;  // followed by a line ending or the end of the text
+    };
+
+    /**
+     *  A text, mapped to glyphs once, so that it can be laid out again and again
+     *  without decoding the text and looking up glyphs and kerning.
+     *  Glyph indices equal character positions in the text.
+     *
+     *  Only valid for the font it was shaped with.
+     */
+    struct ShapedRun
+    {
+        const Font *pFont;
+        bool fixedPoint;
+        std::vector<ShapedGlyph> glyphs;  // one per character
+        std::vector<ShapedWord> words;
+    };
+
+    /**
+     *  NULL-terminated UTF-8 encoding is assumed for input sequence 'text'.
+     *
+     *  With 'fixedPoint' set, advances and kerning are rounded to 26.6 fixed point
+     *  while shaping. Line fitting and glyph placement then only add integers and
+     *  give the same result on any compiler, only converting to float for output.
+     */
+    void ShapeText(const Font *, const int8_t *text, ShapedRun &, const bool fixedPoint=false);
+
     class GLTextLeftToRightIterator
     {
         protected:
@@ -84,10 +180,32 @@ namespace TextGL
              *  and lines are placed from high y (up) to low y (down).
              */
             void IterateText(const GLTextureFont *, const int8_t *text,
-                             const TextParams &);
+                             const TextParams &, WordWidthCache *pCache=NULL);
+
+            /**
+             *  Same placement, but the run must have been shaped with the given font.
+             */
+            void IterateText(const GLTextureFont *, const ShapedRun &, const TextParams &);
     };
 
-    size_t CountLines(const Font *, const int8_t *text, const TextParams &);
+    /**
+     *  If a cache is given, word widths are looked up there first.
+     */
+    size_t CountLines(const Font *, const int8_t *text, const TextParams &,
+                      WordWidthCache *pCache=NULL);
+
+    size_t CountLines(const ShapedRun &, const TextParams &);
+
+    /**
+     *  returns the width of the widest line.
+     */
+    GLfloat GetTextWidth(const ShapedRun &, const TextParams &);
+
+    /**
+     *  returns the character position in the run, where the given point would be,
+     *  if the text was placed like IterateText does.
+     */
+    size_t HitTestText(const ShapedRun &, const TextParams &, const GLfloat x, const GLfloat y);
 }
 
 #endif  // TEXT_H
@@ -19,6 +19,7 @@
 
 #include <exception>
 #include <string>
+#include <unordered_set>
 
 #include "error.h"
 
@@ -27,11 +28,39 @@ namespace TextGL
 {
     typedef int32_t UTF8Char;  // 4 byte placeholders
 
+    // U+FFFD, packed the same way as NextUTF8Char packs the bytes.
+    const UTF8Char UTF8_REPLACEMENT_CHAR = 0xefbfbd;
+
     const int8_t *NextUTF8Char(const int8_t *bytes, UTF8Char &c);
+
+    /**
+     *  Doesn't throw. An invalid byte sequence is skipped one byte at a time,
+     *  gives 'replacement' as character and sets 'valid' to false.
+     */
+    const int8_t *NextUTF8Char(const int8_t *bytes, UTF8Char &c, bool &valid,
+                               const UTF8Char replacement=UTF8_REPLACEMENT_CHAR) noexcept;
     const int8_t *PrevUTF8Char(const int8_t *bytes, UTF8Char &c);
     size_t CountCharsUTF8(const int8_t *start, const int8_t *end=NULL);
     const int8_t *GetUTF8Position(const int8_t *bytes, const size_t characterNumber);
 
+    /**
+     *  Packs the code point's UTF-8 bytes, like NextUTF8Char does.
+     *  Throws EncodingError if it's beyond U+10FFFF.
+     */
+    UTF8Char CodePointToUTF8Char(const uint32_t codePoint);
+
+    typedef std::unordered_set<UTF8Char> CharacterSet;
+
+    /**
+     *  Adds every character in the NULL-terminated UTF-8 text, for example a sample of what will be drawn.
+     */
+    void AddCharacters(const int8_t *text, CharacterSet &);
+
+    /**
+     *  Adds the code points from first up to and including last.
+     */
+    void AddCharacterRange(const uint32_t firstCodePoint, const uint32_t lastCodePoint, CharacterSet &);
+
     class EncodingError: public TextGLError
     {
         public:
@@ -0,0 +1,102 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef ARC_H
+#define ARC_H
+
+#include <math.h>
+#include <algorithm>
+
+
+namespace TextGL
+{
+    /**
+     *  An SVG arc, as a part of a circle. The circle is in a space that's moved to
+     *  the arc's start point, rotated by 'rotate' and then scaled by 'radiiRatio' along y.
+     */
+    struct ArcCircle
+    {
+        double radiiRatio,
+               xc, yc, radius,
+               angle1, angle2;  // from the center to the start and end point
+    };
+
+    /**
+     *  Both radii must be nonzero and the end point must differ from the start point.
+     *  The arc goes in the positive angle direction if 'sweep' is set.
+     */
+    inline void GetArcCircle(const double currentX, const double currentY,
+                             const double rx, const double ry, const double rotate,
+                             const bool largeArc, const bool sweep, const double x, const double y,
+                             ArcCircle &circle)
+    {
+        double radiiRatio = ry / rx,
+
+               dx = x - currentX,
+               dy = y - currentY,
+
+               // Transform the target point from elipse to circle
+               xe = dx * cos(-rotate) - dy * sin(-rotate),
+               ye =(dy * cos(-rotate) + dx * sin(-rotate)) / radiiRatio,
+
+               // angle between the line from current to target point and the x axis
+               angle = atan2(ye, xe);
+
+        // Move the target point onto the x axis
+        // The current point was already on the x-axis
+        xe = sqrt(xe * xe + ye * ye);
+        ye = 0.0;
+
+        // Update the first radius if it is too small
+        double radius = std::max(rx, xe / 2);
+
+        // Find one circle centre
+        double xc = xe / 2,
+               yc = sqrt(radius * radius - xc * xc);
+
+        // fix for a glitch, appearing on some machines:
+        if (radius == xc)
+            yc = 0.0;
+
+        // Use the flags to pick a circle center
+        if (!(largeArc != sweep))
+            yc = -yc;
+
+        // Rotate the target point and the center back to their original circle positions
+
+        double sinAngle = sin(angle),
+               cosAngle = cos(angle);
+
+        ye = xe * sinAngle;
+        xe = xe * cosAngle;
+
+        double ax = xc * cosAngle - yc * sinAngle,
+               ay = yc * cosAngle + xc * sinAngle;
+        xc = ax;
+        yc = ay;
+
+        circle.radiiRatio = radiiRatio;
+        circle.xc = xc;
+        circle.yc = yc;
+        circle.radius = radius;
+
+        // Find the drawing angles, from center to current and target points on circle:
+        circle.angle1 = atan2(0.0 - yc, 0.0 - xc);  // current is shifted to 0,0
+        circle.angle2 = atan2( ye - yc,  xe - xc);
+    }
+}
+
+#endif  // ARC_H
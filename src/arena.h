@@ -0,0 +1,130 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+namespace TextGL
+{
+    /**
+     *  Hands out memory from large blocks, that is only freed all at once, when the arena is destroyed.
+     *  Objects in the arena don't get their destructors called, so they mustn't own anything else.
+     *  Blocks start small and double in size, up to maxBlockSize.
+     *
+     *  Containers can allocate from it as a memory resource. Deallocating does nothing.
+     *  Not safe to use from multiple threads at once.
+     */
+    class Arena: public std::pmr::memory_resource
+    {
+        private:
+            size_t blockSize, maxBlockSize;
+
+            std::vector<std::unique_ptr<uint8_t[]>> blocks;
+            uint8_t *pFree, *pEnd;  // within the block that is being filled
+
+            size_t bytes;  // in use
+
+            void operator=(const Arena &) = delete;
+            Arena(const Arena &) = delete;
+
+            static uint8_t *Align(uint8_t *p, const size_t alignment)
+            {
+                return (uint8_t *)(((uintptr_t)p + alignment - 1) & ~(uintptr_t)(alignment - 1));
+            }
+        public:
+            Arena(const size_t maxSize=256 * 1024)
+            : blockSize(std::min((size_t)4096, maxSize)), maxBlockSize(maxSize), pFree(NULL), pEnd(NULL), bytes(0)
+            {
+            }
+
+            /**
+             *  The alignment must be a power of two.
+             */
+            void *Allocate(const size_t size, const size_t alignment=alignof(std::max_align_t))
+            {
+                bytes += size;
+
+                // Anything that would take up much of a block, gets a block of its own.
+                if (size > maxBlockSize / 4)
+                {
+                    blocks.emplace_back(new uint8_t[size + alignment]);
+                    return Align(blocks.back().get(), alignment);
+                }
+
+                if (pFree == NULL || Align(pFree, alignment) + size > pEnd)
+                {
+                    if (pFree != NULL)
+                        blockSize = std::min(2 * blockSize, maxBlockSize);
+
+                    while (blockSize < size + alignment)
+                        blockSize *= 2;
+
+                    blocks.emplace_back(new uint8_t[blockSize]);
+                    pFree = blocks.back().get();
+                    pEnd = pFree + blockSize;
+                }
+
+                uint8_t *p = Align(pFree, alignment);
+                pFree = p + size;
+                return p;
+            }
+
+            /**
+             *  Constructs an object in the arena.
+             */
+            template <typename T, typename... Args>
+            T *New(Args &&... args)
+            {
+                return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            }
+
+            size_t GetBytes(void) const
+            {
+                return bytes;
+            }
+
+            size_t GetBlockCount(void) const
+            {
+                return blocks.size();
+            }
+        protected:
+            void *do_allocate(size_t size, size_t alignment)
+            {
+                return Allocate(size, alignment);
+            }
+
+            void do_deallocate(void *, size_t, size_t)
+            {
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource &other) const noexcept
+            {
+                return this == &other;
+            }
+    };
+}
+
+#endif  // ARENA_H
@@ -0,0 +1,732 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "atlas.h"
+#include "cache.h"
+#include "pixels.h"
+
+
+namespace TextGL
+{
+    /**
+     *  Places rectangles on a page as low as they go, keeping only the top edge of what has
+     *  been placed so far: a list of segments from left to right, covering the whole width.
+     *  Any space below that edge is given up.
+     */
+    class SkylinePacker
+    {
+        private:
+            struct Segment
+            {
+                size_t x, y, width;
+            };
+
+            size_t mWidth, mHeight;
+            std::vector<Segment> mSkyline;
+        public:
+            SkylinePacker(const size_t width, const size_t height): mWidth(width), mHeight(height)
+            {
+                mSkyline.push_back({0, 0, width});
+            }
+
+            /**
+             *  returns false if the rectangle doesn't fit anywhere on the page.
+             */
+            bool Insert(const size_t w, const size_t h, size_t &x, size_t &y)
+            {
+                size_t bestIndex = mSkyline.size(),
+                       bestTop = SIZE_MAX;
+                for (size_t i = 0; i < mSkyline.size() && mSkyline[i].x + w <= mWidth; i++)
+                {
+                    // The rectangle rests on the highest segment that it spans.
+                    size_t bottom = 0;
+                    for (size_t j = i; j < mSkyline.size() && mSkyline[j].x < mSkyline[i].x + w; j++)
+                        bottom = std::max(bottom, mSkyline[j].y);
+
+                    if (bottom + h <= mHeight && bottom + h < bestTop)
+                    {
+                        bestIndex = i;
+                        bestTop = bottom + h;
+                        x = mSkyline[i].x;
+                        y = bottom;
+                    }
+                }
+
+                if (bestIndex >= mSkyline.size())
+                    return false;
+
+                // Cut the segments that are now covered.
+                size_t end = bestIndex;
+                while (end < mSkyline.size() && mSkyline[end].x + mSkyline[end].width <= x + w)
+                    end++;
+                if (end < mSkyline.size() && mSkyline[end].x < x + w)
+                {
+                    mSkyline[end].width -= x + w - mSkyline[end].x;
+                    mSkyline[end].x = x + w;
+                }
+
+                mSkyline.erase(mSkyline.begin() + bestIndex, mSkyline.begin() + end);
+                mSkyline.insert(mSkyline.begin() + bestIndex, {x, bestTop, w});
+
+                // Join neighbours of the same height, to keep the list short.
+                for (size_t i = 0; i + 1 < mSkyline.size();)
+                {
+                    if (mSkyline[i].y == mSkyline[i + 1].y)
+                    {
+                        mSkyline[i].width += mSkyline[i + 1].width;
+                        mSkyline.erase(mSkyline.begin() + i + 1);
+                    }
+                    else
+                        i++;
+                }
+
+                return true;
+            }
+
+            size_t GetUsedHeight(void) const
+            {
+                size_t height = 0;
+                for (const Segment &segment : mSkyline)
+                    height = std::max(height, segment.y);
+                return height;
+            }
+    };
+
+    /**
+     *  Places rectangles on shelves: rows that are as high as the first rectangle put on them.
+     *  Unlike the skyline, space on a shelf can be given back and used again.
+     */
+    class ShelfPacker
+    {
+        private:
+            struct Span
+            {
+                size_t x, width;
+                bool used;
+            };
+
+            struct Shelf
+            {
+                size_t y, height;
+                std::vector<Span> spans;  // from left to right, covering the whole width
+            };
+
+            size_t mWidth, mHeight;
+            std::vector<Shelf> mShelves;  // from bottom to top
+
+            /**
+             *  returns the smallest free span on the shelf that is wide enough, spans.size() if none.
+             */
+            static size_t FindSpan(const Shelf &shelf, const size_t w)
+            {
+                size_t best = shelf.spans.size();
+                for (size_t i = 0; i < shelf.spans.size(); i++)
+                {
+                    const Span &span = shelf.spans[i];
+                    if (!span.used && span.width >= w && (best >= shelf.spans.size() || span.width < shelf.spans[best].width))
+                        best = i;
+                }
+                return best;
+            }
+
+            /**
+             *  returns the lowest shelf that has room, from maxHeight down to h, mShelves.size() if none.
+             */
+            size_t FindShelf(const size_t w, const size_t h, const size_t maxHeight, size_t &spanIndex) const
+            {
+                size_t best = mShelves.size();
+                for (size_t i = 0; i < mShelves.size(); i++)
+                {
+                    const Shelf &shelf = mShelves[i];
+                    if (shelf.height < h || shelf.height > maxHeight)
+                        continue;
+                    if (best < mShelves.size() && shelf.height >= mShelves[best].height)
+                        continue;
+
+                    size_t span = FindSpan(shelf, w);
+                    if (span < shelf.spans.size())
+                    {
+                        best = i;
+                        spanIndex = span;
+                    }
+                }
+                return best;
+            }
+        public:
+            ShelfPacker(const size_t width, const size_t height): mWidth(width), mHeight(height)
+            {
+            }
+
+            /**
+             *  Also tells how high the shelf is, that the rectangle was put on.
+             *  returns false if there's no room.
+             */
+            bool Insert(const size_t w, const size_t h, size_t &x, size_t &y, size_t &shelfHeight)
+            {
+                if (w > mWidth)
+                    return false;
+
+                // Rather not put small glyphs on high shelves, that's a waste of space.
+                size_t spanIndex,
+                       shelfIndex = FindShelf(w, h, h + h / 2, spanIndex);
+                if (shelfIndex >= mShelves.size())
+                {
+                    size_t top = mShelves.empty() ? 0 : mShelves.back().y + mShelves.back().height,
+                           height = std::min((h + 3) / 4 * 4, mHeight - std::min(top, mHeight));
+                    if (height >= h)
+                    {
+                        mShelves.push_back({top, height, {{0, mWidth, false}}});
+                        shelfIndex = mShelves.size() - 1;
+                        spanIndex = 0;
+                    }
+                    else
+                        shelfIndex = FindShelf(w, h, SIZE_MAX, spanIndex);
+                }
+                if (shelfIndex >= mShelves.size())
+                    return false;
+
+                Shelf &shelf = mShelves[shelfIndex];
+                Span &span = shelf.spans[spanIndex];
+                x = span.x;
+                y = shelf.y;
+                shelfHeight = shelf.height;
+
+                if (span.width > w)
+                    shelf.spans.insert(shelf.spans.begin() + spanIndex + 1, {span.x + w, span.width - w, false});
+
+                shelf.spans[spanIndex].width = w;
+                shelf.spans[spanIndex].used = true;
+                return true;
+            }
+
+            /**
+             *  Frees the rectangle that Insert put at x, y.
+             */
+            void Remove(const size_t x, const size_t y)
+            {
+                auto itShelf = std::lower_bound(mShelves.begin(), mShelves.end(), y,
+                                                [](const Shelf &shelf, const size_t y) { return shelf.y < y; });
+                std::vector<Span> &spans = itShelf->spans;
+
+                auto itSpan = std::lower_bound(spans.begin(), spans.end(), x,
+                                               [](const Span &span, const size_t x) { return span.x < x; });
+                itSpan->used = false;
+
+                // Join it with its free neighbours.
+                if (itSpan + 1 != spans.end() && !(itSpan + 1)->used)
+                {
+                    itSpan->width += (itSpan + 1)->width;
+                    spans.erase(itSpan + 1);
+                }
+                if (itSpan != spans.begin() && !(itSpan - 1)->used)
+                {
+                    (itSpan - 1)->width += itSpan->width;
+                    spans.erase(itSpan);
+                }
+
+                // Empty shelves at the top can get another height.
+                while (!mShelves.empty() && mShelves.back().spans.size() == 1 && !mShelves.back().spans[0].used)
+                    mShelves.pop_back();
+            }
+    };
+
+    /**
+     *  One image of a dynamic atlas. As in the packed atlas, the packer leaves out
+     *  the padding along the left and bottom edge.
+     */
+    class AtlasPage
+    {
+        public:
+            PixelImage image;
+            ShelfPacker packer;
+            bool allDirty;
+
+            AtlasPage(const size_t width, const size_t height, const size_t padding)
+            : image(width, height), packer(width - padding, height - padding), allDirty(true)
+            {
+                std::fill(image.GetPixels(), image.GetPixels() + width * height, 0);
+            }
+    };
+
+    size_t NextPowerOfTwo(const size_t n)
+    {
+        size_t power = 1;
+        while (power < n)
+            power *= 2;
+        return power;
+    }
+
+    /**
+     *  Finds the smallest rectangle in the image, outside of which all pixels are transparent.
+     *  returns false if there's no such pixel at all.
+     */
+    bool FindVisibleRect(const uint32_t *pixels, const size_t w, const size_t h,
+                         size_t &x, size_t &y, size_t &width, size_t &height)
+    {
+        size_t left = w, right = 0, bottom = h, top = 0;
+        for (size_t row = 0; row < h; row++)
+        {
+            const uint32_t *rowPixels = pixels + row * w;
+            for (size_t column = 0; column < w; column++)
+            {
+                if (rowPixels[column] != 0)
+                {
+                    left = std::min(left, column);
+                    right = std::max(right, column + 1);
+                    bottom = std::min(bottom, row);
+                    top = row + 1;
+                }
+            }
+        }
+
+        if (left >= right)
+            return false;
+
+        x = left;
+        y = bottom;
+        width = right - left;
+        height = top - bottom;
+        return true;
+    }
+
+    GlyphAtlas::GlyphAtlas(void): mMissingRect(NULL)
+    {
+    }
+    GlyphAtlas::~GlyphAtlas(void)
+    {
+    }
+    GlyphAtlas *MakeGlyphAtlas(const ImageFont *pFont, const AtlasParams &params)
+    {
+        // Every distinct glyph image gets one rectangle.
+        std::vector<const ImageGlyph *> glyphs;
+        std::unordered_map<UTF8Char, size_t> characterGlyphs;
+        std::unordered_map<const ImageGlyph *, size_t> glyphIndices;
+        auto AddGlyph = [&glyphs, &glyphIndices](const ImageGlyph *pGlyph)
+        {
+            auto it = glyphIndices.find(pGlyph);
+            if (it != glyphIndices.end())
+                return it->second;
+
+            glyphIndices.emplace(pGlyph, glyphs.size());
+            glyphs.push_back(pGlyph);
+            return glyphs.size() - 1;
+        };
+
+        for (const auto &pair : pFont->mGlyphs)
+            characterGlyphs[pair.first] = AddGlyph(pair.second);
+
+        /*
+         *  Like for textures, the glyphs of a lazily rendered font are shared by glyph data.
+         *  None are freed until the atlas is done, so the images stay valid.
+         */
+        if (pFont->mCache != NULL)
+        {
+            std::unordered_map<const GlyphData *, size_t, SameGlyphHash, SameGlyphEqual> cachedGlyphs;
+            for (const auto &pair : pFont->mCache->GetCharacters())
+            {
+                const GlyphCache::Character &character = pair.second;
+
+                auto it = cachedGlyphs.find(character.pGlyphData);
+                if (it == cachedGlyphs.end())
+                    it = cachedGlyphs.emplace(character.pGlyphData, AddGlyph(pFont->mCache->GetGlyph(character))).first;
+
+                characterGlyphs[pair.first] = it->second;
+            }
+        }
+
+        size_t missingGlyph = glyphs.size();
+        if (pFont->mMissingGlyph != NULL)
+            missingGlyph = AddGlyph(pFont->mMissingGlyph);
+
+        std::vector<AtlasRect> rects(glyphs.size());
+        std::vector<size_t> order;
+        size_t area = 0,
+               widest = 0;
+        for (size_t i = 0; i < glyphs.size(); i++)
+        {
+            const Image *pImage = glyphs[i]->GetImage();
+            if (pImage->GetFormat() != IMAGEFORMAT_ARGB32)
+                throw FontImageError("Unsupported image format: %x", pImage->GetFormat());
+
+            size_t w, h;
+            pImage->GetDimensions(w, h);
+
+            AtlasRect &rect = rects[i];
+            memset(&rect, 0, sizeof(AtlasRect));
+            rect.imageWidth = w;
+            rect.imageHeight = h;
+
+            if (params.trim)
+            {
+                if (!FindVisibleRect((const uint32_t *)pImage->GetData(), w, h,
+                                     rect.offsetX, rect.offsetY, rect.width, rect.height))
+                    continue;
+            }
+            else if (w > 0 && h > 0)
+            {
+                rect.width = w;
+                rect.height = h;
+            }
+            else
+                continue;
+
+            if (rect.width + 2 * params.padding > params.maxWidth || rect.height + 2 * params.padding > params.maxHeight)
+                throw FontImageError("A glyph of %u x %u pixels doesn't fit in an atlas of %u x %u with padding %u",
+                                     (unsigned int)rect.width, (unsigned int)rect.height,
+                                     (unsigned int)params.maxWidth, (unsigned int)params.maxHeight,
+                                     (unsigned int)params.padding);
+
+            order.push_back(i);
+            area += (rect.width + params.padding) * (rect.height + params.padding);
+            widest = std::max(widest, rect.width + 2 * params.padding);
+        }
+
+        // Tallest first, so that each row of the skyline is about level. Ties go by character, to always get the same atlas.
+        std::sort(order.begin(), order.end(), [&rects](const size_t i1, const size_t i2)
+        {
+            if (rects[i1].height != rects[i2].height)
+                return rects[i1].height > rects[i2].height;
+            if (rects[i1].width != rects[i2].width)
+                return rects[i1].width > rects[i2].width;
+            return i1 < i2;
+        });
+
+        // Aim for a square, if it all fits in one image. Round up after taking the widest, so the width stays a power of two.
+        size_t atlasWidth = std::min(params.maxWidth,
+                                     NextPowerOfTwo(std::max(widest, (size_t)ceil(sqrt((double)area)) + params.padding)));
+
+        /*
+         *  Each rectangle is packed with padding on its right and top. The packer's page
+         *  leaves out the padding along the left and bottom edge, which is added afterwards.
+         */
+        std::vector<size_t> pageHeights;
+        std::unique_ptr<SkylinePacker> pPacker;
+        for (const size_t i : order)
+        {
+            AtlasRect &rect = rects[i];
+            const size_t w = rect.width + params.padding,
+                         h = rect.height + params.padding;
+
+            if (pPacker == NULL || !pPacker->Insert(w, h, rect.x, rect.y))
+            {
+                if (pPacker != NULL)
+                    pageHeights.push_back(pPacker->GetUsedHeight() + params.padding);
+
+                pPacker.reset(new SkylinePacker(atlasWidth - params.padding, params.maxHeight - params.padding));
+                pPacker->Insert(w, h, rect.x, rect.y);
+            }
+
+            rect.image = pageHeights.size();
+            rect.x += params.padding;
+            rect.y += params.padding;
+        }
+        if (pPacker != NULL)
+            pageHeights.push_back(pPacker->GetUsedHeight() + params.padding);
+
+        GlyphAtlas *pAtlas = new GlyphAtlas;
+        try
+        {
+            std::vector<PixelImage *> images;
+            for (const size_t height : pageHeights)
+            {
+                PixelImage *pImage = new PixelImage(atlasWidth, height);
+                pAtlas->mImages.push_back(pImage);
+                images.push_back(pImage);
+
+                std::fill(pImage->GetPixels(), pImage->GetPixels() + atlasWidth * height, 0);
+            }
+
+            pAtlas->mStats.glyphCount = order.size();
+            pAtlas->mStats.imageCount = images.size();
+            pAtlas->mStats.glyphPixels = 0;
+            pAtlas->mStats.atlasPixels = 0;
+            for (const size_t height : pageHeights)
+                pAtlas->mStats.atlasPixels += atlasWidth * height;
+
+            for (const size_t i : order)
+            {
+                AtlasRect &rect = rects[i];
+
+                const Image *pGlyphImage = glyphs[i]->GetImage();
+                size_t w, h;
+                pGlyphImage->GetDimensions(w, h);
+
+                const uint32_t *src = (const uint32_t *)pGlyphImage->GetData();
+                uint32_t *dst = images[rect.image]->GetPixels();
+                for (size_t row = 0; row < rect.height; row++)
+                    memcpy(dst + (rect.y + row) * atlasWidth + rect.x,
+                           src + (rect.offsetY + row) * w + rect.offsetX,
+                           rect.width * sizeof(uint32_t));
+
+                const double height = pageHeights[rect.image];
+                rect.u0 = rect.x / (double)atlasWidth;
+                rect.v0 = rect.y / height;
+                rect.u1 = (rect.x + rect.width) / (double)atlasWidth;
+                rect.v1 = (rect.y + rect.height) / height;
+
+                pAtlas->mStats.glyphPixels += rect.width * rect.height;
+            }
+        }
+        catch (...)
+        {
+            DestroyGlyphAtlas(pAtlas);
+            throw;
+        }
+
+        pAtlas->mRects = std::move(rects);
+        for (const auto &pair : characterGlyphs)
+            pAtlas->mCharacterRects[pair.first] = &(pAtlas->mRects[pair.second]);
+
+        if (missingGlyph < pAtlas->mRects.size())
+            pAtlas->mMissingRect = &(pAtlas->mRects[missingGlyph]);
+
+        return pAtlas;
+    }
+    void DestroyGlyphAtlas(GlyphAtlas *pAtlas)
+    {
+        for (Image *pImage : pAtlas->mImages)
+            delete pImage;
+
+        delete pAtlas;
+    }
+    size_t GlyphAtlas::GetImageCount(void) const
+    {
+        return mImages.size();
+    }
+    const Image *GlyphAtlas::GetImage(const size_t index) const
+    {
+        return mImages.at(index);
+    }
+    const AtlasRect *GlyphAtlas::GetRect(const UTF8Char c) const
+    {
+        auto it = mCharacterRects.find(c);
+        if (it == mCharacterRects.end())
+            throw MissingGlyphError(c);
+
+        return it->second;
+    }
+    const AtlasRect *GlyphAtlas::FindRect(const UTF8Char c) const noexcept
+    {
+        auto it = mCharacterRects.find(c);
+        if (it == mCharacterRects.end())
+            return mMissingRect;
+
+        return it->second;
+    }
+    GlyphAtlasStats GlyphAtlas::GetStats(void) const
+    {
+        return mStats;
+    }
+    DynamicGlyphAtlas::DynamicGlyphAtlas(const ImageFont *pFont, const DynamicAtlasParams &params)
+    : mpFont(pFont), mParams(params), mMissingEntry(mEntries.end()),
+      mFrame(0), mHits(0), mMisses(0), mEvictions(0)
+    {
+    }
+    DynamicGlyphAtlas::~DynamicGlyphAtlas(void)
+    {
+        for (AtlasPage *pPage : mPages)
+            delete pPage;
+    }
+    const AtlasRect *DynamicGlyphAtlas::FindRect(const UTF8Char c)
+    {
+        const bool missing = !mpFont->HasGlyph(c);
+
+        std::list<Entry>::iterator it = mEntries.end();
+        if (missing)
+            it = mMissingEntry;
+        else
+        {
+            auto itCharacter = mCharacterEntries.find(c);
+            if (itCharacter != mCharacterEntries.end())
+                it = itCharacter->second;
+        }
+
+        if (it != mEntries.end())
+        {
+            mHits++;
+            it->lastFrame = mFrame;
+            mEntries.splice(mEntries.begin(), mEntries, it);
+            return &(it->rect);
+        }
+
+        const ImageGlyph *pGlyph = mpFont->FindGlyph(c);
+        if (pGlyph == NULL)
+            return NULL;
+
+        mMisses++;
+
+        AtlasRect rect;
+        Insert(pGlyph, rect);
+
+        mEntries.push_front({c, missing, rect, mFrame});
+        if (missing)
+            mMissingEntry = mEntries.begin();
+        else
+            mCharacterEntries[c] = mEntries.begin();
+
+        return &(mEntries.front().rect);
+    }
+    void DynamicGlyphAtlas::Insert(const ImageGlyph *pGlyph, AtlasRect &rect)
+    {
+        const Image *pGlyphImage = pGlyph->GetImage();
+        if (pGlyphImage->GetFormat() != IMAGEFORMAT_ARGB32)
+            throw FontImageError("Unsupported image format: %x", pGlyphImage->GetFormat());
+
+        size_t w, h;
+        pGlyphImage->GetDimensions(w, h);
+        const uint32_t *src = (const uint32_t *)pGlyphImage->GetData();
+
+        memset(&rect, 0, sizeof(AtlasRect));
+        rect.imageWidth = w;
+        rect.imageHeight = h;
+        if (!FindVisibleRect(src, w, h, rect.offsetX, rect.offsetY, rect.width, rect.height))
+            return;
+
+        const size_t padding = mParams.padding;
+        if (rect.width + 2 * padding > mParams.width || rect.height + 2 * padding > mParams.height)
+            throw FontImageError("A glyph of %u x %u pixels doesn't fit in an atlas of %u x %u with padding %u",
+                                 (unsigned int)rect.width, (unsigned int)rect.height,
+                                 (unsigned int)mParams.width, (unsigned int)mParams.height, (unsigned int)padding);
+
+        // Like in the packed atlas, each rectangle has padding on its right and top.
+        const size_t slotWidth = rect.width + padding;
+        size_t shelfHeight;
+        while (true)
+        {
+            for (rect.image = 0; rect.image < mPages.size(); rect.image++)
+            {
+                if (mPages[rect.image]->packer.Insert(slotWidth, rect.height + padding, rect.x, rect.y, shelfHeight))
+                    break;
+            }
+            if (rect.image < mPages.size())
+                break;
+
+            if (mPages.size() < mParams.maxImageCount)
+                mPages.push_back(new AtlasPage(mParams.width, mParams.height, padding));
+            else if (!mEntries.empty() && mEntries.back().lastFrame < mFrame)
+                Evict();
+            else
+                throw FontImageError("The glyphs of this frame don't fit in %u atlas images of %u x %u",
+                                     (unsigned int)mParams.maxImageCount,
+                                     (unsigned int)mParams.width, (unsigned int)mParams.height);
+        }
+
+        rect.x += padding;
+        rect.y += padding;
+
+        // The space may have held an evicted glyph, so clear it up to the next rectangle.
+        uint32_t *dst = mPages[rect.image]->image.GetPixels();
+        for (size_t row = 0; row < shelfHeight; row++)
+            std::fill(dst + (rect.y + row) * mParams.width + rect.x,
+                      dst + (rect.y + row) * mParams.width + rect.x + slotWidth, 0);
+
+        for (size_t row = 0; row < rect.height; row++)
+            memcpy(dst + (rect.y + row) * mParams.width + rect.x,
+                   src + (rect.offsetY + row) * w + rect.offsetX,
+                   rect.width * sizeof(uint32_t));
+
+        AddDirtyRect({rect.image, rect.x, rect.y, slotWidth, shelfHeight});
+
+        rect.u0 = rect.x / (double)mParams.width;
+        rect.v0 = rect.y / (double)mParams.height;
+        rect.u1 = (rect.x + rect.width) / (double)mParams.width;
+        rect.v1 = (rect.y + rect.height) / (double)mParams.height;
+    }
+    void DynamicGlyphAtlas::Evict(void)
+    {
+        const Entry &entry = mEntries.back();
+        if (entry.rect.width > 0)
+            mPages[entry.rect.image]->packer.Remove(entry.rect.x - mParams.padding, entry.rect.y - mParams.padding);
+
+        if (entry.missing)
+            mMissingEntry = mEntries.end();
+        else
+            mCharacterEntries.erase(entry.c);
+
+        mEntries.pop_back();
+        mEvictions++;
+    }
+    void DynamicGlyphAtlas::AddDirtyRect(const AtlasDirtyRect &dirty)
+    {
+        if (mPages[dirty.image]->allDirty)
+            return;
+
+        // Glyphs that are put in one after the other often end up side by side.
+        if (!mDirtyRects.empty())
+        {
+            AtlasDirtyRect &last = mDirtyRects.back();
+            if (last.image == dirty.image && last.y == dirty.y && last.height == dirty.height
+                    && last.x + last.width == dirty.x)
+            {
+                last.width += dirty.width;
+                return;
+            }
+        }
+
+        mDirtyRects.push_back(dirty);
+    }
+    void DynamicGlyphAtlas::NextFrame(void)
+    {
+        mFrame++;
+    }
+    std::vector<AtlasDirtyRect> DynamicGlyphAtlas::TakeDirtyRects(void)
+    {
+        std::vector<AtlasDirtyRect> dirtyRects;
+        for (size_t i = 0; i < mPages.size(); i++)
+        {
+            if (mPages[i]->allDirty)
+            {
+                dirtyRects.push_back({i, 0, 0, mParams.width, mParams.height});
+                mPages[i]->allDirty = false;
+            }
+        }
+
+        dirtyRects.insert(dirtyRects.end(), mDirtyRects.begin(), mDirtyRects.end());
+        mDirtyRects.clear();
+
+        return dirtyRects;
+    }
+    size_t DynamicGlyphAtlas::GetImageCount(void) const
+    {
+        return mPages.size();
+    }
+    const Image *DynamicGlyphAtlas::GetImage(const size_t index) const
+    {
+        return &(mPages.at(index)->image);
+    }
+    DynamicAtlasStats DynamicGlyphAtlas::GetStats(void) const
+    {
+        DynamicAtlasStats stats;
+        stats.hits = mHits;
+        stats.misses = mMisses;
+        stats.evictions = mEvictions;
+        stats.glyphCount = mEntries.size();
+        stats.imageCount = mPages.size();
+        return stats;
+    }
+    void DynamicGlyphAtlas::ResetStats(void)
+    {
+        mHits = mMisses = mEvictions = 0;
+    }
+}
@@ -0,0 +1,323 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "font.h"
+#include "mapped.h"
+#include "records.h"
+
+
+/*
+ *  Layout of a binary font, all in native byte order:
+ *
+ *    BinaryFontHeader
+ *    BinaryGlyphRecord[glyphCount]  sorted by character, the missing glyph last if flagged
+ *    float[coordCount]  the path store, as is
+ *    uint8_t[elementCount]
+ *    BinaryKernRecord[kernCount]
+ *
+ *  The records refer to each other by index only, so the data may be loaded anywhere.
+ */
+
+#define BINARY_FONT_MAGIC "TGLF"
+#define BINARY_FONT_VERSION 2
+#define BINARY_FONT_BYTE_ORDER 0x01020304
+
+#define BINARY_FLAG_MISSING_GLYPH 0x01
+
+namespace TextGL
+{
+    struct BinaryFontHeader
+    {
+        char magic[4];
+        uint32_t version,
+                 byteOrder,
+                 flags,
+                 glyphCount,
+                 elementCount,
+                 coordCount,
+                 kernCount;
+        double unitsPerEM, ascent, descent,
+               bboxLeft, bboxBottom, bboxRight, bboxTop;
+    };
+
+    struct BinaryGlyphRecord
+    {
+        int32_t c;
+        uint32_t firstElement,
+                 elementCount,
+                 firstCoord;
+        double bearingX, bearingY,
+               width, height,
+               advanceX;
+    };
+
+    struct BinaryKernRecord
+    {
+        int32_t first, second;
+        double value;
+    };
+
+    static_assert(sizeof(BinaryFontHeader) == 88, "unexpected padding in BinaryFontHeader");
+    static_assert(sizeof(BinaryGlyphRecord) == 56, "unexpected padding in BinaryGlyphRecord");
+    static_assert(sizeof(BinaryKernRecord) == 16, "unexpected padding in BinaryKernRecord");
+
+    /**
+     *  Lazily parsed paths are parsed now and added to the store to write.
+     *  returns the range of the glyph's path in that store.
+     */
+    GlyphPath GetStoredPath(const FontData &fontData, const GlyphData &glyph, GlyphPathStore &store,
+                            std::unordered_map<uint32_t, GlyphPath> &storedTextPaths)
+    {
+        if (glyph.mPath.textOffset == NO_PATH_TEXT)
+            return glyph.mPath;
+
+        auto it = storedTextPaths.find(glyph.mPath.textOffset);
+        if (it != storedTextPaths.end())
+            return it->second;
+
+        GlyphPathView view = GetGlyphPath(fontData, glyph);
+
+        GlyphPath path;
+        path.firstElement = store.mElementTypes.size();
+        path.elementCount = view.elementCount;
+        path.firstCoord = store.mCoords.size();
+
+        size_t nCoords = 0;
+        for (uint32_t i = 0; i < view.elementCount; i++)
+            nCoords += PATH_ELEMENT_COORD_COUNTS[view.pElementTypes[i]];
+
+        store.mElementTypes.insert(store.mElementTypes.end(), view.pElementTypes, view.pElementTypes + view.elementCount);
+        store.mCoords.insert(store.mCoords.end(), view.pCoords, view.pCoords + nCoords);
+
+        storedTextPaths[glyph.mPath.textOffset] = path;
+        return path;
+    }
+
+    void WriteGlyph(std::ostream &os, const UTF8Char c, const GlyphData &glyph, const GlyphPath &path)
+    {
+        BinaryGlyphRecord record;
+        memset(&record, 0, sizeof(record));
+
+        record.c = c;
+        record.firstElement = path.firstElement;
+        record.elementCount = path.elementCount;
+        record.firstCoord = path.firstCoord;
+        record.bearingX = glyph.mMetrics.bearingX;
+        record.bearingY = glyph.mMetrics.bearingY;
+        record.width = glyph.mMetrics.width;
+        record.height = glyph.mMetrics.height;
+        record.advanceX = glyph.mMetrics.advanceX;
+
+        WriteRecord(os, record);
+    }
+
+    void WriteBinaryFontData(std::ostream &os, const FontData &fontData)
+    {
+        // Sort, so that the same data always gives the same file.
+        std::vector<UTF8Char> characters;
+        characters.reserve(fontData.mGlyphs.size());
+        for (const auto &pair : fontData.mGlyphs)
+            characters.push_back(pair.first);
+        std::sort(characters.begin(), characters.end());
+
+        std::vector<BinaryKernRecord> kerns;
+        for (const auto &firstPair : fontData.mHorizontalKernTable)
+        {
+            for (const auto &secondPair : firstPair.second)
+            {
+                BinaryKernRecord record;
+                record.first = firstPair.first;
+                record.second = secondPair.first;
+                record.value = secondPair.second;
+                kerns.push_back(record);
+            }
+        }
+        std::sort(kerns.begin(), kerns.end(),
+                  [](const BinaryKernRecord &r1, const BinaryKernRecord &r2)
+                  {
+                      return r1.first < r2.first || (r1.first == r2.first && r1.second < r2.second);
+                  });
+
+        GlyphPathStore store = fontData.mPathStore;
+        std::unordered_map<uint32_t, GlyphPath> storedTextPaths;
+
+        std::vector<GlyphPath> paths;
+        paths.reserve(characters.size() + 1);
+        for (const UTF8Char c : characters)
+            paths.push_back(GetStoredPath(fontData, fontData.mGlyphs.at(c), store, storedTextPaths));
+        if (fontData.mHasMissingGlyph)
+            paths.push_back(GetStoredPath(fontData, fontData.mMissingGlyph, store, storedTextPaths));
+
+        BinaryFontHeader header;
+        memset(&header, 0, sizeof(header));
+
+        memcpy(header.magic, BINARY_FONT_MAGIC, 4);
+        header.version = BINARY_FONT_VERSION;
+        header.byteOrder = BINARY_FONT_BYTE_ORDER;
+        header.flags = fontData.mHasMissingGlyph ? BINARY_FLAG_MISSING_GLYPH : 0;
+        header.glyphCount = characters.size() + (fontData.mHasMissingGlyph ? 1 : 0);
+        header.elementCount = store.mElementTypes.size();
+        header.coordCount = store.mCoords.size();
+        header.kernCount = kerns.size();
+
+        header.unitsPerEM = fontData.mMetrics.unitsPerEM;
+        header.ascent = fontData.mMetrics.ascent;
+        header.descent = fontData.mMetrics.descent;
+        header.bboxLeft = fontData.mMetrics.bbox.left;
+        header.bboxBottom = fontData.mMetrics.bbox.bottom;
+        header.bboxRight = fontData.mMetrics.bbox.right;
+        header.bboxTop = fontData.mMetrics.bbox.top;
+
+        WriteRecord(os, header);
+
+        for (size_t i = 0; i < characters.size(); i++)
+            WriteGlyph(os, characters[i], fontData.mGlyphs.at(characters[i]), paths[i]);
+        if (fontData.mHasMissingGlyph)
+            WriteGlyph(os, 0, fontData.mMissingGlyph, paths.back());
+
+        os.write((const char *)store.mCoords.data(), header.coordCount * sizeof(float));
+        os.write((const char *)store.mElementTypes.data(), header.elementCount);
+
+        for (const BinaryKernRecord &record : kerns)
+            WriteRecord(os, record);
+
+        if (!os.good())
+            throw FontParseError("Cannot write binary font data");
+    }
+
+    /**
+     *  Checks that the glyph's path lies within the path store, so that it can be drawn safely.
+     */
+    void ReadGlyph(const BinaryGlyphRecord &record, const GlyphPathStore &store, GlyphData &glyph)
+    {
+        size_t elementCount = store.mElementTypes.size(),
+               coordCount = store.mCoords.size();
+
+        if (record.firstElement > elementCount ||
+                record.elementCount > elementCount - record.firstElement)
+            throw FontParseError("Glyph path out of range in binary font data");
+
+        size_t nCoords = 0;
+        for (uint32_t i = record.firstElement; i < record.firstElement + record.elementCount; i++)
+        {
+            uint8_t type = store.mElementTypes[i];
+            if (type > ELEMENT_CLOSEPATH)
+                throw FontParseError("Unknown path element type %u in binary font data", type);
+
+            nCoords += PATH_ELEMENT_COORD_COUNTS[type];
+        }
+
+        if (record.firstCoord > coordCount || nCoords > coordCount - record.firstCoord)
+            throw FontParseError("Glyph coordinates out of range in binary font data");
+
+        glyph.mMetrics.bearingX = record.bearingX;
+        glyph.mMetrics.bearingY = record.bearingY;
+        glyph.mMetrics.width = record.width;
+        glyph.mMetrics.height = record.height;
+        glyph.mMetrics.advanceX = record.advanceX;
+
+        glyph.mPath = GlyphPath();
+        glyph.mPath.firstElement = record.firstElement;
+        glyph.mPath.elementCount = record.elementCount;
+        glyph.mPath.firstCoord = record.firstCoord;
+    }
+
+    void ReadBinaryFontData(const char *data, const size_t length, FontData &fontData)
+    {
+        RecordReader reader(data, length, "Binary font data is truncated");
+
+        BinaryFontHeader header;
+        RecordReader::Get(reader.Require<BinaryFontHeader>(1), 0, header);
+
+        if (memcmp(header.magic, BINARY_FONT_MAGIC, 4) != 0)
+            throw FontParseError("Not binary font data");
+
+        if (header.byteOrder != BINARY_FONT_BYTE_ORDER)
+            throw FontParseError("Binary font data has the wrong byte order");
+
+        if (header.version != BINARY_FONT_VERSION)
+            throw FontParseError("Unsupported binary font version %u, expected %u",
+                                 header.version, BINARY_FONT_VERSION);
+
+        bool hasMissingGlyph = (header.flags & BINARY_FLAG_MISSING_GLYPH) != 0;
+        if (hasMissingGlyph && header.glyphCount < 1)
+            throw FontParseError("Binary font data has no missing glyph record");
+
+        const char *pGlyphRecords = reader.Require<BinaryGlyphRecord>(header.glyphCount),
+                   *pCoords = reader.Require<float>(header.coordCount),
+                   *pElementTypes = reader.Require<uint8_t>(header.elementCount),
+                   *pKernRecords = reader.Require<BinaryKernRecord>(header.kernCount);
+
+        GlyphPathStore &store = fontData.mPathStore;
+        store.mCoords.resize(header.coordCount);
+        memcpy(store.mCoords.data(), pCoords, header.coordCount * sizeof(float));
+        store.mElementTypes.assign(pElementTypes, pElementTypes + header.elementCount);
+
+        // Fonts made from the data before keep their copy, new fonts must not get it.
+        std::atomic_store(&fontData.mMetricsStore, std::shared_ptr<const FontMetricsStore>());
+
+        fontData.mMetrics.unitsPerEM = header.unitsPerEM;
+        fontData.mMetrics.ascent = header.ascent;
+        fontData.mMetrics.descent = header.descent;
+        fontData.mMetrics.bbox.left = header.bboxLeft;
+        fontData.mMetrics.bbox.bottom = header.bboxBottom;
+        fontData.mMetrics.bbox.right = header.bboxRight;
+        fontData.mMetrics.bbox.top = header.bboxTop;
+
+        uint32_t glyphCount = header.glyphCount - (hasMissingGlyph ? 1 : 0);
+
+        fontData.mGlyphs.clear();
+        fontData.mGlyphs.reserve(glyphCount);
+
+        BinaryGlyphRecord glyphRecord;
+        for (uint32_t i = 0; i < glyphCount; i++)
+        {
+            RecordReader::Get(pGlyphRecords, i, glyphRecord);
+            ReadGlyph(glyphRecord, store, fontData.mGlyphs[glyphRecord.c]);
+        }
+
+        fontData.mHasMissingGlyph = hasMissingGlyph;
+        if (hasMissingGlyph)
+        {
+            RecordReader::Get(pGlyphRecords, glyphCount, glyphRecord);
+            ReadGlyph(glyphRecord, store, fontData.mMissingGlyph);
+        }
+
+        // All paths are in the store.
+        fontData.mPathText.clear();
+        fontData.mLazyPaths.reset();
+
+        fontData.mHorizontalKernTable.clear();
+
+        BinaryKernRecord kernRecord;
+        for (uint32_t i = 0; i < header.kernCount; i++)
+        {
+            RecordReader::Get(pKernRecords, i, kernRecord);
+            fontData.mHorizontalKernTable[kernRecord.first][kernRecord.second] = kernRecord.value;
+        }
+    }
+
+    void ReadBinaryFontFile(const char *path, FontData &fontData)
+    {
+        MappedFile file(path);
+
+        ReadBinaryFontData(file.GetData(), file.GetLength(), fontData);
+    }
+}
@@ -0,0 +1,400 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "bundle.h"
+#include "cache.h"
+#include "mapped.h"
+#include "records.h"
+
+
+/*
+ *  Layout of a font bundle, all in native byte order:
+ *
+ *    BundleHeader
+ *    BundleImageRecord[imageCount]
+ *    BundleGlyphRecord[glyphCount]  sorted by character, the missing glyph last if flagged
+ *    BundleKernRecord[kernCount]  unscaled, sorted
+ *    uint32_t[width * height] for each image, in order
+ */
+
+#define FONT_BUNDLE_MAGIC "TGLB"
+#define FONT_BUNDLE_VERSION 1
+#define FONT_BUNDLE_BYTE_ORDER 0x01020304
+
+#define BUNDLE_FLAG_MISSING_GLYPH 0x01
+
+namespace TextGL
+{
+    struct BundleHeader
+    {
+        char magic[4];
+        uint32_t version,
+                 byteOrder,
+                 flags,
+                 imageCount,
+                 glyphCount,
+                 kernCount,
+                 lineJoin,
+                 lineCap,
+                 rasterizer;
+        float fillColor[4],
+              strokeColor[4];
+        double size, strokeWidth,
+               scale,
+               unitsPerEM, ascent, descent,
+               bboxLeft, bboxBottom, bboxRight, bboxTop;
+    };
+
+    struct BundleImageRecord
+    {
+        uint32_t width, height;
+    };
+
+    struct BundleGlyphRecord
+    {
+        int32_t c;
+        uint32_t image,
+                 x, y, width, height,
+                 offsetX, offsetY,
+                 imageWidth, imageHeight;
+        double bearingX, bearingY,
+               glyphWidth, glyphHeight,
+               advanceX;
+    };
+
+    struct BundleKernRecord
+    {
+        int32_t first, second;
+        double value;
+    };
+
+    static_assert(sizeof(BundleHeader) == 152, "unexpected padding in BundleHeader");
+    static_assert(sizeof(BundleImageRecord) == 8, "unexpected padding in BundleImageRecord");
+    static_assert(sizeof(BundleGlyphRecord) == 80, "unexpected padding in BundleGlyphRecord");
+    static_assert(sizeof(BundleKernRecord) == 16, "unexpected padding in BundleKernRecord");
+
+    void MakeFontBundle(const ImageFont *pFont, FontBundle &bundle, const AtlasParams &params)
+    {
+        std::vector<UTF8Char> characters;
+        for (const auto &pair : pFont->mGlyphs)
+            characters.push_back(pair.first);
+        if (pFont->mCache != NULL)
+        {
+            for (const auto &pair : pFont->mCache->GetCharacters())
+                characters.push_back(pair.first);
+        }
+
+        std::unique_ptr<GlyphAtlas, void (*)(GlyphAtlas *)> pAtlas(MakeGlyphAtlas(pFont, params), DestroyGlyphAtlas);
+
+        bundle.mStyle = pFont->style;
+        bundle.mMetrics = pFont->mMetrics;
+        bundle.mScale = pFont->mScale;
+
+        // A subset only keeps the kerning between its own characters.
+        if (pFont->mSubset)
+        {
+            std::shared_ptr<FontMetricsStore> pStore = std::make_shared<FontMetricsStore>();
+            pStore->mMetrics = pFont->mUnscaled->mMetrics;
+            for (const auto &row : pFont->mUnscaled->mHorizontalKernTable)
+            {
+                if (!pFont->HasGlyph(row.first))
+                    continue;
+
+                for (const auto &pair : row.second)
+                {
+                    if (pFont->HasGlyph(pair.first))
+                        pStore->mHorizontalKernTable[row.first][pair.first] = pair.second;
+                }
+            }
+            bundle.mUnscaled = pStore;
+        }
+        else
+            bundle.mUnscaled = pFont->mUnscaled;
+
+        bundle.mGlyphs.clear();
+        for (const UTF8Char c : characters)
+        {
+            FontBundleGlyph &glyph = bundle.mGlyphs[c];
+            glyph.mMetrics = *(pFont->GetGlyphMetrics(c));
+            glyph.mRect = *(pAtlas->GetRect(c));
+        }
+
+        bundle.mHasMissingGlyph = pFont->mMissingGlyph != NULL;
+        if (bundle.mHasMissingGlyph)
+        {
+            bundle.mMissingGlyph.mMetrics = *(pFont->mMissingGlyph->GetMetrics());
+            bundle.mMissingGlyph.mRect = *(pAtlas->mMissingRect);
+        }
+
+        bundle.mImages.resize(pAtlas->GetImageCount());
+        for (size_t i = 0; i < pAtlas->GetImageCount(); i++)
+        {
+            const Image *pImage = pAtlas->GetImage(i);
+            FontBundleImage &image = bundle.mImages[i];
+
+            pImage->GetDimensions(image.width, image.height);
+
+            const uint32_t *pixels = (const uint32_t *)pImage->GetData();
+            image.pixels.assign(pixels, pixels + image.width * image.height);
+        }
+    }
+
+    void WriteBundleGlyph(std::ostream &os, const UTF8Char c, const FontBundleGlyph &glyph)
+    {
+        BundleGlyphRecord record;
+        memset(&record, 0, sizeof(record));
+
+        record.c = c;
+        record.image = glyph.mRect.image;
+        record.x = glyph.mRect.x;
+        record.y = glyph.mRect.y;
+        record.width = glyph.mRect.width;
+        record.height = glyph.mRect.height;
+        record.offsetX = glyph.mRect.offsetX;
+        record.offsetY = glyph.mRect.offsetY;
+        record.imageWidth = glyph.mRect.imageWidth;
+        record.imageHeight = glyph.mRect.imageHeight;
+        record.bearingX = glyph.mMetrics.bearingX;
+        record.bearingY = glyph.mMetrics.bearingY;
+        record.glyphWidth = glyph.mMetrics.width;
+        record.glyphHeight = glyph.mMetrics.height;
+        record.advanceX = glyph.mMetrics.advanceX;
+
+        WriteRecord(os, record);
+    }
+
+    void WriteFontBundle(std::ostream &os, const FontBundle &bundle)
+    {
+        // Sort, so that the same bundle always gives the same file.
+        std::vector<UTF8Char> characters;
+        characters.reserve(bundle.mGlyphs.size());
+        for (const auto &pair : bundle.mGlyphs)
+            characters.push_back(pair.first);
+        std::sort(characters.begin(), characters.end());
+
+        std::vector<BundleKernRecord> kerns;
+        for (const auto &firstPair : bundle.mUnscaled->mHorizontalKernTable)
+        {
+            for (const auto &secondPair : firstPair.second)
+            {
+                BundleKernRecord record;
+                record.first = firstPair.first;
+                record.second = secondPair.first;
+                record.value = secondPair.second;
+                kerns.push_back(record);
+            }
+        }
+        std::sort(kerns.begin(), kerns.end(),
+                  [](const BundleKernRecord &r1, const BundleKernRecord &r2)
+                  {
+                      return r1.first < r2.first || (r1.first == r2.first && r1.second < r2.second);
+                  });
+
+        BundleHeader header;
+        memset(&header, 0, sizeof(header));
+
+        memcpy(header.magic, FONT_BUNDLE_MAGIC, 4);
+        header.version = FONT_BUNDLE_VERSION;
+        header.byteOrder = FONT_BUNDLE_BYTE_ORDER;
+        header.flags = bundle.mHasMissingGlyph ? BUNDLE_FLAG_MISSING_GLYPH : 0;
+        header.imageCount = bundle.mImages.size();
+        header.glyphCount = characters.size() + (bundle.mHasMissingGlyph ? 1 : 0);
+        header.kernCount = kerns.size();
+
+        const FontStyle &style = bundle.mStyle;
+        header.lineJoin = style.lineJoin;
+        header.lineCap = style.lineCap;
+        header.rasterizer = style.rasterizer;
+        memcpy(header.fillColor, &style.fillColor, sizeof(header.fillColor));
+        memcpy(header.strokeColor, &style.strokeColor, sizeof(header.strokeColor));
+        header.size = style.size;
+        header.strokeWidth = style.strokeWidth;
+
+        const FontMetrics &metrics = bundle.mUnscaled->mMetrics;
+        header.scale = bundle.mScale;
+        header.unitsPerEM = metrics.unitsPerEM;
+        header.ascent = metrics.ascent;
+        header.descent = metrics.descent;
+        header.bboxLeft = metrics.bbox.left;
+        header.bboxBottom = metrics.bbox.bottom;
+        header.bboxRight = metrics.bbox.right;
+        header.bboxTop = metrics.bbox.top;
+
+        WriteRecord(os, header);
+
+        for (const FontBundleImage &image : bundle.mImages)
+            WriteRecord(os, BundleImageRecord{(uint32_t)image.width, (uint32_t)image.height});
+
+        for (const UTF8Char c : characters)
+            WriteBundleGlyph(os, c, bundle.mGlyphs.at(c));
+        if (bundle.mHasMissingGlyph)
+            WriteBundleGlyph(os, 0, bundle.mMissingGlyph);
+
+        for (const BundleKernRecord &record : kerns)
+            WriteRecord(os, record);
+
+        for (const FontBundleImage &image : bundle.mImages)
+            os.write((const char *)image.pixels.data(), image.pixels.size() * sizeof(uint32_t));
+
+        if (!os.good())
+            throw FontParseError("Cannot write font bundle");
+    }
+
+    /**
+     *  Checks that the glyph's rectangle lies within its atlas image.
+     */
+    void ReadBundleGlyph(const BundleGlyphRecord &record, const std::vector<FontBundleImage> &images, FontBundleGlyph &glyph)
+    {
+        AtlasRect &rect = glyph.mRect;
+        memset(&rect, 0, sizeof(AtlasRect));
+
+        if (record.width > 0 && record.height > 0)
+        {
+            if (record.image >= images.size())
+                throw FontParseError("Glyph image out of range in font bundle");
+
+            const FontBundleImage &image = images[record.image];
+            if (record.x > image.width || record.width > image.width - record.x ||
+                    record.y > image.height || record.height > image.height - record.y)
+                throw FontParseError("Glyph rectangle out of range in font bundle");
+
+            rect.image = record.image;
+            rect.x = record.x;
+            rect.y = record.y;
+            rect.width = record.width;
+            rect.height = record.height;
+            rect.offsetX = record.offsetX;
+            rect.offsetY = record.offsetY;
+
+            rect.u0 = rect.x / (double)image.width;
+            rect.v0 = rect.y / (double)image.height;
+            rect.u1 = (rect.x + rect.width) / (double)image.width;
+            rect.v1 = (rect.y + rect.height) / (double)image.height;
+        }
+        rect.imageWidth = record.imageWidth;
+        rect.imageHeight = record.imageHeight;
+
+        glyph.mMetrics.bearingX = record.bearingX;
+        glyph.mMetrics.bearingY = record.bearingY;
+        glyph.mMetrics.width = record.glyphWidth;
+        glyph.mMetrics.height = record.glyphHeight;
+        glyph.mMetrics.advanceX = record.advanceX;
+    }
+
+    void ReadFontBundle(const char *data, const size_t length, FontBundle &bundle)
+    {
+        RecordReader reader(data, length, "Font bundle is truncated");
+
+        BundleHeader header;
+        RecordReader::Get(reader.Require<BundleHeader>(1), 0, header);
+
+        if (memcmp(header.magic, FONT_BUNDLE_MAGIC, 4) != 0)
+            throw FontParseError("Not a font bundle");
+
+        if (header.byteOrder != FONT_BUNDLE_BYTE_ORDER)
+            throw FontParseError("Font bundle has the wrong byte order");
+
+        if (header.version != FONT_BUNDLE_VERSION)
+            throw FontParseError("Unsupported font bundle version %u, expected %u",
+                                 header.version, FONT_BUNDLE_VERSION);
+
+        bool hasMissingGlyph = (header.flags & BUNDLE_FLAG_MISSING_GLYPH) != 0;
+        if (hasMissingGlyph && header.glyphCount < 1)
+            throw FontParseError("Font bundle has no missing glyph record");
+
+        if (header.lineJoin > LINEJOIN_BEVEL || header.lineCap > LINECAP_SQUARE || header.rasterizer > RASTERIZER_NATIVE)
+            throw FontParseError("Unknown style in font bundle");
+
+        const char *pImageRecords = reader.Require<BundleImageRecord>(header.imageCount),
+                   *pGlyphRecords = reader.Require<BundleGlyphRecord>(header.glyphCount),
+                   *pKernRecords = reader.Require<BundleKernRecord>(header.kernCount);
+
+        bundle.mImages.resize(header.imageCount);
+        for (uint32_t i = 0; i < header.imageCount; i++)
+        {
+            BundleImageRecord imageRecord;
+            RecordReader::Get(pImageRecords, i, imageRecord);
+
+            FontBundleImage &image = bundle.mImages[i];
+            image.width = imageRecord.width;
+            image.height = imageRecord.height;
+
+            const char *pPixels = reader.Require<uint32_t>(image.width * image.height);
+            image.pixels.resize(image.width * image.height);
+            memcpy(image.pixels.data(), pPixels, image.pixels.size() * sizeof(uint32_t));
+        }
+
+        FontStyle &style = bundle.mStyle;
+        style.size = header.size;
+        style.strokeWidth = header.strokeWidth;
+        memcpy(&style.fillColor, header.fillColor, sizeof(header.fillColor));
+        memcpy(&style.strokeColor, header.strokeColor, sizeof(header.strokeColor));
+        style.lineJoin = (LineJoinType)header.lineJoin;
+        style.lineCap = (LineCapType)header.lineCap;
+        style.rasterizer = (GlyphRasterizer)header.rasterizer;
+
+        std::shared_ptr<FontMetricsStore> pStore = std::make_shared<FontMetricsStore>();
+        pStore->mMetrics.unitsPerEM = header.unitsPerEM;
+        pStore->mMetrics.ascent = header.ascent;
+        pStore->mMetrics.descent = header.descent;
+        pStore->mMetrics.bbox.left = header.bboxLeft;
+        pStore->mMetrics.bbox.bottom = header.bboxBottom;
+        pStore->mMetrics.bbox.right = header.bboxRight;
+        pStore->mMetrics.bbox.top = header.bboxTop;
+
+        BundleKernRecord kernRecord;
+        for (uint32_t i = 0; i < header.kernCount; i++)
+        {
+            RecordReader::Get(pKernRecords, i, kernRecord);
+            pStore->mHorizontalKernTable[kernRecord.first][kernRecord.second] = kernRecord.value;
+        }
+
+        bundle.mScale = header.scale;
+        ScaleFontMetrics(pStore->mMetrics, bundle.mScale, bundle.mMetrics);
+        bundle.mUnscaled = pStore;
+
+        uint32_t glyphCount = header.glyphCount - (hasMissingGlyph ? 1 : 0);
+
+        bundle.mGlyphs.clear();
+        bundle.mGlyphs.reserve(glyphCount);
+
+        BundleGlyphRecord glyphRecord;
+        for (uint32_t i = 0; i < glyphCount; i++)
+        {
+            RecordReader::Get(pGlyphRecords, i, glyphRecord);
+            ReadBundleGlyph(glyphRecord, bundle.mImages, bundle.mGlyphs[glyphRecord.c]);
+        }
+
+        bundle.mHasMissingGlyph = hasMissingGlyph;
+        if (hasMissingGlyph)
+        {
+            RecordReader::Get(pGlyphRecords, glyphCount, glyphRecord);
+            ReadBundleGlyph(glyphRecord, bundle.mImages, bundle.mMissingGlyph);
+        }
+    }
+
+    void ReadFontBundleFile(const char *path, FontBundle &bundle)
+    {
+        MappedFile file(path);
+
+        ReadFontBundle(file.GetData(), file.GetLength(), bundle);
+    }
+}
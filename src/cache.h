@@ -0,0 +1,409 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "image.h"
+
+
+namespace TextGL
+{
+    /**
+     *  If an arena is given, the glyph is made in there and must not be destroyed.
+     */
+    ImageGlyph *MakeImageGlyph(const FontData &, const FontStyle &, const GlyphData &, Arena *pArena=NULL);
+    void DestroyImageGlyph(ImageGlyph *);
+    void ScaleGlyphMetrics(const GlyphMetrics &metricsSrc, const double scale, GlyphMetrics &metricsDest);
+    void ScaleFontMetrics(const FontMetrics &metricsSrc, const double scale, FontMetrics &metricsDest);
+
+    /**
+     *  Glyphs that point to the same path and have the same metrics look the same.
+     *  The parser gives glyphs with the same outline the same path.
+     */
+    struct SameGlyphHash
+    {
+        size_t operator()(const GlyphData *pGlyphData) const
+        {
+            const GlyphPath &path = pGlyphData->mPath;
+            return std::hash<uint64_t>()((uint64_t)path.firstElement << 32 ^ path.elementCount
+                                         ^ (uint64_t)path.textOffset << 16)
+                 ^ std::hash<double>()(pGlyphData->mMetrics.advanceX);
+        }
+    };
+    struct SameGlyphEqual
+    {
+        bool operator()(const GlyphData *p1, const GlyphData *p2) const
+        {
+            const GlyphPath &path1 = p1->mPath,
+                            &path2 = p2->mPath;
+            const GlyphMetrics &metrics1 = p1->mMetrics,
+                               &metrics2 = p2->mMetrics;
+
+            return path1.firstElement == path2.firstElement && path1.elementCount == path2.elementCount
+                && path1.firstCoord == path2.firstCoord && path1.textOffset == path2.textOffset
+                && metrics1.bearingX == metrics2.bearingX && metrics1.bearingY == metrics2.bearingY
+                && metrics1.width == metrics2.width && metrics1.height == metrics2.height
+                && metrics1.advanceX == metrics2.advanceX;
+        }
+    };
+
+    /**
+     *  Renders the glyphs of one font data and style when they're first asked for.
+     *  Keeps at most maxBytes of images. Beyond that, glyphs that weren't used since
+     *  the clock hand last passed them are evicted. Pinned glyphs are never evicted.
+     *
+     *  Lookups of rendered glyphs don't lock, so that many threads can read at once.
+     *  A glyph that's missing is rendered by one thread, others asking for it wait.
+     *  Evicted glyphs may still be in use on other threads, so they're only destroyed
+     *  by FreeEvicted.
+     */
+    class GlyphCache
+    {
+        private:
+            /**
+             *  One per distinct glyph image. Characters with glyphs that look the same share one.
+             */
+            struct Slot
+            {
+                const GlyphData *pGlyphData;
+
+                std::atomic<ImageGlyph *> pGlyph;  // NULL if not rendered or evicted
+                std::atomic<bool> referenced;  // used since the clock hand passed
+
+                // Only changed while locked:
+                bool rendering;
+                bool resident;  // on the clock
+                unsigned int pinCount;
+                size_t bytes;
+            };
+        public:
+            struct Character
+            {
+                const GlyphData *pGlyphData;
+                GlyphMetrics metrics;  // transformed by size
+                Slot *pSlot;
+            };
+        private:
+            /**
+             *  Hits are counted on several cache lines, so that threads don't keep taking
+             *  the same line from each other.
+             */
+            static const size_t HIT_COUNTER_COUNT = 16;
+            struct alignas(64) HitCounter
+            {
+                std::atomic<size_t> count;
+            };
+
+            const FontData &fontData;
+            FontStyle style;
+            size_t maxBytes;
+
+            // Don't change after construction, so they can be read without locking.
+            std::unordered_map<UTF8Char, Character> characters;
+            std::vector<std::unique_ptr<Slot>> slots;
+
+            HitCounter hitCounters[HIT_COUNTER_COUNT];
+
+            std::mutex mtx;
+            std::condition_variable rendered;
+
+            std::vector<Slot *> clock;  // resident slots
+            size_t clockHand;
+
+            std::vector<ImageGlyph *> evicted;  // waiting to be destroyed
+
+            size_t bytes, evictedBytes,
+                   misses, evictions;
+
+            void operator=(const GlyphCache &) = delete;
+            GlyphCache(const GlyphCache &) = delete;
+
+            static size_t GetImageBytes(const ImageGlyph *pGlyph)
+            {
+                size_t w, h;
+                pGlyph->GetImage()->GetDimensions(w, h);
+                return w * h * 4;
+            }
+
+            void CountHit(void)
+            {
+                static thread_local const size_t i = std::hash<std::thread::id>()(std::this_thread::get_id())
+                                                   % HIT_COUNTER_COUNT;
+                hitCounters[i].count.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            /**
+             *  Must be locked. Never evicts the slot that was just rendered.
+             */
+            void Evict(const Slot *pKeep)
+            {
+                // Two rounds clear every reference bit, so if nothing is evicted by then, all are pinned.
+                size_t nSteps = 0;
+                while (maxBytes > 0 && bytes > maxBytes && nSteps < 2 * clock.size())
+                {
+                    clockHand %= clock.size();
+                    Slot *pSlot = clock[clockHand];
+
+                    if (pSlot == pKeep || pSlot->pinCount > 0)
+                    {
+                        clockHand++;
+                        nSteps++;
+                    }
+                    else if (pSlot->referenced.load(std::memory_order_relaxed))
+                    {
+                        pSlot->referenced.store(false, std::memory_order_relaxed);
+                        clockHand++;
+                        nSteps++;
+                    }
+                    else
+                    {
+                        evicted.push_back(pSlot->pGlyph.exchange(NULL, std::memory_order_acq_rel));
+                        pSlot->resident = false;
+
+                        bytes -= pSlot->bytes;
+                        evictedBytes += pSlot->bytes;
+                        evictions++;
+
+                        clock[clockHand] = clock.back();
+                        clock.pop_back();
+                        nSteps = 0;
+                    }
+                }
+            }
+
+            /**
+             *  Renders the glyph if another thread isn't doing that already.
+             */
+            ImageGlyph *Render(Slot *pSlot)
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+
+                while (pSlot->rendering)
+                    rendered.wait(lock);
+
+                ImageGlyph *pGlyph = pSlot->pGlyph.load(std::memory_order_acquire);
+                if (pGlyph != NULL)
+                {
+                    CountHit();
+                    return pGlyph;
+                }
+
+                misses++;
+                pSlot->rendering = true;
+                lock.unlock();
+
+                try
+                {
+                    pGlyph = MakeImageGlyph(fontData, style, *(pSlot->pGlyphData));
+                }
+                catch (...)
+                {
+                    lock.lock();
+                    pSlot->rendering = false;
+                    rendered.notify_all();
+                    throw;
+                }
+
+                lock.lock();
+                pSlot->rendering = false;
+                pSlot->bytes = GetImageBytes(pGlyph);
+                pSlot->referenced.store(true, std::memory_order_relaxed);
+                pSlot->pGlyph.store(pGlyph, std::memory_order_release);
+
+                pSlot->resident = true;
+                clock.push_back(pSlot);
+                bytes += pSlot->bytes;
+                Evict(pSlot);
+
+                rendered.notify_all();
+
+                return pGlyph;
+            }
+        public:
+            GlyphCache(const FontData &data, const FontStyle &s, const size_t max,
+                       const CharacterSet *pCharacters)
+            : fontData(data), style(s), maxBytes(max), clockHand(0),
+              bytes(0), evictedBytes(0), misses(0), evictions(0)
+            {
+                for (HitCounter &counter : hitCounters)
+                    counter.count.store(0);
+
+                std::unordered_map<const GlyphData *, Slot *, SameGlyphHash, SameGlyphEqual> sharedSlots;
+
+                double scale = style.size / fontData.mMetrics.unitsPerEM;
+                for (const auto &pair : fontData.mGlyphs)
+                {
+                    if (pCharacters != NULL && pCharacters->count(pair.first) == 0)
+                        continue;
+
+                    Slot *&pSlot = sharedSlots[&pair.second];
+                    if (pSlot == NULL)
+                    {
+                        slots.emplace_back(new Slot);
+                        pSlot = slots.back().get();
+
+                        pSlot->pGlyphData = &pair.second;
+                        pSlot->pGlyph.store(NULL);
+                        pSlot->referenced.store(false);
+                        pSlot->rendering = false;
+                        pSlot->resident = false;
+                        pSlot->pinCount = 0;
+                        pSlot->bytes = 0;
+                    }
+
+                    Character &character = characters[pair.first];
+                    character.pGlyphData = &pair.second;
+                    character.pSlot = pSlot;
+                    ScaleGlyphMetrics(pair.second.mMetrics, scale, character.metrics);
+                }
+            }
+
+            ~GlyphCache(void)
+            {
+                FreeEvicted();
+
+                for (Slot *pSlot : clock)
+                    DestroyImageGlyph(pSlot->pGlyph.load());
+            }
+
+            /**
+             *  returns NULL if the font has no glyph for the character.
+             */
+            const Character *FindCharacter(const UTF8Char c) const
+            {
+                auto it = characters.find(c);
+                if (it == characters.end())
+                    return NULL;
+
+                return &(it->second);
+            }
+
+            const std::unordered_map<UTF8Char, Character> &GetCharacters(void) const
+            {
+                return characters;
+            }
+
+            /**
+             *  Doesn't lock if the glyph is there. The glyph stays valid until FreeEvicted is called.
+             */
+            const ImageGlyph *GetGlyph(const Character &character)
+            {
+                Slot *pSlot = character.pSlot;
+
+                ImageGlyph *pGlyph = pSlot->pGlyph.load(std::memory_order_acquire);
+                if (pGlyph == NULL)
+                    return Render(pSlot);
+
+                // Only write when needed, so that readers don't keep taking the cache line from each other.
+                if (!pSlot->referenced.load(std::memory_order_relaxed))
+                    pSlot->referenced.store(true, std::memory_order_relaxed);
+
+                CountHit();
+                return pGlyph;
+            }
+
+            void Pin(const Character &character)
+            {
+                Slot *pSlot = character.pSlot;
+                while (true)
+                {
+                    GetGlyph(character);
+
+                    std::lock_guard<std::mutex> lock(mtx);
+
+                    // Might have been evicted again, before the lock was taken.
+                    if (pSlot->resident)
+                    {
+                        pSlot->pinCount++;
+                        return;
+                    }
+                }
+            }
+
+            void Unpin(const Character &character)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+
+                Slot *pSlot = character.pSlot;
+                if (pSlot->pinCount == 0)
+                    return;
+
+                pSlot->pinCount--;
+                if (pSlot->pinCount == 0)
+                    Evict(NULL);
+            }
+
+            /**
+             *  Evicts right away, if the glyphs take more than the new maximum.
+             */
+            void SetMaxBytes(const size_t max)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+
+                maxBytes = max;
+                Evict(NULL);
+            }
+
+            /**
+             *  Destroys the evicted glyphs. No other thread may use glyphs from this cache meanwhile.
+             */
+            void FreeEvicted(void)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+
+                for (ImageGlyph *pGlyph : evicted)
+                    DestroyImageGlyph(pGlyph);
+                evicted.clear();
+                evictedBytes = 0;
+            }
+
+            GlyphCacheStats GetStats(void)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+
+                GlyphCacheStats stats;
+                stats.hits = 0;
+                for (const HitCounter &counter : hitCounters)
+                    stats.hits += counter.count.load(std::memory_order_relaxed);
+                stats.misses = misses;
+                stats.evictions = evictions;
+                stats.glyphCount = clock.size();
+                stats.bytes = bytes;
+                stats.evictedBytes = evictedBytes;
+                return stats;
+            }
+
+            void ResetStats(void)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+
+                for (HitCounter &counter : hitCounters)
+                    counter.count.store(0, std::memory_order_relaxed);
+                misses = evictions = 0;
+            }
+    };
+}
+
+#endif  // CACHE_H
@@ -15,59 +15,167 @@
 */
 
 #include <math.h>
+#include <string.h>
 #include <algorithm>
+#include <vector>
 
 #include <cairo/cairo.h>
 
 #include "image.h"
+#include "arc.h"
+#include "arena.h"
+#include "cache.h"
+#include "pixels.h"
 
 
 namespace TextGL
 {
-    class CairoImage: public Image
+    /**
+     *  Without an arena, the image is on the heap and owns its pixels.
+     */
+    PixelImage *NewPixelImage(const size_t w, const size_t h, Arena *pArena)
+    {
+        if (pArena == NULL)
+            return new PixelImage(w, h);
+
+        uint32_t *pixels = (uint32_t *)pArena->Allocate(w * h * sizeof(uint32_t), 16);
+        return new (pArena->Allocate(sizeof(PixelImage), alignof(PixelImage))) PixelImage(w, h, pixels);
+    }
+
+    void DeletePixelImage(PixelImage *pImage, Arena *pArena)
+    {
+        if (pArena == NULL)
+            delete pImage;
+    }
+
+    /**
+     *  A cairo surface and context, that one thread draws its glyphs on, one after the other.
+     *  It grows to fit the largest glyph so far.
+     */
+    class CairoScratch
     {
         private:
             cairo_surface_t *pSurface;
-        public:
-            CairoImage(const size_t w, const size_t h)
+            cairo_t *cr;
+            int width, height;
+
+            void Destroy(void)
+            {
+                if (cr != NULL)
+                    cairo_destroy(cr);
+                if (pSurface != NULL)
+                    cairo_surface_destroy(pSurface);
+
+                cr = NULL;
+                pSurface = NULL;
+                width = height = 0;
+            }
+
+            void Create(const int w, const int h)
             {
                 pSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
 
                 cairo_status_t status = cairo_surface_status(pSurface);
                 if (status != CAIRO_STATUS_SUCCESS)
                 {
+                    Destroy();
                     throw FontImageError("%s while creating a cairo surface", cairo_status_to_string(status));
                 }
-            }
 
-            ~CairoImage(void)
+                cr = cairo_create(pSurface);
+
+                status = cairo_status(cr);
+                if (status != CAIRO_STATUS_SUCCESS)
+                {
+                    Destroy();
+                    throw FontImageError("%s while creating a cairo context", cairo_status_to_string(status));
+                }
+
+                cairo_set_antialias(cr, CAIRO_ANTIALIAS_BEST);
+
+                width = w;
+                height = h;
+            }
+        public:
+            CairoScratch(void): pSurface(NULL), cr(NULL), width(0), height(0)
             {
-                cairo_surface_destroy(pSurface);
             }
 
-            const void *GetData(void) const
+            ~CairoScratch(void)
             {
-                cairo_image_surface_get_data(pSurface);
+                Destroy();
             }
 
-            ImageDataFormat GetFormat(void) const
+            /**
+             *  Clears the top left w x h pixels and saves the state of the context, before drawing.
+             */
+            cairo_t *Begin(const int w, const int h)
             {
-                return IMAGEFORMAT_ARGB32;
+                if (w <= 0 || h <= 0)
+                {
+                    // Let cairo judge the size, like it would for a surface of its own.
+                    Destroy();
+                    Create(w, h);
+                }
+                else if (pSurface == NULL || w > width || h > height)
+                {
+                    int newWidth = std::max(w, width),
+                        newHeight = std::max(h, height);
+
+                    // A new surface is clear already.
+                    Destroy();
+                    Create(newWidth, newHeight);
+                }
+                else
+                {
+                    cairo_surface_flush(pSurface);
+
+                    unsigned char *data = cairo_image_surface_get_data(pSurface);
+                    int stride = cairo_image_surface_get_stride(pSurface);
+                    for (int y = 0; y < h; y++)
+                        memset(data + y * stride, 0, w * sizeof(uint32_t));
+
+                    cairo_surface_mark_dirty(pSurface);
+                }
+
+                cairo_save(cr);
+                return cr;
             }
 
-            void GetDimensions(size_t &w, size_t &h) const
+            /**
+             *  Restores the context and copies the top left w x h pixels.
+             */
+            void End(const int w, const int h, uint32_t *pixels)
             {
-                w = cairo_image_surface_get_width(pSurface);
-                h = cairo_image_surface_get_height(pSurface);
+                cairo_restore(cr);
+                cairo_new_path(cr);  // not part of the saved state
+                cairo_surface_flush(pSurface);
+
+                cairo_status_t status = cairo_status(cr);
+                if (status != CAIRO_STATUS_SUCCESS)
+                {
+                    // Errors stick to the context, so start over with a new one.
+                    Destroy();
+                    throw FontImageError("%s while drawing a glyph", cairo_status_to_string(status));
+                }
+
+                const unsigned char *data = cairo_image_surface_get_data(pSurface);
+                int stride = cairo_image_surface_get_stride(pSurface);
+                for (int y = 0; y < h; y++)
+                    memcpy(pixels + y * w, data + y * stride, w * sizeof(uint32_t));
             }
 
-            friend CairoImage *MakeCairoGlyphImage(const FontData &fontData,
-                                                   const FontStyle &style,
-                                                   const GlyphData &glyphData);
+            /**
+             *  After an exception while drawing, the state of the context is unknown.
+             */
+            void Abort(void)
+            {
+                Destroy();
+            }
     };
 
     void CairoArcTo(cairo_t *cr, const double currentX, const double currentY,
-                                 double rx, double ry, const double rotate,
+                                 const double rx, const double ry, const double rotate,
                                  const bool largeArc, const bool sweep, const double x, const double y)
     {
         if (rx == 0.0 || ry == 0.0)  // means straight line
@@ -78,104 +186,68 @@ namespace TextGL
         else if (x == currentX && y == currentY)
             return;
 
-        double radiiRatio = ry / rx,
-
-               dx = x - currentX,
-               dy = y - currentY,
-
-               // Transform the target point from elipse to circle
-               xe = dx * cos(-rotate) - dy * sin(-rotate),
-               ye =(dy * cos(-rotate) + dx * sin(-rotate)) / radiiRatio,
-
-               // angle between the line from current to target point and the x axis
-               angle = atan2(ye, xe);
-
-        // Move the target point onto the x axis
-        // The current point was already on the x-axis
-        xe = sqrt(xe * xe + ye * ye);
-        ye = 0.0;
-
-        // Update the first radius if it is too small
-        rx = std::max(rx, xe / 2);
-
-        // Find one circle centre
-        double xc = xe / 2,
-               yc = sqrt(rx * rx - xc * xc);
-
-        // fix for a glitch, appearing on some machines:
-        if (rx == xc)
-            yc = 0.0;
-
-        // Use the flags to pick a circle center
-        if (!(largeArc != sweep))
-            yc = -yc;
-
-        // Rotate the target point and the center back to their original circle positions
-
-        double sinAngle = sin(angle),
-               cosAngle = cos(angle);
-
-        ye = xe * sinAngle;
-        xe = xe * cosAngle;
-
-        double ax = xc * cosAngle - yc * sinAngle,
-               ay = yc * cosAngle + xc * sinAngle;
-        xc = ax;
-        yc = ay;
-
-        // Find the drawing angles, from center to current and target points on circle:
-        double angle1 = atan2(0.0 - yc, 0.0 - xc),  // current is shifted to 0,0
-               angle2 = atan2( ye - yc,  xe - xc);
+        ArcCircle circle;
+        GetArcCircle(currentX, currentY, rx, ry, rotate, largeArc, sweep, x, y, circle);
 
         cairo_save(cr);
         cairo_translate(cr, currentX, currentY);
         cairo_rotate(cr, rotate);
-        cairo_scale(cr, 1.0, radiiRatio);
+        cairo_scale(cr, 1.0, circle.radiiRatio);
 
         if (sweep)
         {
-            cairo_arc(cr, xc, yc, rx, angle1, angle2);
+            cairo_arc(cr, circle.xc, circle.yc, circle.radius, circle.angle1, circle.angle2);
         }
         else
         {
-            cairo_arc_negative(cr, xc, yc, rx, angle1, angle2);
+            cairo_arc_negative(cr, circle.xc, circle.yc, circle.radius, circle.angle1, circle.angle2);
         }
 
         cairo_restore(cr);
     }
 
-    void PathToCairo(const std::list<GlyphPathElement> &path, cairo_t *cr)
+    void PathToCairo(const GlyphPathView &path, cairo_t *cr)
     {
         double currentX = 0.0,
                currentY = 0.0;
-        for (const GlyphPathElement &el : path)
+
+        const uint8_t *pType = path.pElementTypes,
+                      *pEnd = pType + path.elementCount;
+        const float *pCoords = path.pCoords;
+        for (; pType < pEnd; pType++)
         {
-            switch (el.type)
+            switch (*pType)
             {
             case ELEMENT_MOVETO:
-                cairo_move_to(cr, el.x, el.y);
+                cairo_move_to(cr, pCoords[0], pCoords[1]);
                 break;
             case ELEMENT_LINETO:
-                cairo_line_to(cr, el.x, el.y);
+                cairo_line_to(cr, pCoords[0], pCoords[1]);
                 break;
             case ELEMENT_CURVETO:
-                cairo_curve_to(cr, el.x1, el.y1, el.x2, el.y2, el.x, el.y);
+                cairo_curve_to(cr, pCoords[0], pCoords[1], pCoords[2], pCoords[3], pCoords[4], pCoords[5]);
                 break;
             case ELEMENT_ARCTO:
                 CairoArcTo(cr, currentX, currentY,
-                               el.rx, el.ry,
-                               el.rotate, el.largeArc, el.sweep,
-                               el.x, el.y);
+                               pCoords[0], pCoords[1],
+                               pCoords[2], pCoords[3] != 0.0f, pCoords[4] != 0.0f,
+                               pCoords[5], pCoords[6]);
                 break;
             case ELEMENT_CLOSEPATH:
                 cairo_close_path(cr);
                 break;
             default:
-                throw FontImageError("Unsupported path element: %x", el.type);
+                throw FontImageError("Unsupported path element: %x", *pType);
             }
 
-            currentX = el.x;
-            currentY = el.y;
+            // The last two coordinates are the end point, closepath keeps the current point.
+            uint8_t nCoords = PATH_ELEMENT_COORD_COUNTS[*pType];
+            pCoords += nCoords;
+            if (nCoords > 0)
+            {
+                currentX = pCoords[-2];
+                currentY = pCoords[-1];
+            }
         }
     }
 
@@ -230,10 +302,14 @@ namespace TextGL
         }
     }
 
-    CairoImage *MakeCairoGlyphImage(const FontData &fontData,
+    PixelImage *MakeCairoGlyphImage(const FontData &fontData,
                                     const FontStyle &style,
-                                    const GlyphData &glyphData)
+                                    const GlyphData &glyphData,
+                                    Arena *pArena)
     {
+        // Parse it first if needed, before there's anything to clean up.
+        GlyphPathView path = GetGlyphPath(fontData, glyphData);
+
         double scale = style.size / fontData.mMetrics.unitsPerEM;
 
         /* Cairo surfaces and OpenGL textures have integer dimensions, but
@@ -242,44 +318,99 @@ namespace TextGL
         int w = (int)ceil((fontData.mMetrics.bbox.right - fontData.mMetrics.bbox.left) * scale),
             h = (int)ceil((fontData.mMetrics.bbox.top - fontData.mMetrics.bbox.bottom) * scale);
 
-        CairoImage *pCairoImage = new CairoImage(w, h);
+        // Drawing on a new surface and context for every glyph would take a lot of allocation and setup.
+        static thread_local CairoScratch scratch;
+        cairo_t *cr = scratch.Begin(w, h);
 
-        cairo_t *cr = cairo_create(pCairoImage->pSurface);
+        try
+        {
+            // Within the cairo surface, move to the glyph's coordinate system.
+            cairo_scale(cr, scale, scale);
+            cairo_translate(cr, -fontData.mMetrics.bbox.left, -fontData.mMetrics.bbox.bottom);
+
+            #ifdef DEBUG
+                // Draw a red rectangle to indicate the bounding box.
+                cairo_set_source_rgb(cr, 1.0, 0.0, 0.0);
+                cairo_rectangle(cr, fontData.mMetrics.bbox.left, fontData.mMetrics.bbox.bottom,
+                                    fontData.mMetrics.bbox.right - fontData.mMetrics.bbox.left,
+                                    fontData.mMetrics.bbox.top - fontData.mMetrics.bbox.bottom);
+                cairo_set_line_width(cr, 1.0);
+                cairo_stroke(cr);
+            #endif  // DEBUG
+
+            // Set the path in cairo.
+            PathToCairo(path, cr);
+
+            // Fill it in, according to the font style.
+            CairoDrawPath(cr, style, scale);
+        }
+        catch (...)
+        {
+            scratch.Abort();
+            throw;
+        }
 
-        cairo_status_t status = cairo_status(cr);
-        if (status != CAIRO_STATUS_SUCCESS)
+        PixelImage *pImage = NewPixelImage(w, h, pArena);
+        try
         {
-            delete pCairoImage;
-            throw FontImageError("%s while creating a cairo context", cairo_status_to_string(status));
+            scratch.End(w, h, pImage->GetPixels());
+        }
+        catch (...)
+        {
+            DeletePixelImage(pImage, pArena);
+            throw;
         }
 
-        cairo_set_antialias(cr, CAIRO_ANTIALIAS_BEST);
+        return pImage;
+    }
 
-        // Within the cairo surface, move to the glyph's coordinate system.
-        cairo_scale(cr, scale, scale);
-        cairo_translate(cr, -fontData.mMetrics.bbox.left, -fontData.mMetrics.bbox.bottom);
+    /**
+     *  Fills the glyph with the built in rasterizer. Ignores the stroke.
+     */
+    PixelImage *MakeNativeGlyphImage(const FontData &fontData,
+                                     const FontStyle &style,
+                                     const GlyphData &glyphData,
+                                     Arena *pArena)
+    {
+        GlyphPathView path = GetGlyphPath(fontData, glyphData);
 
-        #ifdef DEBUG
-            // Draw a red rectangle to indicate the bounding box.
-            cairo_set_source_rgb(cr, 1.0, 0.0, 0.0);
-            cairo_rectangle(cr, fontData.mMetrics.bbox.left, fontData.mMetrics.bbox.bottom,
-                                fontData.mMetrics.bbox.right - fontData.mMetrics.bbox.left,
-                                fontData.mMetrics.bbox.top - fontData.mMetrics.bbox.bottom);
-            cairo_set_line_width(cr, 1.0);
-            cairo_stroke(cr);
-        #endif  // DEBUG
+        double scale = style.size / fontData.mMetrics.unitsPerEM;
 
-        // Set the path in cairo.
-        PathToCairo(glyphData.mPath, cr);
+        // The same size and placement as in MakeCairoGlyphImage.
+        int w = (int)ceil((fontData.mMetrics.bbox.right - fontData.mMetrics.bbox.left) * scale),
+            h = (int)ceil((fontData.mMetrics.bbox.top - fontData.mMetrics.bbox.bottom) * scale);
+
+        if (style.fillColor.a <= 0.0)
+        {
+            PixelImage *pImage = NewPixelImage(w, h, pArena);
+            memset(pImage->GetPixels(), 0, w * h * sizeof(uint32_t));
+            return pImage;
+        }
+
+        static thread_local std::vector<uint8_t> coverage;
+        coverage.resize(w * h);
 
-        // Fill it in, according to the font style.
-        CairoDrawPath(cr, style, scale);
-        cairo_surface_flush(pCairoImage->pSurface);
+        RasterizePathCoverage(path, scale,
+                              -fontData.mMetrics.bbox.left * scale, -fontData.mMetrics.bbox.bottom * scale,
+                              w, h, coverage.data(), w);
 
-        // Don't need this anymore, we're done drawing to the surface.
-        cairo_destroy(cr);
+        // Premultiplied, like cairo has it, for every coverage value.
+        uint32_t colors[256];
+        for (int i = 0; i < 256; i++)
+        {
+            double a = style.fillColor.a * i / 255;
+            colors[i] = (uint32_t)(a * 255 + 0.5) << 24
+                      | (uint32_t)(style.fillColor.r * a * 255 + 0.5) << 16
+                      | (uint32_t)(style.fillColor.g * a * 255 + 0.5) << 8
+                      | (uint32_t)(style.fillColor.b * a * 255 + 0.5);
+        }
 
-        return pCairoImage;
+        PixelImage *pImage = NewPixelImage(w, h, pArena);
+        uint32_t *pixels = pImage->GetPixels();
+        for (size_t i = 0; i < coverage.size(); i++)
+            pixels[i] = colors[coverage[i]];
+
+        return pImage;
     }
 
     void ScaleGlyphMetrics(const GlyphMetrics &metricsSrc, const double scale, GlyphMetrics &metricsDest)
@@ -291,6 +422,9 @@ namespace TextGL
         metricsDest.advanceX = metricsSrc.advanceX * scale;
     }
 
+    /**
+     *  Only for glyphs that aren't in an arena.
+     */
     void DestroyImageGlyph(ImageGlyph *p)
     {
         delete p->mImage;
@@ -299,13 +433,25 @@ namespace TextGL
 
     ImageGlyph *MakeImageGlyph(const FontData &fontData,
                                const FontStyle &style,
-                               const GlyphData &glyphData)
+                               const GlyphData &glyphData,
+                               Arena *pArena)
     {
         double scale = style.size / fontData.mMetrics.unitsPerEM;
 
-        ImageGlyph *pImageGlyph = new ImageGlyph;
+        Image *pImage;
+        bool stroked = style.strokeWidth > 0.0 && style.strokeColor.a > 0.0;
+        if (style.rasterizer == RASTERIZER_NATIVE && !stroked)
+            pImage = MakeNativeGlyphImage(fontData, style, glyphData, pArena);
+        else
+            pImage = MakeCairoGlyphImage(fontData, style, glyphData, pArena);
+
+        ImageGlyph *pImageGlyph;
+        if (pArena != NULL)
+            pImageGlyph = new (pArena->Allocate(sizeof(ImageGlyph), alignof(ImageGlyph))) ImageGlyph;
+        else
+            pImageGlyph = new ImageGlyph;
 
-        pImageGlyph->mImage = MakeCairoGlyphImage(fontData, style, glyphData);
+        pImageGlyph->mImage = pImage;
 
         ScaleGlyphMetrics(glyphData.mMetrics, scale, pImageGlyph->mMetrics);
 
@@ -324,24 +470,33 @@ namespace TextGL
         metricsDest.bbox.bottom = metricsSrc.bbox.bottom * scale;
     }
 
-    void ScaleKernTable(const KernTable &tableSrc, const double scale, KernTable &tableDest)
+    typedef std::unordered_map<const GlyphData *, ImageGlyph *, SameGlyphHash, SameGlyphEqual> SharedImageGlyphs;
+
+    bool InCharacterSet(const CharacterSet *pCharacters, const UTF8Char c)
     {
-        for (const std::pair<UTF8Char, std::unordered_map<UTF8Char, double>> &pair1 : tableSrc)
-        {
-            UTF8Char c1 = std::get<0>(pair1);
-            std::unordered_map<UTF8Char, double> m2 = std::get<1>(pair1);
-            for (const std::pair<UTF8Char, double> &pair2 : m2)
-            {
-                UTF8Char c2 = std::get<0>(pair2);
+        return pCharacters == NULL || pCharacters->count(c) > 0;
+    }
 
-                double k = std::get<1>(pair2);
+    std::shared_ptr<const FontMetricsStore> GetFontMetricsStore(const FontData &fontData)
+    {
+        std::shared_ptr<const FontMetricsStore> pStore = std::atomic_load(&fontData.mMetricsStore);
+        if (pStore != NULL)
+            return pStore;
 
-                tableDest[c1][c2] = k * scale;
-            }
-        }
+        std::shared_ptr<FontMetricsStore> pNewStore = std::make_shared<FontMetricsStore>();
+        pNewStore->mMetrics = fontData.mMetrics;
+        pNewStore->mHorizontalKernTable = fontData.mHorizontalKernTable;
+
+        // Another thread might have made one meanwhile, then use that one.
+        pStore = pNewStore;
+        std::shared_ptr<const FontMetricsStore> pExpected;
+        if (!std::atomic_compare_exchange_strong(&fontData.mMetricsStore, &pExpected, pStore))
+            return pExpected;
+
+        return pStore;
     }
 
-    ImageFont *MakeImageFont(const FontData &fontData, const FontStyle &style)
+    ImageFont *MakeImageFont(const FontData &fontData, const FontStyle &style, const CharacterSet *pCharacters)
     {
         double scale = style.size / fontData.mMetrics.unitsPerEM;
 
@@ -349,21 +504,91 @@ namespace TextGL
 
         ScaleFontMetrics(fontData.mMetrics, scale, pImageFont->mMetrics);
 
-        ScaleKernTable(fontData.mHorizontalKernTable, scale, pImageFont->mHorizontalKernTable);
+        pImageFont->mUnscaled = GetFontMetricsStore(fontData);
+        pImageFont->mScale = scale;
+        pImageFont->mSubset = pCharacters != NULL;
 
-        for (const std::pair<UTF8Char, GlyphData> &pair : fontData.mGlyphs)
+        pImageFont->style = style;
+
+        // All glyphs live as long as the font, so they go in one arena.
+        pImageFont->mArena = new Arena;
+        Arena *pArena = pImageFont->mArena;
+
+        // Glyphs that look the same are rendered once.
+        SharedImageGlyphs sharedGlyphs;
+        sharedGlyphs.reserve(fontData.mGlyphs.size() + 1);
+        pImageFont->mGlyphs.reserve(pCharacters != NULL ? pCharacters->size() : fontData.mGlyphs.size());
+        auto MakeSharedImageGlyph = [&fontData, &style, &sharedGlyphs, pArena](const GlyphData &glyphData)
+        {
+            auto it = sharedGlyphs.find(&glyphData);
+            if (it != sharedGlyphs.end())
+                return it->second;
+
+            ImageGlyph *pGlyph = MakeImageGlyph(fontData, style, glyphData, pArena);
+            sharedGlyphs.emplace(&glyphData, pGlyph);
+            return pGlyph;
+        };
+
+        if (fontData.mHasMissingGlyph)
+        {
+            try
+            {
+                pImageFont->mMissingGlyph = MakeSharedImageGlyph(fontData.mMissingGlyph);
+            }
+            catch (...)
+            {
+                DestroyImageFont(pImageFont);
+                throw;
+            }
+        }
+
+        for (const auto &pair : fontData.mGlyphs)
         {
             UTF8Char c = std::get<0>(pair);
+            if (!InCharacterSet(pCharacters, c))
+                continue;
 
             try
             {
-                ImageGlyph *pGlyph = MakeImageGlyph(fontData, style, fontData.mGlyphs.at(c));
+                ImageGlyph *pGlyph = MakeSharedImageGlyph(std::get<1>(pair));
                 pImageFont->mGlyphs[c] = pGlyph;
             }
             catch (...)
             {
                 DestroyImageFont(pImageFont);
-                std::rethrow_exception(std::current_exception());
+                throw;
+            }
+        }
+
+        return pImageFont;
+    }
+    ImageFont *MakeLazyImageFont(const FontData &fontData, const FontStyle &style, const size_t maxBytes,
+                                 const CharacterSet *pCharacters)
+    {
+        double scale = style.size / fontData.mMetrics.unitsPerEM;
+
+        ImageFont *pImageFont = new ImageFont;
+
+        ScaleFontMetrics(fontData.mMetrics, scale, pImageFont->mMetrics);
+
+        pImageFont->mUnscaled = GetFontMetricsStore(fontData);
+        pImageFont->mScale = scale;
+        pImageFont->mSubset = pCharacters != NULL;
+
+        pImageFont->style = style;
+        pImageFont->mCache = new GlyphCache(fontData, style, maxBytes, pCharacters);
+
+        // Drawn in place of any glyph that's not there, so needed anyway.
+        if (fontData.mHasMissingGlyph)
+        {
+            try
+            {
+                pImageFont->mMissingGlyph = MakeImageGlyph(fontData, style, fontData.mMissingGlyph);
+            }
+            catch (...)
+            {
+                DestroyImageFont(pImageFont);
+                throw;
             }
         }
 
@@ -374,11 +599,13 @@ namespace TextGL
         if (p == NULL)
             return;
 
-        for (auto &pair : p->mGlyphs)
-        {
-            DestroyImageGlyph(std::get<1>(pair));
-        }
+        // Glyphs rendered up front are all in the arena, lazy fonts only made their missing glyph themselves.
+        if (p->mArena != NULL)
+            delete p->mArena;
+        else if (p->mMissingGlyph != NULL)
+            DestroyImageGlyph(p->mMissingGlyph);
 
+        delete p->mCache;
         delete p;
     }
 
@@ -388,7 +615,7 @@ namespace TextGL
     ImageGlyph::~ImageGlyph(void)
     {
     }
-    ImageFont::ImageFont(void)
+    ImageFont::ImageFont(void): mMissingGlyph(NULL), mScale(1.0), mSubset(false), mCache(NULL), mArena(NULL)
     {
     }
     ImageFont::~ImageFont(void)
@@ -402,23 +629,329 @@ namespace TextGL
     {
         return &mMetrics;
     }
-    const KernTable *ImageFont::GetHorizontalKernTable(void) const
+    double ImageFont::GetHorizontalKern(const UTF8Char c1, const UTF8Char c2) const
     {
-        return &mHorizontalKernTable;
+        double k = GetKernValue(mUnscaled->mHorizontalKernTable, c1, c2);
+        if (k == 0.0)
+            return 0.0;
+
+        // Characters outside the subset don't kern.
+        if (mSubset)
+        {
+            if (mCache != NULL && (mCache->FindCharacter(c1) == NULL || mCache->FindCharacter(c2) == NULL))
+                return 0.0;
+            else if (mCache == NULL && (mGlyphs.count(c1) == 0 || mGlyphs.count(c2) == 0))
+                return 0.0;
+        }
+
+        return k * mScale;
     }
     const ImageGlyph *ImageFont::GetGlyph(const UTF8Char c) const
     {
+        if (mCache != NULL)
+        {
+            const GlyphCache::Character *pCharacter = mCache->FindCharacter(c);
+            if (pCharacter == NULL)
+                throw MissingGlyphError(c);
+
+            return mCache->GetGlyph(*pCharacter);
+        }
+
         if (mGlyphs.find(c) == mGlyphs.end())
             throw MissingGlyphError(c);
 
         return mGlyphs.at(c);
     }
+    bool ImageFont::HasGlyph(const UTF8Char c) const noexcept
+    {
+        if (mCache != NULL)
+            return mCache->FindCharacter(c) != NULL;
+
+        return mGlyphs.find(c) != mGlyphs.end();
+    }
+    const ImageGlyph *ImageFont::FindGlyph(const UTF8Char c) const noexcept
+    {
+        if (mCache != NULL)
+        {
+            const GlyphCache::Character *pCharacter = mCache->FindCharacter(c);
+            if (pCharacter == NULL)
+                return mMissingGlyph;
+
+            try
+            {
+                return mCache->GetGlyph(*pCharacter);
+            }
+            catch (...)
+            {
+                return mMissingGlyph;
+            }
+        }
+
+        auto it = mGlyphs.find(c);
+        if (it == mGlyphs.end())
+            return mMissingGlyph;
+
+        return it->second;
+    }
     const GlyphMetrics *ImageFont::GetGlyphMetrics(const UTF8Char c) const
     {
+        // Lazily rendered fonts have the metrics without rendering.
+        if (mCache != NULL)
+        {
+            const GlyphCache::Character *pCharacter = mCache->FindCharacter(c);
+            if (pCharacter == NULL)
+                throw MissingGlyphError(c);
+
+            return &(pCharacter->metrics);
+        }
+
         return GetGlyph(c)->GetMetrics();
     }
+    const GlyphMetrics *ImageFont::FindGlyphMetrics(const UTF8Char c) const noexcept
+    {
+        if (mCache != NULL)
+        {
+            const GlyphCache::Character *pCharacter = mCache->FindCharacter(c);
+            if (pCharacter != NULL)
+                return &(pCharacter->metrics);
+            else if (mMissingGlyph != NULL)
+                return mMissingGlyph->GetMetrics();
+            else
+                return NULL;
+        }
+
+        const ImageGlyph *pGlyph = FindGlyph(c);
+        if (pGlyph == NULL)
+            return NULL;
+
+        return pGlyph->GetMetrics();
+    }
+    void ImageFont::PinGlyph(const UTF8Char c)
+    {
+        if (mCache == NULL)
+            return;
+
+        const GlyphCache::Character *pCharacter = mCache->FindCharacter(c);
+        if (pCharacter == NULL)
+            throw MissingGlyphError(c);
+
+        mCache->Pin(*pCharacter);
+    }
+    void ImageFont::UnpinGlyph(const UTF8Char c)
+    {
+        if (mCache == NULL)
+            return;
+
+        const GlyphCache::Character *pCharacter = mCache->FindCharacter(c);
+        if (pCharacter != NULL)
+            mCache->Unpin(*pCharacter);
+    }
+    void ImageFont::FreeEvictedGlyphs(void)
+    {
+        if (mCache != NULL)
+            mCache->FreeEvicted();
+    }
+    GlyphCacheStats ImageFont::GetCacheStats(void) const
+    {
+        if (mCache == NULL)
+            return GlyphCacheStats();
+
+        return mCache->GetStats();
+    }
+    void ImageFont::ResetCacheStats(void)
+    {
+        if (mCache != NULL)
+            mCache->ResetStats();
+    }
+
+    bool SameColor(const Color &color1, const Color &color2)
+    {
+        return color1.r == color2.r && color1.g == color2.g && color1.b == color2.b && color1.a == color2.a;
+    }
+    size_t ImageFontCache::StyleKeyHash::operator()(const StyleKey &key) const
+    {
+        const FontStyle &style = key.style;
+        size_t h = std::hash<const FontData *>()(key.pFontData);
+        for (double d : {style.strokeWidth,
+                         (double)style.fillColor.r, (double)style.fillColor.g,
+                         (double)style.fillColor.b, (double)style.fillColor.a,
+                         (double)style.strokeColor.r, (double)style.strokeColor.g,
+                         (double)style.strokeColor.b, (double)style.strokeColor.a})
+            h = h * 31 + std::hash<double>()(d);
+
+        return h ^ (style.lineJoin << 8 | style.lineCap << 4 | style.rasterizer);
+    }
+    bool ImageFontCache::StyleKeyEqual::operator()(const StyleKey &key1, const StyleKey &key2) const
+    {
+        const FontStyle &style1 = key1.style,
+                        &style2 = key2.style;
+
+        return key1.pFontData == key2.pFontData && style1.strokeWidth == style2.strokeWidth
+            && SameColor(style1.fillColor, style2.fillColor) && SameColor(style1.strokeColor, style2.strokeColor)
+            && style1.lineJoin == style2.lineJoin && style1.lineCap == style2.lineCap
+            && style1.rasterizer == style2.rasterizer;
+    }
+    ImageFontCache::ImageFontCache(const size_t maxBytes, const unsigned int bucketsPerOctave,
+                                   const double maxReuseScale)
+    : mMaxBytes(maxBytes), mBucketsPerOctave(std::max(1u, bucketsPerOctave)), mMaxReuseScale(maxReuseScale),
+      mHits(0), mReuses(0), mMisses(0), mEvictions(0)
+    {
+    }
+    ImageFontCache::~ImageFontCache(void)
+    {
+        Clear();
+    }
+    double ImageFontCache::GetBucketSize(const int bucket) const
+    {
+        return pow(2.0, (double)bucket / mBucketsPerOctave);
+    }
+    /**
+     *  Each font gets an equal part, so that together they keep no more than the budget.
+     */
+    void ImageFontCache::SplitBudget(void)
+    {
+        if (mMaxBytes == 0 || mEntries.empty())
+            return;
+
+        // Zero would mean no limit.
+        size_t fontBytes = std::max((size_t)1, mMaxBytes / mEntries.size());
+        for (Entry &entry : mEntries)
+            entry.pFont->mCache->SetMaxBytes(fontBytes);
+    }
+    SizedImageFont ImageFontCache::GetFont(const FontData &fontData, const FontStyle &style)
+    {
+        if (style.size <= 0.0)
+            throw FontImageError("Font size must be positive, not %f", style.size);
+
+        StyleKey key = {&fontData, style};
+        key.style.size = 0.0;
+
+        double octaves = log2(style.size);
+        int bucket = (int)round(octaves * mBucketsPerOctave);
+
+        // Take the bucket's own font, or else the nearest other bucket, if it's near enough.
+        std::list<Entry>::iterator pEntry = mEntries.end();
+        auto found = mBuckets.find(key);
+        if (found != mBuckets.end())
+        {
+            const std::map<int, std::list<Entry>::iterator> &buckets = found->second;
+
+            auto it = buckets.find(bucket);
+            if (it != buckets.end())
+            {
+                mHits++;
+            }
+            else
+            {
+                auto above = buckets.lower_bound(bucket);
+                double maxOctaves = log2(std::max(1.0, mMaxReuseScale)),
+                       nearestOctaves = maxOctaves;
+
+                if (above != buckets.end())
+                {
+                    double distance = (double)above->first / mBucketsPerOctave - octaves;
+                    if (distance <= nearestOctaves)
+                    {
+                        it = above;
+                        nearestOctaves = distance;
+                    }
+                }
+                if (above != buckets.begin())
+                {
+                    auto below = std::prev(above);
+                    double distance = octaves - (double)below->first / mBucketsPerOctave;
+                    if (distance <= nearestOctaves)
+                        it = below;
+                }
+
+                if (it != buckets.end())
+                    mReuses++;
+            }
+
+            if (it != buckets.end())
+                pEntry = it->second;
+        }
+
+        if (pEntry == mEntries.end())
+        {
+            mMisses++;
+
+            Entry entry = {&fontData, style, bucket, NULL};
+            entry.style.size = GetBucketSize(bucket);
+            entry.pFont = MakeLazyImageFont(fontData, entry.style, mMaxBytes);
+
+            // Only add the buckets now, so that a font that fails to be made leaves nothing behind.
+            mEntries.push_front(entry);
+            pEntry = mEntries.begin();
+            mBuckets[key].emplace(bucket, pEntry);
+
+            SplitBudget();
+        }
+        else
+        {
+            // Move to the front, it's now the most recently used.
+            mEntries.splice(mEntries.begin(), mEntries, pEntry);
+        }
+
+        return {pEntry->pFont, style.size / pEntry->style.size};
+    }
+    void ImageFontCache::Trim(void)
+    {
+        size_t bytes = 0;
+        for (Entry &entry : mEntries)
+            bytes += entry.pFont->GetCacheStats().bytes;
+
+        // Fonts keep to their part of the budget, unless pinned glyphs take more.
+        while (mMaxBytes > 0 && bytes > mMaxBytes && mEntries.size() > 1)
+        {
+            Entry &entry = mEntries.back();
+            bytes -= entry.pFont->GetCacheStats().bytes;
+
+            StyleKey key = {entry.pFontData, entry.style};
+            key.style.size = 0.0;
+            auto it = mBuckets.find(key);
+            it->second.erase(entry.bucket);
+            if (it->second.empty())
+                mBuckets.erase(it);
+
+            DestroyImageFont(entry.pFont);
+            mEntries.pop_back();
+            mEvictions++;
+        }
+
+        // The fonts that are left get more. Splitting may evict, so free after.
+        SplitBudget();
+
+        for (Entry &entry : mEntries)
+            entry.pFont->FreeEvictedGlyphs();
+    }
+    void ImageFontCache::Clear(void)
+    {
+        for (Entry &entry : mEntries)
+            DestroyImageFont(entry.pFont);
+
+        mEntries.clear();
+        mBuckets.clear();
+    }
+    ImageFontCacheStats ImageFontCache::GetStats(void) const
+    {
+        ImageFontCacheStats stats = {mHits, mReuses, mMisses, mEvictions, mEntries.size(), 0};
+        for (const Entry &entry : mEntries)
+            stats.bytes += entry.pFont->GetCacheStats().bytes;
+
+        return stats;
+    }
+    void ImageFontCache::ResetStats(void)
+    {
+        mHits = mReuses = mMisses = mEvictions = 0;
+    }
+
     const GlyphMetrics *ImageGlyph::GetMetrics(void) const
     {
         return &mMetrics;
     }
+    const Image *ImageGlyph::GetImage(void) const
+    {
+        return mImage;
+    }
 }
@@ -0,0 +1,162 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <zlib.h>
+
+#include "font.h"
+
+
+namespace TextGL
+{
+    /**
+     *  Something that font data can be read from, a piece at a time.
+     */
+    class InputSource
+    {
+        public:
+            virtual ~InputSource(void) {}
+
+            /**
+             *  returns the number of bytes read, 0 at the end of the input.
+             */
+            virtual size_t Read(char *buf, const size_t size) = 0;
+    };
+
+    class StreamSource: public InputSource
+    {
+        private:
+            std::istream &is;
+        public:
+            StreamSource(std::istream &s): is(s) {}
+
+            size_t Read(char *buf, const size_t size)
+            {
+                if (!is.good())
+                    return 0;
+
+                is.read(buf, size);
+                if (is.bad())
+                    throw FontParseError("Error reading the input stream");
+
+                return is.gcount();
+            }
+    };
+
+    class MemorySource: public InputSource
+    {
+        private:
+            const char *pData;
+            size_t length, position;
+        public:
+            MemorySource(const char *data, const size_t len): pData(data), length(len), position(0) {}
+
+            size_t Read(char *buf, const size_t size)
+            {
+                size_t n = std::min(size, length - position);
+                memcpy(buf, pData + position, n);
+                position += n;
+                return n;
+            }
+    };
+
+    /**
+     *  The first two bytes of every gzip member.
+     */
+    const unsigned char GZIP_MAGIC[] = {0x1f, 0x8b};
+
+    inline bool IsGzipData(const char *data, const size_t length)
+    {
+        return length >= 2 && (unsigned char)data[0] == GZIP_MAGIC[0] && (unsigned char)data[1] == GZIP_MAGIC[1];
+    }
+
+    /**
+     *  Inflates gzip compressed data from another source, as it's being read.
+     *  Only one buffer of compressed data is held at a time.
+     */
+    class GzipSource: public InputSource
+    {
+        private:
+            InputSource &compressed;
+            std::vector<unsigned char> inBuf;
+            z_stream stream;
+            bool streamEnded, inputEnded;
+
+            void operator=(const GzipSource &) = delete;
+            GzipSource(const GzipSource &) = delete;
+        public:
+            GzipSource(InputSource &source, const size_t bufSize=65536)
+            : compressed(source), inBuf(bufSize), streamEnded(false), inputEnded(false)
+            {
+                memset(&stream, 0, sizeof(stream));
+
+                // 16 + the maximum window size: expect a gzip header.
+                if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+                    throw FontParseError("Cannot initialize zlib: %s", stream.msg != NULL ? stream.msg : "no message");
+            }
+
+            ~GzipSource(void)
+            {
+                inflateEnd(&stream);
+            }
+
+            size_t Read(char *buf, const size_t size)
+            {
+                stream.next_out = (Bytef *)buf;
+                stream.avail_out = size;
+
+                while (stream.avail_out > 0)
+                {
+                    if (stream.avail_in == 0 && !inputEnded)
+                    {
+                        stream.next_in = inBuf.data();
+                        stream.avail_in = compressed.Read((char *)inBuf.data(), inBuf.size());
+                        inputEnded = stream.avail_in == 0;
+                    }
+
+                    if (streamEnded)
+                    {
+                        if (stream.avail_in == 0)
+                            break;
+
+                        // Another gzip member follows, like 'cat a.gz b.gz' gives.
+                        inflateReset(&stream);
+                        streamEnded = false;
+                    }
+
+                    if (stream.avail_in == 0)
+                        throw FontParseError("gzip data is truncated");
+
+                    int status = inflate(&stream, Z_NO_FLUSH);
+                    if (status == Z_STREAM_END)
+                        streamEnded = true;
+                    else if (status != Z_OK && status != Z_BUF_ERROR)
+                        throw FontParseError("Error inflating gzip data: %s", stream.msg != NULL ? stream.msg : zError(status));
+                }
+
+                return size - stream.avail_out;
+            }
+    };
+}
+
+#endif  // INPUT_H
@@ -0,0 +1,144 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef MAPPED_H
+#define MAPPED_H
+
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "font.h"
+
+
+namespace TextGL
+{
+    /**
+     *  A read-only mapping of a whole file into memory.
+     */
+    class MappedFile
+    {
+        private:
+        #ifdef _WIN32
+            HANDLE hFile, hMapping;
+        #else
+            int fd;
+        #endif
+            const char *pData;
+            size_t length;
+
+            void operator=(const MappedFile &) = delete;
+            MappedFile(const MappedFile &) = delete;
+        public:
+            MappedFile(const char *path)
+            {
+            #ifdef _WIN32
+                hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                if (hFile == INVALID_HANDLE_VALUE)
+                    throw FontParseError("Cannot open %s", path);
+
+                LARGE_INTEGER size;
+                if (!GetFileSizeEx(hFile, &size))
+                {
+                    CloseHandle(hFile);
+                    throw FontParseError("Cannot get the size of %s", path);
+                }
+                length = size.QuadPart;
+                if (length == 0)
+                {
+                    CloseHandle(hFile);
+                    throw FontParseError("%s is empty", path);
+                }
+
+                hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+                if (hMapping == NULL)
+                {
+                    CloseHandle(hFile);
+                    throw FontParseError("Cannot map %s", path);
+                }
+
+                pData = (const char *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+                if (pData == NULL)
+                {
+                    CloseHandle(hMapping);
+                    CloseHandle(hFile);
+                    throw FontParseError("Cannot map %s", path);
+                }
+            #else
+                fd = open(path, O_RDONLY);
+                if (fd < 0)
+                    throw FontParseError("Cannot open %s: %s", path, strerror(errno));
+
+                struct stat st;
+                if (fstat(fd, &st) != 0)
+                {
+                    close(fd);
+                    throw FontParseError("Cannot get the size of %s: %s", path, strerror(errno));
+                }
+                length = st.st_size;
+                if (length == 0)
+                {
+                    close(fd);
+                    throw FontParseError("%s is empty", path);
+                }
+
+                void *p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED)
+                {
+                    close(fd);
+                    throw FontParseError("Cannot map %s: %s", path, strerror(errno));
+                }
+                pData = (const char *)p;
+
+                // The whole file is going to be read from start to end.
+                madvise(p, length, MADV_SEQUENTIAL);
+            #endif
+            }
+
+            ~MappedFile(void)
+            {
+            #ifdef _WIN32
+                UnmapViewOfFile(pData);
+                CloseHandle(hMapping);
+                CloseHandle(hFile);
+            #else
+                munmap((void *)pData, length);
+                close(fd);
+            #endif
+            }
+
+            const char *GetData(void) const
+            {
+                return pData;
+            }
+
+            size_t GetLength(void) const
+            {
+                return length;
+            }
+    };
+}
+
+#endif  // MAPPED_H
@@ -14,291 +14,306 @@
   3. This notice may not be removed or altered from any source distribution.
 */
 
+
 #include <cstdarg>
+#include <cstring>
 #include <math.h>
+#include <exception>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <functional>
+
+#include <climits>
+#include <cfloat>
+#include <charconv>
 
-#include <libxml/tree.h>
 #include <libxml/parser.h>
-#include <boost/algorithm/string.hpp>
+#include <libxml/parserInternals.h>
 
 #include "font.h"
+#include "mapped.h"
+#include "input.h"
+#include "arena.h"
 
 
 # define PI 3.14159265358979323846
 
-#define HAS_ID(map, id) (map.find(id) != map.end())
-
 namespace TextGL
 {
-    class XMLChildIterator : public std::iterator<std::input_iterator_tag, xmlNodePtr>
+    FontArena::FontArena(void): pResource(std::make_shared<Arena>())
     {
-        private:
-            xmlNodePtr pChildren;
-        public:
-            XMLChildIterator(xmlNodePtr p): pChildren(p) {}
-            XMLChildIterator(const XMLChildIterator &it): pChildren(it.pChildren) {}
+    }
+    FontArena::FontArena(const FontArena &): pResource(std::make_shared<Arena>())
+    {
+    }
+    FontArena::FontArena(FontArena &&other): pResource(other.pResource)
+    {
+    }
+    FontArena &FontArena::operator=(const FontArena &)
+    {
+        return *this;
+    }
+    FontArena &FontArena::operator=(FontArena &&)
+    {
+        return *this;
+    }
+    std::pmr::memory_resource *FontArena::Get(void) const
+    {
+        return pResource.get();
+    }
 
-            XMLChildIterator &operator++(void)
-            {
-                pChildren = pChildren->next;
-                return *this;
-            }
-            XMLChildIterator operator++(int)
-            {
-                XMLChildIterator tmp(*this);
-                operator++();
-                return tmp;
-            }
-            bool operator==(const XMLChildIterator &other) const
-            {
-                return pChildren == other.pChildren;
-            }
-            bool operator!=(const XMLChildIterator &other) const
-            {
-                return pChildren != other.pChildren;
-            }
-            xmlNodePtr operator*(void)
-            {
-                return pChildren;
-            }
-    };
+    /**
+     *  Exact powers of ten, as far as a double can hold them.
+     */
+    const double exactPowersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                      1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+                                      1e21, 1e22};
 
-    class XMLChildIterable
-    {
-        private:
-            xmlNodePtr pParent;
-        public:
-            XMLChildIterable(xmlNodePtr p): pParent(p) {}
+    // At most this many significant digits always fit in a uint64_t.
+    #define MAX_MANTISSA_DIGITS 19
 
-            XMLChildIterator begin(void)
-            {
-                return XMLChildIterator(pParent->children);
-            }
+    /**
+     *  Unlike isdigit, doesn't look at the locale.
+     */
+    inline bool IsDigit(const char c)
+    {
+        return (unsigned char)(c - '0') < 10;
+    }
 
-            XMLChildIterator end(void)
-            {
-                return XMLChildIterator(nullptr);
-            }
-    };
+    /**
+     *  returns true if the 8 bytes are all decimal digits.
+     */
+    inline bool AreEightDigits(const uint64_t chars)
+    {
+        // Each byte must be 0x30 to 0x39: high nibble 3 and still 3 after adding 6.
+        return ((chars & 0xF0F0F0F0F0F0F0F0) |
+                (((chars + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+    }
 
-    bool HasChild(xmlNodePtr pTag, const char *tagName)
+    /**
+     *  Converts 8 digit characters, loaded little-endian, into their value.
+     */
+    inline uint32_t ParseEightDigits(uint64_t chars)
     {
-        for (xmlNodePtr pChild : XMLChildIterable(pTag))
-        {
-            if (boost::iequals((const char *)pChild->name, tagName))
-                return true;
-        }
-        return false;
+        // Combine pairs of digits, then pairs of pairs, then the two halves.
+        chars -= 0x3030303030303030;
+        chars = (chars * 10) + (chars >> 8);
+        chars = (((chars & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+                 (((chars >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >> 32;
+        return (uint32_t)chars;
     }
 
-    xmlNodePtr FindChild(xmlNodePtr pParent, const char *tagName)
+    /**
+     *  Reads decimal digits into the mantissa, 8 at a time where possible.
+     *  The mantissa may overflow, if there are more than MAX_MANTISSA_DIGITS.
+     */
+    inline const char *ReadDigits(const char *p, const char *end, uint64_t &mantissa)
     {
-        for (xmlNodePtr pChild : XMLChildIterable(pParent))
+    #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t chars;
+        while (end - p >= 8)
         {
-            if (boost::iequals((const char *)pChild->name, tagName))
-                return pChild;
+            memcpy(&chars, p, 8);
+            if (!AreEightDigits(chars))
+                break;
+
+            mantissa = mantissa * 100000000 + ParseEightDigits(chars);
+            p += 8;
         }
+    #endif
 
-        throw FontParseError("No %s tag found in %s tag", tagName, (const char *)pParent->name);
+        for (; p < end && IsDigit(*p); p++)
+            mantissa = mantissa * 10 + (*p - '0');
+
+        return p;
     }
 
-    std::list<xmlNodePtr> IterFindChildren(xmlNodePtr pParent, const char *tagName)
+    const char *ParseDouble(const char *text, const char *end, double &out)
     {
-        std::list<xmlNodePtr> l;
+        const char *p = text;
 
-        for (xmlNodePtr pChild : XMLChildIterable(pParent))
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
         {
-            if (boost::iequals((const char *)pChild->name, tagName))
-                l.push_back(pChild);
+            negative = *p == '-';
+            p++;
         }
+        const char *unsignedStart = p;
 
-        return l;
-    }
+        uint64_t mantissa = 0;
+        p = ReadDigits(p, end, mantissa);
+        size_t nDigits = p - unsignedStart;
 
-    xmlDocPtr ParseXML(std::istream &is)
-    {
-        const size_t bufSize = 1024;
-        std::streamsize res;
-        char buf[bufSize];
-        int wellFormed;
+        int exponent = 0;
+        if (p < end && *p == '.')
+        {
+            const char *fractionStart = ++p;
+            p = ReadDigits(p, end, mantissa);
 
-        xmlParserCtxtPtr pCtxt;
-        xmlDocPtr pDoc;
+            exponent = -(int)(p - fractionStart);
+            nDigits += p - fractionStart;
+        }
 
-        // Read the first 4 bytes.
-        is.read(buf, 4);
-        if (!is.good())
-            throw FontParseError("Error reading the first xml bytes!");
-        res = is.gcount();
+        if (nDigits == 0)
+            return NULL;
 
-        // Create a progressive parsing context.
-        pCtxt = xmlCreatePushParserCtxt(NULL, NULL, buf, res, NULL);
-        if (!pCtxt)
-            throw FontParseError("Failed to create parser context!");
+        const char *mantissaEnd = p;
 
-        // Loop on the input, getting the document data.
-        while (is.good())
+        // Only take the exponent, if there are digits in it.
+        if (p < end && (*p == 'e' || *p == 'E'))
         {
-            is.read(buf, bufSize);
-            res = is.gcount();
+            const char *q = p + 1;
+            bool negativeExponent = false;
+            if (q < end && (*q == '-' || *q == '+'))
+            {
+                negativeExponent = *q == '-';
+                q++;
+            }
+
+            if (q < end && IsDigit(*q))
+            {
+                int e = 0;
+                for (; q < end && IsDigit(*q); q++)
+                {
+                    if (e < 100000)  // far out of range for any double already
+                        e = e * 10 + (*q - '0');
+                }
 
-            xmlParseChunk(pCtxt, buf, res, 0);
+                exponent += negativeExponent ? -e : e;
+                p = q;
+            }
         }
 
-        // There is no more input, indicate the parsing is finished.
-        xmlParseChunk(pCtxt, buf, 0, 1);
+        // Leading zeros don't count, check if the mantissa really overflowed.
+        bool tooManyDigits = false;
+        if (nDigits > MAX_MANTISSA_DIGITS)
+        {
+            const char *q = unsignedStart;
+            while (q < mantissaEnd && (*q == '0' || *q == '.'))
+                q++;
 
-        // Check if it was well formed.
-        pDoc = pCtxt->myDoc;
-        wellFormed = pCtxt->wellFormed;
-        xmlFreeParserCtxt(pCtxt);
+            size_t nSignificant = mantissaEnd - q;
+            if (std::find(q, mantissaEnd, '.') != mantissaEnd)
+                nSignificant--;
 
-        if (!wellFormed)
+            tooManyDigits = nSignificant > MAX_MANTISSA_DIGITS;
+        }
+
+        double d;
+        if (mantissa == 0 && !tooManyDigits)
         {
-            xmlFreeDoc(pDoc);
-            throw FontParseError("xml document is not well formed");
+            d = 0.0;
+        }
+    #if FLT_EVAL_METHOD == 0
+        /* Both the mantissa and the power of ten are exact doubles,
+         * so one multiplication or division rounds correctly.
+         */
+        else if (!tooManyDigits && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+        {
+            d = (double)(int64_t)mantissa;  // signed converts faster, it fits
+            if (exponent < 0)
+                d /= exactPowersOf10[-exponent];
+            else if (exponent > 0)
+                d *= exactPowersOf10[exponent];
+        }
+    #endif  // FLT_EVAL_METHOD
+        else
+        {
+            // Rare in fonts: too many digits or a large exponent.
+            std::from_chars_result result = std::from_chars(unsignedStart, p, d);
+            if (result.ec == std::errc::result_out_of_range)
+                d = exponent > 0 ? HUGE_VAL : 0.0;
+            else if (result.ec != std::errc() || result.ptr != p)
+                return NULL;
         }
 
-        return pDoc;
+        out = negative ? -d : d;
+        return p;
     }
 
     /**
-     *  Locale independent, always uses a dot as decimal separator.
-     *
-     *  returns the pointer to the string after the number.
+     *  The attributes, as libxml2 passes them to a SAX2 start element callback:
+     *  localname, prefix, URI, value start and value end, for each attribute.
+     *  The values point into libxml2's own buffer and aren't NULL-terminated.
      */
-    const char *ParseDouble(const char *in, double &out)
+    class SAXAttributes
     {
-        double d = 10.0f;
-        int digit, ndigit = 0;
-
-        // start from zero
-        out = 0.0;
+        private:
+            const char *tagName;
+            const xmlChar **pAttributes;
+            int count;
 
-        const char *p = in;
-        while (*p)
-        {
-            if (isdigit(*p))
+            const xmlChar **Find(const char *key) const
             {
-                digit = (*p - '0');
-
-                if (d > 1.0) // left from period
+                for (int i = 0; i < count; i++)
                 {
-                    out *= d;
-                    out += digit;
+                    if (xmlStrEqual(pAttributes[5 * i], (const xmlChar *)key))
+                        return pAttributes + 5 * i;
                 }
-                else // right from period, decimal
-                {
-                    out += d * digit;
-                    d *= 0.1;
-                }
-                ndigit++;
+                return nullptr;
             }
-            else if (tolower(*p) == 'e')
-            {
-                // exponent
-
-                // if no digits precede the exponent, assume 1
-                if (ndigit <= 0)
-                    out = 1.0;
-
-                p++;
-                if (*p == '+') // '+' just means positive power, default
-                    p++; // skip it, don't give it to atoi
-
-                int e = atoi(p);
-
-                out = out * pow(10, e);
-
-                // read past exponent number
-                if (*p == '-')
-                    p++;
-
-                while (isdigit(*p))
-                    p++;
+        public:
+            SAXAttributes(const char *name, const xmlChar **p, const int n): tagName(name), pAttributes(p), count(n) {}
 
-                return p;
-            }
-            else if (*p == '.')
+            const char *GetTagName(void) const
             {
-                // expect decimal digits after this
-
-                d = 0.1;
+                return tagName;
             }
-            else if (*p == '-')
-            {
-                // negative number
-                double v;
-                p = ParseDouble(p + 1, v);
 
-                out = -v;
-
-                return p;
-            }
-            else
+            bool Has(const char *key) const
             {
-                // To assume success, must have read at least one digit
-                if (ndigit > 0)
-                    return p;
-                else
-                    return nullptr;
+                return Find(key) != nullptr;
             }
-            p++;
-        }
 
-        return p;
-    }
+            /**
+             *  Copies the value to 's', keeping the string's capacity
+             *  so that repeated calls don't need to allocate.
+             */
+            void Get(const char *key, std::string &s) const
+            {
+                const xmlChar **pAttribute = Find(key);
+                if (pAttribute == nullptr)
+                    throw FontParseError("Missing %s attribute: %s", tagName, key);
+
+                s.assign((const char *)pAttribute[3], (const char *)pAttribute[4]);
+            }
+    };
 
-    void ParseUnicodeAttrib(const xmlNodePtr pTag, const char *key, UTF8Char &c)
+    void ParseUnicodeAttrib(const SAXAttributes &attributes, const char *key, std::string &buf, UTF8Char &c)
     {
-        xmlChar *pS = xmlGetProp(pTag, (const xmlChar *)key);
-        if (pS == nullptr)
-            throw FontParseError("Missing %s attribute: %s", (const char *)pTag->name, key);
-        int len = xmlStrlen(pS);
-        if (len > 4)
-            throw FontParseError("%s attribute %s has length %s. Expecting unicode", (const char *)pTag->name, key, len);
+        attributes.Get(key, buf);
+        if (buf.size() > 4)
+            throw FontParseError("%s attribute %s has length %u. Expecting unicode", attributes.GetTagName(), key, buf.size());
 
         // libxml2 automatically converts the html code to utf-8.
 
-        if (*NextUTF8Char((const int8_t *)pS, c) != NULL)
-            throw FontParseError("Cannot read string %s as utf-8", pS);
-
-        xmlFree(pS);
+        if (*NextUTF8Char((const int8_t *)buf.c_str(), c) != NULL)
+            throw FontParseError("Cannot read string %s as utf-8", buf.c_str());
     }
 
-    void ParseStringAttrib(const xmlNodePtr pTag, const char *key, std::string &s)
+    void ParseDoubleAttrib(const SAXAttributes &attributes, const char *key, std::string &buf, double &d)
     {
-        xmlChar *pS = xmlGetProp(pTag, (const xmlChar *)key);
-        if (pS == nullptr)
-            throw FontParseError("Missing %s attribute: %s", (const char *)pTag->name, key);
+        attributes.Get(key, buf);
 
-        s.assign((const char *)pS);
-        xmlFree(pS);
+        if (ParseDouble(buf.c_str(), buf.c_str() + buf.size(), d) == NULL)
+            throw FontParseError("Cannot convert string %s to number", buf.c_str());
     }
 
-    void ParseDoubleAttrib(const xmlNodePtr pTag, const char *key, double &d)
+    void ParseBoundingBoxAttrib(const SAXAttributes &attributes, std::string &buf, FontBoundingBox &bbox)
     {
-        xmlChar *pS = xmlGetProp(pTag, (const xmlChar *)key);
-        if (pS == nullptr)
-            throw FontParseError("Missing %s attribute: %s", (const char *)pTag->name, key);
-
-        if (ParseDouble((const char *)pS, d) == NULL)
-            throw FontParseError("Cannot convert string %s to number", pS);
-        xmlFree(pS);
-    }
-
-    void ParseBoundingBoxAttrib(const xmlNodePtr pTag, FontBoundingBox &bbox)
-    {
-        std::string s;
-        ParseStringAttrib(pTag, "bbox", s);
+        attributes.Get("bbox", buf);
 
         double numbers[4];
         size_t i;
-        const char *p = s.c_str();
+        const char *p = buf.c_str(),
+                   *end = p + buf.size();
         for (i = 0; i < 4; i++)
         {
             while (isspace(*p)) p++;
-            if ((p = ParseDouble(p, numbers[i])) == NULL)
+            if ((p = ParseDouble(p, end, numbers[i])) == NULL)
                 throw FontParseError("bbox attribute doesn't contain 4 numbers");
         }
 
@@ -312,22 +327,18 @@ namespace TextGL
      *  Parses n comma/space separated floats from the given string and
      *  returns a pointer to the text after it.
      */
-    const char *SVGParsePathDoubles(const int n, const char *text, double outs [])
+    const char *SVGParsePathDoubles(const int n, const char *text, const char *end, double outs [])
     {
         int i;
         for (i = 0; i < n; i++)
         {
-            if (!*text)
-                return NULL;
-
-            while (isspace(*text) || *text == ',')
-            {
+            while (text < end && (isspace(*text) || *text == ','))
                 text++;
-                if (!*text)
-                    return NULL;
-            }
 
-            text = ParseDouble(text, outs[i]);
+            if (text >= end)
+                return NULL;
+
+            text = ParseDouble(text, end, outs[i]);
             if (!text)
                 return NULL;
         }
@@ -335,6 +346,47 @@ namespace TextGL
         return text;
     }
 
+    /**
+     *  All comma/space separated numbers after a path command, read in one go.
+     *  The command then takes them in groups of as many as it has arguments.
+     */
+    class PathNumberRun
+    {
+        private:
+            std::vector<double> numbers;
+            std::vector<const char *> ends;  // the text after each number
+            size_t next;
+        public:
+            void Read(const char *text, const char *end)
+            {
+                numbers.clear();
+                ends.clear();
+                next = 0;
+
+                double number;
+                while ((text = SVGParsePathDoubles(1, text, end, &number)))
+                {
+                    numbers.push_back(number);
+                    ends.push_back(text);
+                }
+            }
+
+            /**
+             *  returns false if there are less than n numbers left.
+             */
+            bool Take(const size_t n, double outs[], const char *&after)
+            {
+                if (next + n > numbers.size())
+                    return false;
+
+                std::copy(numbers.begin() + next, numbers.begin() + next + n, outs);
+                next += n;
+                after = ends[next - 1];
+
+                return true;
+            }
+    };
+
     /**
      *  This function, used to draw quadratic curves in cairo, is
      *  based on code from cairosvg(http://cairosvg.org/)
@@ -352,15 +404,93 @@ namespace TextGL
         y2 = yq2;
     }
 
-    void ParseSVGPath(const char *d, std::list<GlyphPathElement> &path)
+    /**
+     *  The parser's state while going through a path: the last element
+     *  and the current point.
+     */
+    struct PathElement
+    {
+        GlyphPathElementType type;
+
+        union
+        {
+            struct
+            {
+                double x1, y1, x2, y2;
+            };
+            struct
+            {
+                double rx, ry, rotate;
+                bool largeArc, sweep;
+            };
+        };
+        double x, y;
+    };
+
+    /**
+     *  Appends elements to the path store, extending the glyph's range.
+     */
+    class GlyphPathWriter
+    {
+        private:
+            GlyphPathStore &store;
+            GlyphPath &path;
+        public:
+            GlyphPathWriter(GlyphPathStore &s, GlyphPath &p)
+            : store(s), path(p)
+            {
+                path.firstElement = store.mElementTypes.size();
+                path.elementCount = 0;
+                path.firstCoord = store.mCoords.size();
+            }
+
+            void Add(const PathElement &el)
+            {
+                store.mElementTypes.push_back(el.type);
+
+                switch (el.type)
+                {
+                case ELEMENT_CURVETO:
+                    store.mCoords.insert(store.mCoords.end(), {float(el.x1), float(el.y1),
+                                                               float(el.x2), float(el.y2),
+                                                               float(el.x), float(el.y)});
+                    break;
+                case ELEMENT_ARCTO:
+                    store.mCoords.insert(store.mCoords.end(), {float(el.rx), float(el.ry), float(el.rotate),
+                                                               el.largeArc ? 1.0f : 0.0f,
+                                                               el.sweep ? 1.0f : 0.0f,
+                                                               float(el.x), float(el.y)});
+                    break;
+                case ELEMENT_CLOSEPATH:
+                    break;
+                default:
+                    store.mCoords.insert(store.mCoords.end(), {float(el.x), float(el.y)});
+                }
+
+                path.elementCount++;
+            }
+    };
+
+    void ParseSVGPath(const char *d, GlyphPathStore &store, GlyphPath &path)
     {
+        GlyphPathWriter writer(store, path);
+
+        const char *end = d + strlen(d);
+
+        // Reused, so that its vectors keep their capacity from one path to the next.
+        static thread_local PathNumberRun run;
+
         const char *nd;
         double ds[6],
                qx1, qy1, qx2, qy2;
 
         char prevSymbol, symbol = 'm';
         bool upper = false;
-        GlyphPathElement el;
+        PathElement el;
+
+        // A relative moveto at the start is relative to the origin.
+        el.x = el.y = 0.0;
+        el.x2 = el.y2 = 0.0;
 
         while (*d)
         {
@@ -371,6 +501,10 @@ namespace TextGL
             while (isspace(*d))
                 d++;
 
+            // Trailing whitespace, don't read past the end.
+            if (!*d)
+                break;
+
             upper = isupper(*d); // upper is absolute, lower is relative
             symbol = tolower(*d);
             d++;
@@ -381,12 +515,12 @@ namespace TextGL
             case 'z':  // closepath
 
                 el.type = ELEMENT_CLOSEPATH;
-                path.push_back(el);
+                writer.Add(el);
                 break;
 
             case 'm':  // moveto(x y)+
 
-                while ((nd = SVGParsePathDoubles(2, d, ds)))
+                for (run.Read(d, end); run.Take(2, ds, nd);)
                 {
                     if (upper)
                     {
@@ -400,7 +534,7 @@ namespace TextGL
                     }
 
                     el.type = ELEMENT_MOVETO;
-                    path.push_back(el);
+                    writer.Add(el);
 
                     d = nd;
                 }
@@ -408,7 +542,7 @@ namespace TextGL
 
             case 'l':  // lineto(x y)+
 
-                while ((nd = SVGParsePathDoubles(2, d, ds)))
+                for (run.Read(d, end); run.Take(2, ds, nd);)
                 {
                     if (upper)
                     {
@@ -422,7 +556,7 @@ namespace TextGL
                     }
 
                     el.type = ELEMENT_LINETO;
-                    path.push_back(el);
+                    writer.Add(el);
 
                     d = nd;
                 }
@@ -430,7 +564,7 @@ namespace TextGL
 
             case 'h':  // horizontal lineto x+
 
-                while ((nd = SVGParsePathDoubles(1, d, ds)))
+                for (run.Read(d, end); run.Take(1, ds, nd);)
                 {
                     if (upper)
                     {
@@ -442,7 +576,7 @@ namespace TextGL
                     }
 
                     el.type = ELEMENT_LINETO;
-                    path.push_back(el);
+                    writer.Add(el);
 
                     d = nd;
                 }
@@ -450,7 +584,7 @@ namespace TextGL
 
             case 'v':  // vertical lineto y+
 
-                while ((nd = SVGParsePathDoubles(1, d, ds)))
+                for (run.Read(d, end); run.Take(1, ds, nd);)
                 {
                     if (upper)
                     {
@@ -462,7 +596,7 @@ namespace TextGL
                     }
 
                     el.type = ELEMENT_LINETO;
-                    path.push_back(el);
+                    writer.Add(el);
 
                     d = nd;
                 }
@@ -470,7 +604,7 @@ namespace TextGL
 
             case 'c':  // curveto(x1 y1 x2 y2 x y)+
 
-                while ((nd = SVGParsePathDoubles(6, d, ds)))
+                for (run.Read(d, end); run.Take(6, ds, nd);)
                 {
                     if (upper)
                     {
@@ -486,7 +620,7 @@ namespace TextGL
                     }
 
                     el.type = ELEMENT_CURVETO;
-                    path.push_back(el);
+                    writer.Add(el);
 
                     d = nd;
                 }
@@ -494,7 +628,7 @@ namespace TextGL
 
             case 's':  // shorthand/smooth curveto(x2 y2 x y)+
 
-                while ((nd = SVGParsePathDoubles(4, d, ds)))
+                for (run.Read(d, end); run.Take(4, ds, nd);)
                 {
                     if (prevSymbol == 's' || prevSymbol == 'c')
                     {
@@ -524,7 +658,7 @@ namespace TextGL
                     }
 
                     el.type = ELEMENT_CURVETO;
-                    path.push_back(el);
+                    writer.Add(el);
 
                     d = nd;
                 }
@@ -532,7 +666,7 @@ namespace TextGL
 
             case 'q': // quadratic Bezier curveto(x1 y1 x y)+
 
-                while ((nd = SVGParsePathDoubles(4, d, ds)))
+                for (run.Read(d, end); run.Take(4, ds, nd);)
                 {
                     el.x1 = el.x;
                     el.y1 = el.y;
@@ -564,7 +698,7 @@ namespace TextGL
                     el.y2 = qy2;
 
                     el.type = ELEMENT_CURVETO;
-                    path.push_back(el);
+                    writer.Add(el);
 
                     d = nd;
                 }
@@ -572,7 +706,7 @@ namespace TextGL
 
             case 't':  // Shorthand/smooth quadratic Bézier curveto(x y)+
 
-                while ((nd = SVGParsePathDoubles(2, d, ds)))
+                for (run.Read(d, end); run.Take(2, ds, nd);)
                 {
                     el.x1 = el.x;
                     el.y1 = el.y;
@@ -607,7 +741,7 @@ namespace TextGL
                     Quadratic2Bezier(qx1, qy1, qx2, qy2, el.x, el.y);
 
                     el.type = ELEMENT_CURVETO;
-                    path.push_back(el);
+                    writer.Add(el);
 
                     d = nd;
                 }
@@ -620,7 +754,7 @@ namespace TextGL
 
                 while (isdigit(*d) || *d == '-')
                 {
-                    nd = SVGParsePathDoubles(3, d, ds);
+                    nd = SVGParsePathDoubles(3, d, end, ds);
                     if (!nd)
                     {
                         throw FontParseError("arc incomplete. Missing first 3 floats in %s", d);
@@ -657,7 +791,7 @@ namespace TextGL
                     }
                     while (isspace(*nd) || *nd == ',');
 
-                    nd = SVGParsePathDoubles(2, nd, ds);
+                    nd = SVGParsePathDoubles(2, nd, end, ds);
                     if (!nd)
                     {
                         throw FontParseError("arc incomplete. Missing last two floats in %s", d);
@@ -681,7 +815,7 @@ namespace TextGL
                     }
 
                     el.type = ELEMENT_ARCTO;
-                    path.push_back(el);
+                    writer.Add(el);
                 }  // end loop
 
                 break;
@@ -689,149 +823,743 @@ namespace TextGL
         }
     }
 
-    void ParseGlyphTag(const xmlNodePtr pGlyphTag, const GlyphMetrics &defaults,
-                       FontData &fontData,
-                       std::unordered_map<std::string, UTF8Char> &namesToCharacters)
+
+    /**
+     *  Paths of a lazily parsed font, by offset in the path text.
+     *  Each path gets a store of its own, that doesn't move once parsed.
+     */
+    class LazyPathCache
     {
-        if (!xmlHasProp(pGlyphTag, (const xmlChar *)"unicode"))
-            return;
+        public:
+            std::mutex mtx;
+            std::unordered_map<uint32_t, GlyphPathStore> stores;
+    };
 
-        UTF8Char c;
-        ParseUnicodeAttrib(pGlyphTag, "unicode", c);
+    /**
+     *  Attributes of a <hkern> tag, kept until all glyph names are known.
+     */
+    struct HKernAttribs
+    {
+        std::string k, g1, g2, u1, u2;
+    };
 
-        if (xmlHasProp(pGlyphTag, (const xmlChar *)"glyph-name"))
-        {
-            std::string name;
-            ParseStringAttrib(pGlyphTag, "glyph-name", name);
+    /**
+     *  The characters on both sides of a <hkern> tag.
+     */
+    struct HKernPairs
+    {
+        double k;
+        std::vector<UTF8Char> u1, u2;
+    };
 
-            namesToCharacters[name] = c;
-        }
+    /**
+     *  The path of one <glyph> or <missing-glyph> tag, for parsing on a worker thread.
+     */
+    struct PathJob
+    {
+        GlyphData *pGlyph;
+        uint32_t textOffset;  // NO_PATH_TEXT if the tag has no path
+    };
 
-        fontData.mGlyphs[c].mMetrics = defaults;
-        if (xmlHasProp(pGlyphTag, (const xmlChar *)"horiz-adv-x"))
-            ParseDoubleAttrib(pGlyphTag, "horiz-adv-x", fontData.mGlyphs[c].mMetrics.advanceX);
-        if (xmlHasProp(pGlyphTag, (const xmlChar *)"horiz-origin-x"))
-            ParseDoubleAttrib(pGlyphTag, "horiz-origin-x", fontData.mGlyphs[c].mMetrics.bearingX);
-        if (xmlHasProp(pGlyphTag, (const xmlChar *)"horiz-origin-y"))
-            ParseDoubleAttrib(pGlyphTag, "horiz-origin-y", fontData.mGlyphs[c].mMetrics.bearingY);
-
-        std::string d = "";
-        if (xmlHasProp(pGlyphTag, (const xmlChar *)"d"))  // 'd' might be missing for a whitespace glyph
-            ParseStringAttrib(pGlyphTag, "d", d);
-        ParseSVGPath(d.c_str(), fontData.mGlyphs[c].mPath);
+    /**
+     *  returns where chunk 'i' of 'n' items starts, when divided over 'nChunks'.
+     */
+    size_t GetChunkStart(const size_t n, const size_t nChunks, const size_t i)
+    {
+        return n * i / nChunks;
     }
 
-    void ParseGlyphNameListAttrib(xmlNodePtr pTag, const char *id, std::list<std::string> &names)
+    /**
+     *  Calls f(chunk, start, end) for every chunk, each on a thread of its own.
+     *  If any of them throw, the exception of the first chunk is passed on,
+     *  like it would have been if the items were handled in order.
+     */
+    void RunChunks(const size_t n, const size_t nChunks,
+                   const std::function<void(const size_t, const size_t, const size_t)> &f)
     {
-        std::string value;
-        ParseStringAttrib(pTag, id, value);
+        std::vector<std::exception_ptr> errors(nChunks);
+        auto RunChunk = [&](const size_t i)
+        {
+            try
+            {
+                f(i, GetChunkStart(n, nChunks, i), GetChunkStart(n, nChunks, i + 1));
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        };
 
-        boost::split(names, value, boost::is_any_of(","));
-    }
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < nChunks; i++)
+            threads.emplace_back(RunChunk, i);
 
-    void ParseGlyphUnicodeListAttrib(xmlNodePtr pTag, const char *id, std::list<UTF8Char> &characters)
-    {
-        std::string value;
-        ParseStringAttrib(pTag, id, value);
+        RunChunk(0);  // this thread takes a chunk too
+
+        for (std::thread &thread : threads)
+            thread.join();
 
-        std::list<std::string> reprs;
-        boost::split(reprs, value, boost::is_any_of(","));
-        for (const std::string &repr : reprs)
+        for (const std::exception_ptr &error : errors)
         {
-            UTF8Char c;
-            if (*NextUTF8Char((const int8_t *)repr.c_str(), c) != NULL)
-                throw FontParseError("Error interpreting %s attribute %s %s as utf-8", (const char *)pTag->name, id, repr.c_str());
-            characters.push_back(c);
+            if (error)
+                std::rethrow_exception(error);
         }
     }
 
-    void ParseHKernTag(const xmlNodePtr pHKernTag,
-                       const std::unordered_map<std::string, UTF8Char> &namesToCharacters,
-                       FontData &fontData)
+    /**
+     *  Builds the font data while libxml2 streams the elements past.
+     *  Only the path from the root to the current element is tracked,
+     *  so no document tree is kept in memory.
+     */
+    class SVGFontParser
     {
-        double k;
-        ParseDoubleAttrib(pHKernTag, "k", k);
+        private:
+            enum Location
+            {
+                IN_DOCUMENT,
+                IN_SVG,
+                IN_DEFS,
+                IN_FONT
+            };
 
-        std::list<std::string> g1, g2;
-        std::list<UTF8Char> u1, u2;
+            FontData &fontData;
+            bool lazyPaths;
+            size_t nWorkers;
+            const CharacterSet *pCharacters;  // NULL for all characters
 
-        if (xmlHasProp(pHKernTag, (const xmlChar *)"g1"))
-        {
-            ParseGlyphNameListAttrib(pHKernTag, "g1", g1);
-            for (std::string &name : g1)
+            Location location;
+            int depth;
+
+            bool defsFound, fontFound, faceFound, missingGlyphFound;
+
+            GlyphMetrics defaultGlyphMetrics;
+            bool hasDefaultAdvance;
+            std::unordered_map<std::string, UTF8Char> namesToCharacters;
+
+            /* Paths by their 'd' text, so that glyphs with the same outline share one.
+             * With more than one worker, textOffset points into pathText, until they're parsed.
+             */
+            std::unordered_map<std::string, GlyphPath> knownPaths;
+
+            // With more than one worker, paths are only collected here while reading.
+            std::string pathText;
+            std::vector<PathJob> pathJobs;
+
+            // Kerning may name glyphs that follow it, so it's resolved in document order when all are known.
+            std::vector<HKernAttribs> hkerns;
+
+            // Scratch space, reused for every element.
+            std::string value;
+            HKernAttribs hkern;
+
+            void ParseFontTag(const SAXAttributes &attributes)
             {
-                if (!HAS_ID(namesToCharacters, name))
-                    throw FontParseError("No such glyph: %s", name);
-                u1.push_back(namesToCharacters.at(name));
+                // The remaining defaults come from the font-face tag, which follows.
+                defaultGlyphMetrics = {0.0, 0.0, 0.0, 0.0, 0.0};
+                hasDefaultAdvance = attributes.Has("horiz-adv-x");
+                if (hasDefaultAdvance)
+                    ParseDoubleAttrib(attributes, "horiz-adv-x", value, defaultGlyphMetrics.advanceX);
+                if (attributes.Has("horiz-origin-x"))
+                    ParseDoubleAttrib(attributes, "horiz-origin-x", value, defaultGlyphMetrics.bearingX);
+                if (attributes.Has("horiz-origin-y"))
+                    ParseDoubleAttrib(attributes, "horiz-origin-y", value, defaultGlyphMetrics.bearingY);
             }
-        }
-        if (xmlHasProp(pHKernTag, (const xmlChar *)"g2"))
-        {
-            ParseGlyphNameListAttrib(pHKernTag, "g2", g2);
-            for (std::string &name : g2)
+
+            void ParseFaceTag(const SAXAttributes &attributes)
             {
-                if (!HAS_ID(namesToCharacters, name))
-                    throw FontParseError("No such glyph: %s", name);
-                u2.push_back(namesToCharacters.at(name));
+                ParseDoubleAttrib(attributes, "ascent", value, fontData.mMetrics.ascent);
+                ParseDoubleAttrib(attributes, "descent", value, fontData.mMetrics.descent);
+                ParseDoubleAttrib(attributes, "units-per-em", value, fontData.mMetrics.unitsPerEM);
+
+                ParseBoundingBoxAttrib(attributes, value, fontData.mMetrics.bbox);
+
+                defaultGlyphMetrics.height = fontData.mMetrics.bbox.top - fontData.mMetrics.bbox.bottom;
+                if (!hasDefaultAdvance)
+                    defaultGlyphMetrics.advanceX = fontData.mMetrics.bbox.right - fontData.mMetrics.bbox.left;
             }
+
+            /**
+             *  Reads the metrics and path, shared by <glyph> and <missing-glyph> tags.
+             */
+            void ParseGlyphShape(const SAXAttributes &attributes, GlyphData &glyphData)
+            {
+                if (!faceFound)
+                    throw FontParseError("%s tag before font-face tag", attributes.GetTagName());
+
+                glyphData.mMetrics = defaultGlyphMetrics;
+                if (attributes.Has("horiz-adv-x"))
+                    ParseDoubleAttrib(attributes, "horiz-adv-x", value, glyphData.mMetrics.advanceX);
+                if (attributes.Has("horiz-origin-x"))
+                    ParseDoubleAttrib(attributes, "horiz-origin-x", value, glyphData.mMetrics.bearingX);
+                if (attributes.Has("horiz-origin-y"))
+                    ParseDoubleAttrib(attributes, "horiz-origin-y", value, glyphData.mMetrics.bearingY);
+
+                glyphData.mPath = GlyphPath();
+                if (attributes.Has("d"))  // 'd' might be missing for a whitespace glyph
+                {
+                    attributes.Get("d", value);
+
+                    // Many scripts share letters, like Latin, Greek and Cyrillic 'A'.
+                    auto it = knownPaths.find(value);
+                    if (it != knownPaths.end())
+                    {
+                        glyphData.mPath = it->second;
+                        if (nWorkers > 1 && !lazyPaths)
+                            pathJobs.push_back({&glyphData, it->second.textOffset});
+                        return;
+                    }
+
+                    if (lazyPaths)
+                    {
+                        if (fontData.mPathText.size() + value.size() >= NO_PATH_TEXT)
+                            throw FontParseError("Too much path text to parse lazily");
+
+                        glyphData.mPath.textOffset = fontData.mPathText.size();
+                        fontData.mPathText.append(value.c_str(), value.size() + 1);
+                    }
+                    else if (nWorkers > 1)
+                    {
+                        if (pathText.size() + value.size() >= NO_PATH_TEXT)
+                            throw FontParseError("Too much path text to parse on worker threads");
+
+                        pathJobs.push_back({&glyphData, (uint32_t)pathText.size()});
+                        pathText.append(value.c_str(), value.size() + 1);
+                    }
+                    else
+                        ParseSVGPath(value.c_str(), fontData.mPathStore, glyphData.mPath);
+
+                    if (nWorkers > 1 && !lazyPaths)
+                        knownPaths.emplace(value, GlyphPath()).first->second.textOffset = pathJobs.back().textOffset;
+                    else
+                        knownPaths.emplace(value, glyphData.mPath);
+                }
+                else if (nWorkers > 1 && !lazyPaths)
+                {
+                    // Also when empty, the path must replace that of an earlier tag for the same glyph.
+                    pathJobs.push_back({&glyphData, NO_PATH_TEXT});
+                }
+            }
+
+            void ParseGlyphTag(const SAXAttributes &attributes)
+            {
+                if (!attributes.Has("unicode"))
+                    return;
+
+                UTF8Char c;
+                ParseUnicodeAttrib(attributes, "unicode", value, c);
+
+                if (attributes.Has("glyph-name"))
+                {
+                    attributes.Get("glyph-name", value);
+                    namesToCharacters[value] = c;
+                }
+
+                // The name is still needed to tell which kerning to leave out.
+                if (pCharacters != NULL && pCharacters->count(c) == 0)
+                    return;
+
+                ParseGlyphShape(attributes, fontData.mGlyphs[c]);
+            }
+
+            /**
+             *  Adds the characters of a comma separated glyph name list.
+             *  returns false if a name isn't known (yet).
+             */
+            bool AddNamedCharacters(const std::string &names, std::string &value,
+                                    std::vector<UTF8Char> &characters) const
+            {
+                size_t start = 0, end;
+                do
+                {
+                    end = names.find(',', start);
+                    if (end == std::string::npos)
+                        end = names.size();
+
+                    value.assign(names, start, end - start);
+                    auto it = namesToCharacters.find(value);
+                    if (it == namesToCharacters.end())
+                        return false;
+
+                    characters.push_back(it->second);
+
+                    start = end + 1;
+                }
+                while (end < names.size());
+
+                return true;
+            }
+
+            void AddUnicodeCharacters(const char *id, const std::string &list, std::string &value,
+                                      std::vector<UTF8Char> &characters) const
+            {
+                size_t start = 0, end;
+                UTF8Char c;
+                do
+                {
+                    end = list.find(',', start);
+                    if (end == std::string::npos)
+                        end = list.size();
+
+                    value.assign(list, start, end - start);
+                    if (*NextUTF8Char((const int8_t *)value.c_str(), c) != NULL)
+                        throw FontParseError("Error interpreting hkern attribute %s %s as utf-8", id, value.c_str());
+                    characters.push_back(c);
+
+                    start = end + 1;
+                }
+                while (end < list.size());
+            }
+
+            /**
+             *  Leaves out characters that aren't in the character set.
+             *  returns false if the kerning refers to a glyph name that isn't known (yet).
+             */
+            bool ResolveHKern(const HKernAttribs &attribs, std::string &value, HKernPairs &pairs) const
+            {
+                if (ParseDouble(attribs.k.c_str(), attribs.k.c_str() + attribs.k.size(), pairs.k) == NULL)
+                    throw FontParseError("Cannot convert string %s to number", attribs.k.c_str());
+
+                pairs.u1.clear();
+                pairs.u2.clear();
+
+                if (!attribs.g1.empty() && !AddNamedCharacters(attribs.g1, value, pairs.u1))
+                    return false;
+                if (!attribs.g2.empty() && !AddNamedCharacters(attribs.g2, value, pairs.u2))
+                    return false;
+                if (!attribs.u1.empty())
+                    AddUnicodeCharacters("u1", attribs.u1, value, pairs.u1);
+                if (!attribs.u2.empty())
+                    AddUnicodeCharacters("u2", attribs.u2, value, pairs.u2);
+
+                if (pCharacters != NULL)
+                {
+                    auto IsLeftOut = [this](const UTF8Char c) { return pCharacters->count(c) == 0; };
+                    pairs.u1.erase(std::remove_if(pairs.u1.begin(), pairs.u1.end(), IsLeftOut), pairs.u1.end());
+                    pairs.u2.erase(std::remove_if(pairs.u2.begin(), pairs.u2.end(), IsLeftOut), pairs.u2.end());
+                }
+
+                return true;
+            }
+
+            void ParsePathsOnWorkers(void)
+            {
+                // Jobs with the same text take the path of the first.
+                std::vector<size_t> firstJobs(pathJobs.size());
+                std::unordered_map<uint32_t, size_t> firstJobsByText;
+                for (size_t i = 0; i < pathJobs.size(); i++)
+                    firstJobs[i] = firstJobsByText.emplace(pathJobs[i].textOffset, i).first->second;
+
+                std::vector<GlyphPathStore> stores(nWorkers);
+                std::vector<GlyphPath> paths(pathJobs.size());
+
+                RunChunks(pathJobs.size(), nWorkers, [this, &firstJobs, &stores, &paths](const size_t chunk, const size_t start, const size_t end)
+                {
+                    for (size_t i = start; i < end; i++)
+                    {
+                        if (pathJobs[i].textOffset != NO_PATH_TEXT && firstJobs[i] == i)
+                            ParseSVGPath(pathText.c_str() + pathJobs[i].textOffset, stores[chunk], paths[i]);
+                    }
+                });
+
+                // Append the chunks in order, so that the store is the same as when parsed on one thread.
+                GlyphPathStore &store = fontData.mPathStore;
+                for (size_t chunk = 0; chunk < nWorkers; chunk++)
+                {
+                    uint32_t elementBase = store.mElementTypes.size(),
+                             coordBase = store.mCoords.size();
+
+                    store.mElementTypes.insert(store.mElementTypes.end(),
+                                               stores[chunk].mElementTypes.begin(), stores[chunk].mElementTypes.end());
+                    store.mCoords.insert(store.mCoords.end(), stores[chunk].mCoords.begin(), stores[chunk].mCoords.end());
+
+                    for (size_t i = GetChunkStart(pathJobs.size(), nWorkers, chunk);
+                            i < GetChunkStart(pathJobs.size(), nWorkers, chunk + 1); i++)
+                    {
+                        paths[i].firstElement += elementBase;
+                        paths[i].firstCoord += coordBase;
+                    }
+                }
+
+                // In document order, a glyph may have been defined twice.
+                for (size_t i = 0; i < pathJobs.size(); i++)
+                {
+                    if (pathJobs[i].textOffset == NO_PATH_TEXT)
+                        pathJobs[i].pGlyph->mPath = GlyphPath();
+                    else
+                        pathJobs[i].pGlyph->mPath = paths[firstJobs[i]];
+                }
+            }
+
+            /**
+             *  Goes through the tags in order, so that later tags override earlier ones,
+             *  whatever the number of workers.
+             */
+            void AddHKerns(void)
+            {
+                std::vector<HKernPairs> resolved(hkerns.size());
+
+                RunChunks(hkerns.size(), nWorkers, [this, &resolved](const size_t chunk, const size_t start, const size_t end)
+                {
+                    std::string value;
+                    for (size_t i = start; i < end; i++)
+                    {
+                        if (!ResolveHKern(hkerns[i], value, resolved[i]))
+                            throw FontParseError("No such glyph in hkern: %s %s", hkerns[i].g1.c_str(), hkerns[i].g2.c_str());
+                    }
+                });
+
+                if (nWorkers == 1)
+                {
+                    for (const HKernPairs &pairs : resolved)
+                        for (const UTF8Char c1 : pairs.u1)
+                            for (const UTF8Char c2 : pairs.u2)
+                                fontData.mHorizontalKernTable[c1][c2] = pairs.k;
+                    return;
+                }
+
+                // Each worker fills in the rows for its own share of first characters.
+                std::vector<KernTable> tables(nWorkers);
+                RunChunks(nWorkers, nWorkers, [this, &resolved, &tables](const size_t chunk, const size_t, const size_t)
+                {
+                    for (const HKernPairs &pairs : resolved)
+                    {
+                        for (const UTF8Char c1 : pairs.u1)
+                        {
+                            if ((uint32_t)c1 % nWorkers != chunk)
+                                continue;
+
+                            KernTable::mapped_type &row = tables[chunk][c1];
+                            for (const UTF8Char c2 : pairs.u2)
+                                row[c2] = pairs.k;
+                        }
+                    }
+                });
+
+                // The arena isn't thread safe, so the workers filled tables on the heap. Their rows are copied into it here.
+                for (KernTable &table : tables)
+                {
+                    for (auto &rowPair : table)
+                    {
+                        auto it = fontData.mHorizontalKernTable.find(rowPair.first);
+                        if (it == fontData.mHorizontalKernTable.end())
+                            fontData.mHorizontalKernTable.emplace(rowPair.first, std::move(rowPair.second));
+                        else
+                        {
+                            for (const auto &pair : rowPair.second)
+                                it->second[pair.first] = pair.second;
+                        }
+                    }
+                }
+            }
+
+            void ParseHKernTag(const SAXAttributes &attributes)
+            {
+                attributes.Get("k", hkern.k);
+
+                hkern.g1.clear();
+                hkern.g2.clear();
+                hkern.u1.clear();
+                hkern.u2.clear();
+                if (attributes.Has("g1"))
+                    attributes.Get("g1", hkern.g1);
+                if (attributes.Has("g2"))
+                    attributes.Get("g2", hkern.g2);
+                if (attributes.Has("u1"))
+                    attributes.Get("u1", hkern.u1);
+                if (attributes.Has("u2"))
+                    attributes.Get("u2", hkern.u2);
+
+                hkerns.push_back(hkern);
+            }
+        public:
+            std::exception_ptr error;  // Exceptions mustn't pass through libxml2.
+            xmlParserCtxtPtr pCtxt;
+
+            SVGFontParser(FontData &data, const FontParseParams &params)
+            : fontData(data), lazyPaths(params.lazyPaths), nWorkers(params.nThreads), pCharacters(params.pCharacters),
+              location(IN_DOCUMENT), depth(0),
+              defsFound(false), fontFound(false), faceFound(false),
+              missingGlyphFound(false), hasDefaultAdvance(false),
+              error(nullptr), pCtxt(nullptr)
+            {
+                if (nWorkers == 0)
+                    nWorkers = std::max(1u, std::thread::hardware_concurrency());
+
+                fontData.mHasMissingGlyph = false;
+
+                // Fonts made from the data before keep their copy, new fonts must not get it.
+                std::atomic_store(&fontData.mMetricsStore, std::shared_ptr<const FontMetricsStore>());
+
+                if (lazyPaths && !fontData.mLazyPaths)
+                    fontData.mLazyPaths = std::make_shared<LazyPathCache>();
+            }
+
+            void StartElement(const char *name, const SAXAttributes &attributes)
+            {
+                depth++;
+
+                if (depth == 1)
+                {
+                    if (xmlStrcasecmp((const xmlChar *)name, (const xmlChar *)"svg") != 0)
+                        throw FontParseError("no root element is not \"svg\"");
+
+                    location = IN_SVG;
+                }
+                else if (depth == 2 && location == IN_SVG && !defsFound
+                         && xmlStrcasecmp((const xmlChar *)name, (const xmlChar *)"defs") == 0)
+                {
+                    location = IN_DEFS;
+                    defsFound = true;
+                }
+                else if (depth == 3 && location == IN_DEFS && !fontFound
+                         && xmlStrcasecmp((const xmlChar *)name, (const xmlChar *)"font") == 0)
+                {
+                    location = IN_FONT;
+                    fontFound = true;
+
+                    ParseFontTag(attributes);
+                }
+                else if (depth == 4 && location == IN_FONT)
+                {
+                    if (xmlStrcasecmp((const xmlChar *)name, (const xmlChar *)"glyph") == 0)
+                        ParseGlyphTag(attributes);
+
+                    else if (xmlStrcasecmp((const xmlChar *)name, (const xmlChar *)"hkern") == 0)
+                        ParseHKernTag(attributes);
+
+                    else if (!faceFound && xmlStrcasecmp((const xmlChar *)name, (const xmlChar *)"font-face") == 0)
+                    {
+                        ParseFaceTag(attributes);
+                        faceFound = true;
+                    }
+                    else if (!missingGlyphFound && xmlStrcasecmp((const xmlChar *)name, (const xmlChar *)"missing-glyph") == 0)
+                    {
+                        ParseGlyphShape(attributes, fontData.mMissingGlyph);
+                        fontData.mHasMissingGlyph = missingGlyphFound = true;
+                    }
+                }
+            }
+
+            void EndElement(void)
+            {
+                // Leaving the element that set the location?
+                if (depth == 3 && location == IN_FONT)
+                    location = IN_DEFS;
+                else if (depth == 2 && location == IN_DEFS)
+                    location = IN_SVG;
+
+                depth--;
+            }
+
+            void Finish(void)
+            {
+                if (!defsFound)
+                    throw FontParseError("No defs tag found in svg tag");
+                if (!fontFound)
+                    throw FontParseError("No font tag found in defs tag");
+                if (!faceFound)
+                    throw FontParseError("No font-face tag found in font tag");
+
+                if (nWorkers > 1)
+                    ParsePathsOnWorkers();
+                AddHKerns();
+
+                knownPaths.clear();
+
+                // No more paths are added, so give back what the vectors reserved for growing.
+                fontData.mPathStore.mElementTypes.shrink_to_fit();
+                fontData.mPathStore.mCoords.shrink_to_fit();
+                fontData.mPathText.shrink_to_fit();
+            }
+    };
+
+    void OnSAXStartElement(void *pUserData, const xmlChar *localName, const xmlChar *prefix, const xmlChar *URI,
+                           int nNamespaces, const xmlChar **namespaces,
+                           int nAttributes, int nDefaulted, const xmlChar **attributes)
+    {
+        SVGFontParser *pParser = (SVGFontParser *)pUserData;
+        try
+        {
+            pParser->StartElement((const char *)localName, SAXAttributes((const char *)localName, attributes, nAttributes));
+        }
+        catch (...)
+        {
+            pParser->error = std::current_exception();
+            xmlStopParser(pParser->pCtxt);
         }
-        if (xmlHasProp(pHKernTag, (const xmlChar *)"u1"))
-            ParseGlyphUnicodeListAttrib(pHKernTag, "u1", u1);
-        if (xmlHasProp(pHKernTag, (const xmlChar *)"u2"))
-            ParseGlyphUnicodeListAttrib(pHKernTag, "u2", u2);
-
-        for (const UTF8Char c1 : u1)
-            for (const UTF8Char c2 : u2)
-                fontData.mHorizontalKernTable[c1][c2] = k;
     }
 
-    void ParseSVGFontData(std::istream &is, FontData &fontData)
+    void OnSAXEndElement(void *pUserData, const xmlChar *localName, const xmlChar *prefix, const xmlChar *URI)
+    {
+        ((SVGFontParser *)pUserData)->EndElement();
+    }
+
+    void InitSAXHandler(xmlSAXHandler &handler)
+    {
+        memset(&handler, 0, sizeof(handler));
+        handler.initialized = XML_SAX2_MAGIC;
+        handler.startElementNs = OnSAXStartElement;
+        handler.endElementNs = OnSAXEndElement;
+    }
+
+    /**
+     *  Frees the context and throws, if parsing didn't succeed.
+     */
+    void FinishSAXParse(SVGFontParser &parser)
+    {
+        int wellFormed = parser.pCtxt->wellFormed;
+        xmlFreeParserCtxt(parser.pCtxt);
+
+        if (parser.error)
+            std::rethrow_exception(parser.error);
+
+        if (!wellFormed)
+            throw FontParseError("xml document is not well formed");
+
+        parser.Finish();
+    }
+
+    /**
+     *  Feeds the parser one buffer at a time, until the source ends.
+     */
+    void PushSAXParse(InputSource &source, FontData &fontData, const FontParseParams &params)
     {
-        xmlDocPtr pDoc = ParseXML(is);
+        const size_t bufSize = 65536;
+        std::vector<char> buf(bufSize);
+
+        SVGFontParser parser(fontData, params);
+
+        xmlSAXHandler handler;
+        InitSAXHandler(handler);
+
+        // Read the first 4 bytes, libxml2 detects the encoding from them.
+        size_t res = 0, n;
+        while (res < 4 && (n = source.Read(buf.data() + res, 4 - res)) > 0)
+            res += n;
+        if (res < 4)
+            throw FontParseError("Error reading the first xml bytes!");
+
+        // Create a progressive parsing context.
+        parser.pCtxt = xmlCreatePushParserCtxt(&handler, &parser, buf.data(), res, NULL);
+        if (!parser.pCtxt)
+            throw FontParseError("Failed to create parser context!");
 
+        // Have libxml2 substitute character references and entities in attribute values.
+        xmlCtxtUseOptions(parser.pCtxt, XML_PARSE_NOENT);
+
+        // Loop on the input, feeding the parser.
         try
         {
-            xmlNodePtr pRoot = xmlDocGetRootElement(pDoc);
-            if(pRoot == nullptr)
-                throw FontParseError("no root element found in xml tree");
+            while (!parser.error && (res = source.Read(buf.data(), bufSize)) > 0)
+                xmlParseChunk(parser.pCtxt, buf.data(), res, 0);
+        }
+        catch (...)
+        {
+            xmlFreeParserCtxt(parser.pCtxt);
+            throw;
+        }
+
+        // There is no more input, indicate the parsing is finished.
+        if (!parser.error)
+            xmlParseChunk(parser.pCtxt, buf.data(), 0, 1);
+
+        FinishSAXParse(parser);
+    }
+
+    void ParseSVGFontData(std::istream &is, FontData &fontData, const FontParseParams &params)
+    {
+        StreamSource source(is);
+
+        // Look at the first two bytes, without taking them from the stream.
+        bool gzip = is.peek() == GZIP_MAGIC[0];
+        if (gzip)
+        {
+            is.get();
+            gzip = is.peek() == GZIP_MAGIC[1];
+            is.unget();
+        }
 
-            if (!boost::iequals((const char *)pRoot->name, "svg"))
-                throw FontParseError("no root element is not \"svg\"");
+        if (gzip)
+        {
+            GzipSource inflated(source);
+            PushSAXParse(inflated, fontData, params);
+        }
+        else
+            PushSAXParse(source, fontData, params);
+    }
 
-            xmlNodePtr pDefsTag = FindChild(pRoot, "defs"),
-                       pFontTag = FindChild(pDefsTag, "font"),
-                       pFaceTag = FindChild(pFontTag, "font-face");
+    void ParseSVGFontData(const char *data, const size_t length, FontData &fontData, const FontParseParams &params)
+    {
+        if (IsGzipData(data, length))
+        {
+            // Inflate into the parser a buffer at a time, rather than all at once.
+            MemorySource source(data, length);
+            GzipSource inflated(source);
+            PushSAXParse(inflated, fontData, params);
+            return;
+        }
 
-            ParseDoubleAttrib(pFaceTag, "ascent", fontData.mMetrics.ascent);
-            ParseDoubleAttrib(pFaceTag, "descent", fontData.mMetrics.descent);
-            ParseDoubleAttrib(pFaceTag, "units-per-em", fontData.mMetrics.unitsPerEM);
+        if (length > INT_MAX)
+            throw FontParseError("xml data of %u bytes is too large", length);
 
-            ParseBoundingBoxAttrib(pFaceTag, fontData.mMetrics.bbox);
+        SVGFontParser parser(fontData, params);
 
-            GlyphMetrics defaultGlyphMetrics = {0.0f, 0.0f, 0.0f,
-                                                fontData.mMetrics.bbox.top - fontData.mMetrics.bbox.bottom,
-                                                fontData.mMetrics.bbox.right - fontData.mMetrics.bbox.left};
-            if (xmlHasProp(pFontTag, (const xmlChar *)"horiz-adv-x"))
-                ParseDoubleAttrib(pFontTag, "horiz-adv-x", defaultGlyphMetrics.advanceX);
-            if (xmlHasProp(pFontTag, (const xmlChar *)"horiz-origin-x"))
-                ParseDoubleAttrib(pFontTag, "horiz-origin-x", defaultGlyphMetrics.bearingX);
-            if (xmlHasProp(pFontTag, (const xmlChar *)"horiz-origin-y"))
-                ParseDoubleAttrib(pFontTag, "horiz-origin-y", defaultGlyphMetrics.bearingY);
+        xmlSAXHandler handler;
+        InitSAXHandler(handler);
 
-            std::unordered_map<std::string, UTF8Char> namesToCharacters;
+        parser.pCtxt = xmlCreateMemoryParserCtxt(data, length);
+        if (!parser.pCtxt)
+            throw FontParseError("Failed to create parser context!");
+
+        // Use our handler instead of the default tree builder, the same way xmlSAXUserParseMemory does.
+        xmlSAXHandlerPtr pDefaultHandler = parser.pCtxt->sax;
+        parser.pCtxt->sax = &handler;
+        parser.pCtxt->userData = &parser;
+
+        xmlCtxtUseOptions(parser.pCtxt, XML_PARSE_NOENT);
 
-            for (xmlNodePtr pGlyphTag : IterFindChildren(pFontTag, "glyph"))
-                ParseGlyphTag(pGlyphTag, defaultGlyphMetrics, fontData, namesToCharacters);
+        xmlParseDocument(parser.pCtxt);
 
-            for (xmlNodePtr pHKernTag : IterFindChildren(pFontTag, "hkern"))
-                ParseHKernTag(pHKernTag, namesToCharacters, fontData);
+        parser.pCtxt->sax = pDefaultHandler;
+
+        FinishSAXParse(parser);
+    }
+
+    void ParseSVGFontFile(const char *path, FontData &fontData, const FontParseParams &params)
+    {
+        MappedFile file(path);
+
+        ParseSVGFontData(file.GetData(), file.GetLength(), fontData, params);
+    }
+
+    GlyphPathView GetGlyphPath(const FontData &fontData, const GlyphData &glyphData)
+    {
+        const GlyphPath &path = glyphData.mPath;
+        if (path.textOffset == NO_PATH_TEXT)
+        {
+            return {fontData.mPathStore.mElementTypes.data() + path.firstElement,
+                    fontData.mPathStore.mCoords.data() + path.firstCoord,
+                    path.elementCount};
         }
-        catch(...)
+
+        if (!fontData.mLazyPaths || path.textOffset >= fontData.mPathText.size())
+            throw FontParseError("Glyph has no path text to parse");
+
+        LazyPathCache &cache = *fontData.mLazyPaths;
+        std::lock_guard<std::mutex> lock(cache.mtx);
+
+        auto it = cache.stores.find(path.textOffset);
+        if (it == cache.stores.end())
         {
-            xmlFreeDoc(pDoc);
+            GlyphPathStore store;
+            GlyphPath parsed;
+            ParseSVGPath(fontData.mPathText.c_str() + path.textOffset, store, parsed);
 
-            std::rethrow_exception(std::current_exception());
+            it = cache.stores.emplace(path.textOffset, std::move(store)).first;
         }
-        xmlFreeDoc(pDoc);
+
+        // The store doesn't change after this, so the view stays valid without the lock.
+        const GlyphPathStore &store = it->second;
+        return {store.mElementTypes.data(), store.mCoords.data(), (uint32_t)store.mElementTypes.size()};
     }
 }
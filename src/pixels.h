@@ -0,0 +1,73 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef PIXELS_H
+#define PIXELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "image.h"
+
+
+namespace TextGL
+{
+    /**
+     *  Premultiplied ARGB32 pixels, laid out like those of a cairo image surface without padding.
+     */
+    class PixelImage: public Image
+    {
+        private:
+            size_t width, height;
+            uint32_t *pixels;
+            std::unique_ptr<uint32_t[]> ownedPixels;  // NULL if the pixels are in an arena
+        public:
+            PixelImage(const size_t w, const size_t h)
+            : width(w), height(h), ownedPixels(new uint32_t[w * h])
+            {
+                pixels = ownedPixels.get();
+            }
+
+            PixelImage(const size_t w, const size_t h, uint32_t *p): width(w), height(h), pixels(p)
+            {
+            }
+
+            const void *GetData(void) const
+            {
+                return pixels;
+            }
+
+            ImageDataFormat GetFormat(void) const
+            {
+                return IMAGEFORMAT_ARGB32;
+            }
+
+            void GetDimensions(size_t &w, size_t &h) const
+            {
+                w = width;
+                h = height;
+            }
+
+            uint32_t *GetPixels(void)
+            {
+                return pixels;
+            }
+    };
+}
+
+#endif  // PIXELS_H
@@ -0,0 +1,337 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <math.h>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+#include "image.h"
+#include "arc.h"
+
+
+/* Curves and arcs are cut into lines that are at most this far off, in pixels.
+ * Further than that, the difference in coverage is hardly visible.
+ */
+#define FLATTEN_TOLERANCE 0.1
+
+#define PI 3.14159265358979323846
+
+namespace TextGL
+{
+    /**
+     *  Sums up the signed area that the outline's lines cover in each pixel.
+     *  Each row has two extra cells, so that lines at the right edge don't
+     *  spill into the next row. Once all lines are in, the running sum
+     *  along a row gives the winding of each pixel, partly covered ones included.
+     */
+    class CoverageAccumulator
+    {
+        private:
+            size_t width, height, rowLength;
+            std::vector<float> cells;
+
+            // In pixels, for closing subpaths.
+            double startX, startY,
+                   currentX, currentY;
+        public:
+            void Reset(const size_t w, const size_t h)
+            {
+                width = w;
+                height = h;
+                rowLength = w + 2;
+
+                cells.assign(rowLength * h, 0.0f);
+
+                startX = startY = currentX = currentY = 0.0;
+            }
+
+            /**
+             *  Based on the accumulation rasterizer of font-rs.
+             */
+            void AddLine(double x0, double y0, double x1, double y1)
+            {
+                if (y0 == y1)
+                    return;  // horizontal lines don't change the winding
+
+                float direction = 1.0f;
+                if (y0 > y1)
+                {
+                    std::swap(x0, x1);
+                    std::swap(y0, y1);
+                    direction = -1.0f;
+                }
+
+                if (y1 <= 0.0 || y0 >= height)
+                    return;
+
+                double dxdy = (x1 - x0) / (y1 - y0),
+                       x = x0;
+
+                if (y0 < 0.0)
+                    x -= y0 * dxdy;
+
+                size_t yStart = std::max(y0, 0.0),
+                       yEnd = std::min((size_t)ceil(y1), height);
+                for (size_t y = yStart; y < yEnd; y++)
+                {
+                    float *row = cells.data() + y * rowLength;
+
+                    double dy = std::min(y + 1.0, y1) - std::max((double)y, y0),
+                           xNext = x + dxdy * dy;
+                    float d = dy * direction;
+
+                    /* Whatever is left of the image piles up in the first column and whatever is right of it
+                     * in the extra column, that isn't part of the image. The winding further right stays the same.
+                     */
+                    double xa = std::min(std::max(x, 0.0), (double)width),
+                           xb = std::min(std::max(xNext, 0.0), (double)width),
+                           xLeft = std::min(xa, xb),
+                           xRight = std::max(xa, xb);
+
+                    double xLeftFloor = floor(xLeft),
+                           xRightCeil = ceil(xRight);
+                    size_t iLeft = xLeftFloor,
+                           iRight = xRightCeil;
+
+                    if (iRight <= iLeft + 1)
+                    {
+                        // Within one pixel: split by where the line is on average.
+                        float xMid = 0.5 * (xa + xb) - xLeftFloor;
+                        row[iLeft] += d - d * xMid;
+                        row[iLeft + 1] += d * xMid;
+                    }
+                    else
+                    {
+                        // Across several pixels: a triangle in the first and last, a trapezoid in between.
+                        float s = 1.0 / (xRight - xLeft),
+                              xLeftFraction = xLeft - xLeftFloor,
+                              aLeft = 0.5f * s * (1.0f - xLeftFraction) * (1.0f - xLeftFraction),
+                              xRightFraction = xRight - xRightCeil + 1.0,
+                              aRight = 0.5f * s * xRightFraction * xRightFraction;
+
+                        row[iLeft] += d * aLeft;
+                        if (iRight == iLeft + 2)
+                            row[iLeft + 1] += d * (1.0f - aLeft - aRight);
+                        else
+                        {
+                            float a1 = s * (1.5f - xLeftFraction);
+                            row[iLeft + 1] += d * (a1 - aLeft);
+                            for (size_t i = iLeft + 2; i < iRight - 1; i++)
+                                row[i] += d * s;
+
+                            float a2 = a1 + (iRight - iLeft - 3) * s;
+                            row[iRight - 1] += d * (1.0f - a2 - aRight);
+                        }
+                        row[iRight] += d * aRight;
+                    }
+
+                    x = xNext;
+                }
+            }
+
+            void MoveTo(const double x, const double y)
+            {
+                ClosePath();
+
+                startX = currentX = x;
+                startY = currentY = y;
+            }
+
+            void LineTo(const double x, const double y)
+            {
+                AddLine(currentX, currentY, x, y);
+
+                currentX = x;
+                currentY = y;
+            }
+
+            void CurveTo(const double x1, const double y1, const double x2, const double y2, const double x, const double y)
+            {
+                double x0 = currentX,
+                       y0 = currentY;
+
+                /* Cut into n equal steps of t. The distance to the curve is then at most
+                 * 3/4 of the largest second difference of the control points, divided by n squared.
+                 */
+                double ddx = std::max(fabs(x0 - 2 * x1 + x2), fabs(x1 - 2 * x2 + x)),
+                       ddy = std::max(fabs(y0 - 2 * y1 + y2), fabs(y1 - 2 * y2 + y));
+                int n = std::min(std::max((int)ceil(sqrt(0.75 * std::max(ddx, ddy) / FLATTEN_TOLERANCE)), 1), 256);
+
+                for (int i = 1; i < n; i++)
+                {
+                    double t = (double)i / n,
+                           u = 1.0 - t,
+                           a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, e = t * t * t;
+
+                    LineTo(a * x0 + b * x1 + c * x2 + e * x,
+                           a * y0 + b * y1 + c * y2 + e * y);
+                }
+                LineTo(x, y);
+            }
+
+            /**
+             *  The arc parameters are in path units, 'scale', 'dx' and 'dy' map them to pixels.
+             */
+            void ArcTo(const double rx, const double ry, const double rotate, const bool largeArc, const bool sweep,
+                       const double x, const double y, const double scale, const double dx, const double dy)
+            {
+                double pathX = (currentX - dx) / scale,
+                       pathY = (currentY - dy) / scale;
+
+                if (rx == 0.0 || ry == 0.0 || (x == pathX && y == pathY))
+                {
+                    LineTo(x * scale + dx, y * scale + dy);
+                    return;
+                }
+
+                ArcCircle circle;
+                GetArcCircle(pathX, pathY, rx, ry, rotate, largeArc, sweep, x, y, circle);
+
+                // Go around the same way cairo_arc and cairo_arc_negative do.
+                double angle1 = circle.angle1,
+                       angle2 = circle.angle2;
+                if (sweep)
+                {
+                    while (angle2 < angle1)
+                        angle2 += 2 * PI;
+                }
+                else
+                {
+                    while (angle2 > angle1)
+                        angle2 -= 2 * PI;
+                }
+
+                // The step angle at which a chord is off by the tolerance.
+                double radius = circle.radius * std::max(1.0, circle.radiiRatio) * scale,
+                       maxStep = 2 * acos(std::max(1.0 - FLATTEN_TOLERANCE / radius, -1.0));
+                int n = std::min(std::max((int)ceil(fabs(angle2 - angle1) / maxStep), 1), 1024);
+
+                double cosRotate = cos(rotate),
+                       sinRotate = sin(rotate);
+                for (int i = 1; i < n; i++)
+                {
+                    double angle = angle1 + (angle2 - angle1) * i / n,
+                           cx = circle.xc + circle.radius * cos(angle),
+                           cy = (circle.yc + circle.radius * sin(angle)) * circle.radiiRatio;
+
+                    LineTo((pathX + cx * cosRotate - cy * sinRotate) * scale + dx,
+                           (pathY + cx * sinRotate + cy * cosRotate) * scale + dy);
+                }
+                LineTo(x * scale + dx, y * scale + dy);
+            }
+
+            /**
+             *  Filling closes every subpath, also without a closepath.
+             */
+            void ClosePath(void)
+            {
+                LineTo(startX, startY);
+            }
+
+            void WriteCoverage(uint8_t *coverage, const size_t stride) const
+            {
+                for (size_t y = 0; y < height; y++)
+                {
+                    const float *row = cells.data() + y * rowLength;
+                    uint8_t *out = coverage + y * stride;
+                    size_t x = 0;
+
+                #ifdef __SSE2__
+                    // Four pixels at a time: a running sum within the four, plus the sum of all before.
+                    __m128 sum = _mm_setzero_ps(),
+                           signBits = _mm_set1_ps(-0.0f),
+                           one = _mm_set1_ps(1.0f),
+                           max = _mm_set1_ps(255.0f),
+                           half = _mm_set1_ps(0.5f);
+                    for (; x + 4 <= width; x += 4)
+                    {
+                        __m128 v = _mm_loadu_ps(row + x);
+                        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+                        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+                        v = _mm_add_ps(v, sum);
+                        sum = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+
+                        // Nonzero: any winding, either way, covers the pixel.
+                        __m128 winding = _mm_min_ps(_mm_andnot_ps(signBits, v), one);
+                        __m128i bytes = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(winding, max), half));
+                        bytes = _mm_packs_epi32(bytes, bytes);
+                        bytes = _mm_packus_epi16(bytes, bytes);
+
+                        int32_t four = _mm_cvtsi128_si32(bytes);
+                        memcpy(out + x, &four, 4);
+                    }
+                    float total = _mm_cvtss_f32(sum);
+                #else
+                    float total = 0.0f;
+                #endif
+
+                    for (; x < width; x++)
+                    {
+                        total += row[x];
+                        out[x] = std::min(total < 0.0f ? -total : total, 1.0f) * 255.0f + 0.5f;
+                    }
+                }
+            }
+    };
+
+    void RasterizePathCoverage(const GlyphPathView &path, const double scale, const double dx, const double dy,
+                               const size_t width, const size_t height, uint8_t *coverage, const size_t stride)
+    {
+        // Reused for every glyph on the thread, so that only the first one allocates.
+        static thread_local CoverageAccumulator accumulator;
+        accumulator.Reset(width, height);
+
+        const uint8_t *pType = path.pElementTypes,
+                      *pEnd = pType + path.elementCount;
+        const float *pCoords = path.pCoords;
+        for (; pType < pEnd; pType++)
+        {
+            switch (*pType)
+            {
+            case ELEMENT_MOVETO:
+                accumulator.MoveTo(pCoords[0] * scale + dx, pCoords[1] * scale + dy);
+                break;
+            case ELEMENT_LINETO:
+                accumulator.LineTo(pCoords[0] * scale + dx, pCoords[1] * scale + dy);
+                break;
+            case ELEMENT_CURVETO:
+                accumulator.CurveTo(pCoords[0] * scale + dx, pCoords[1] * scale + dy,
+                                    pCoords[2] * scale + dx, pCoords[3] * scale + dy,
+                                    pCoords[4] * scale + dx, pCoords[5] * scale + dy);
+                break;
+            case ELEMENT_ARCTO:
+                accumulator.ArcTo(pCoords[0], pCoords[1], pCoords[2], pCoords[3] != 0.0f, pCoords[4] != 0.0f,
+                                  pCoords[5], pCoords[6], scale, dx, dy);
+                break;
+            case ELEMENT_CLOSEPATH:
+                accumulator.ClosePath();
+                break;
+            default:
+                throw FontImageError("Unsupported path element: %x", *pType);
+            }
+
+            pCoords += PATH_ELEMENT_COORD_COUNTS[*pType];
+        }
+        accumulator.ClosePath();
+
+        accumulator.WriteCoverage(coverage, stride);
+    }
+}
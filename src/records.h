@@ -0,0 +1,69 @@
+/* Copyright (C) 2018 Coos Baakman
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include <cstring>
+#include <iostream>
+
+#include "font.h"
+
+
+namespace TextGL
+{
+    template <typename Record>
+    void WriteRecord(std::ostream &os, const Record &record)
+    {
+        os.write((const char *)&record, sizeof(Record));
+    }
+
+    /**
+     *  Reads records from the data, without assuming any alignment.
+     */
+    class RecordReader
+    {
+        private:
+            const char *pData,
+                       *pEnd;
+            const char *truncatedMessage;  // thrown as FontParseError
+        public:
+            RecordReader(const char *data, const size_t length, const char *truncated)
+            : pData(data), pEnd(data + length), truncatedMessage(truncated)
+            {
+            }
+
+            template <typename Record>
+            const char *Require(const size_t count)
+            {
+                if (count > size_t(pEnd - pData) / sizeof(Record))
+                    throw FontParseError("%s", truncatedMessage);
+
+                const char *p = pData;
+                pData += count * sizeof(Record);
+                return p;
+            }
+
+            template <typename Record>
+            static void Get(const char *p, const size_t index, Record &record)
+            {
+                memcpy(&record, p + index * sizeof(Record), sizeof(Record));
+            }
+    };
+}
+
+#endif  // RECORDS_H
@@ -15,6 +15,10 @@
 */
 
 #include "tex.h"
+#include "atlas.h"
+#include "bundle.h"
+#include "arena.h"
+#include "cache.h"
 
 #ifdef DEBUG
     #define CHECK_GL() { GLenum err = glGetError(); if (err != GL_NO_ERROR) throw FontGLError(err, __FILE__, __LINE__); }
@@ -30,36 +34,25 @@ namespace TextGL
     GLTextureGlyph::~GLTextureGlyph(void)
     {
     }
-    GLTextureFont::GLTextureFont(void)
+    GLTextureFont::GLTextureFont(void): mMissingGlyph(NULL), mScale(1.0), mSubset(false), mArena(NULL)
     {
     }
     GLTextureFont::~GLTextureFont(void)
     {
     }
-    void DestroyGLTextureGlyph(GLTextureGlyph *pTextureGlyph)
+    /**
+     *  Leaves the new texture bound.
+     */
+    GLuint MakeGLTexture(void)
     {
-        glDeleteTextures(1, &(pTextureGlyph->texture));
+        GLuint texture;
+        glGenTextures(1, &texture);
         CHECK_GL();
 
-        delete pTextureGlyph;
-    }
-    GLTextureGlyph *MakeGLTextureGlyph(const ImageGlyph *pImageGlyph)
-    {
-        GLTextureGlyph *pTextureGlyph = new GLTextureGlyph;
-        pTextureGlyph->mMetrics = pImageGlyph->mMetrics;
-
-        size_t w, h;
-        pImageGlyph->mImage->GetDimensions(w, h);
-        pTextureGlyph->textureWidth = w;
-        pTextureGlyph->textureHeight = h;
-
-        glGenTextures(1, &(pTextureGlyph->texture));
-        CHECK_GL();
-
-        if (pTextureGlyph->texture == NULL)
+        if (texture == NULL)
             throw GLError("No GL texture was generated");
 
-        glBindTexture(GL_TEXTURE_2D, pTextureGlyph->texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
         CHECK_GL();
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -74,24 +67,57 @@ namespace TextGL
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
         CHECK_GL();
 
-        switch (pImageGlyph->mImage->GetFormat())
+        return texture;
+    }
+    /**
+     *  The glyph is made in the arena, it's freed with the arena.
+     */
+    GLTextureGlyph *MakeGLTextureGlyph(const ImageGlyph *pImageGlyph, Arena *pArena)
+    {
+        GLTextureGlyph *pTextureGlyph = new (pArena->Allocate(sizeof(GLTextureGlyph), alignof(GLTextureGlyph)))
+                                        GLTextureGlyph;
+        pTextureGlyph->mMetrics = pImageGlyph->mMetrics;
+
+        size_t w, h;
+        pImageGlyph->mImage->GetDimensions(w, h);
+        pTextureGlyph->textureWidth = w;
+        pTextureGlyph->textureHeight = h;
+
+        // The texture holds the whole image.
+        pTextureGlyph->rectX = pTextureGlyph->rectY = 0;
+        pTextureGlyph->rectWidth = w;
+        pTextureGlyph->rectHeight = h;
+        pTextureGlyph->u0 = pTextureGlyph->v0 = 0.0f;
+        pTextureGlyph->u1 = pTextureGlyph->v1 = 1.0f;
+
+        pTextureGlyph->texture = MakeGLTexture();
+
+        try
         {
-        case IMAGEFORMAT_RGBA32:
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
-                         pTextureGlyph->textureWidth, pTextureGlyph->textureHeight,
-                         0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8,
-                         pImageGlyph->mImage->GetData());
-            break;
-        case IMAGEFORMAT_ARGB32:
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
-                         pTextureGlyph->textureWidth, pTextureGlyph->textureHeight,
-                         0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
-                         pImageGlyph->mImage->GetData());
-            break;
-        default:
-            throw FontImageError("Unsupported image format: %x", pImageGlyph->mImage->GetFormat());
+            switch (pImageGlyph->mImage->GetFormat())
+            {
+            case IMAGEFORMAT_RGBA32:
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+                             pTextureGlyph->textureWidth, pTextureGlyph->textureHeight,
+                             0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8,
+                             pImageGlyph->mImage->GetData());
+                break;
+            case IMAGEFORMAT_ARGB32:
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+                             pTextureGlyph->textureWidth, pTextureGlyph->textureHeight,
+                             0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+                             pImageGlyph->mImage->GetData());
+                break;
+            default:
+                throw FontImageError("Unsupported image format: %x", pImageGlyph->mImage->GetFormat());
+            }
+            CHECK_GL();
+        }
+        catch (...)
+        {
+            glDeleteTextures(1, &pTextureGlyph->texture);
+            throw;
         }
-        CHECK_GL();
 
         glBindTexture(GL_TEXTURE_2D, NULL);
         CHECK_GL();
@@ -102,29 +128,213 @@ namespace TextGL
     GLTextureFont *MakeGLTextureFont(const ImageFont *pImageFont)
     {
         GLTextureFont *pTextureFont = new GLTextureFont;
-        pTextureFont->mHorizontalKernTable = pImageFont->mHorizontalKernTable;
+        pTextureFont->mUnscaled = pImageFont->mUnscaled;
+        pTextureFont->mScale = pImageFont->mScale;
+        pTextureFont->mSubset = pImageFont->mSubset;
         pTextureFont->mMetrics = pImageFont->mMetrics;
         pTextureFont->style = pImageFont->style;
 
-        for (const auto &pair : pImageFont->mGlyphs)
+        pTextureFont->mArena = new Arena;
+        Arena *pArena = pTextureFont->mArena;
+
+        // Characters that share an image, share the texture too.
+        std::unordered_map<const ImageGlyph *, GLTextureGlyph *> textureGlyphs;
+        auto MakeSharedTextureGlyph = [&textureGlyphs, pArena](const ImageGlyph *pImageGlyph)
         {
-            const UTF8Char c = std::get<0>(pair);
-            const ImageGlyph *pImageGlyph = std::get<1>(pair);
+            GLTextureGlyph *&pTextureGlyph = textureGlyphs[pImageGlyph];
+            if (pTextureGlyph == NULL)
+                pTextureGlyph = MakeGLTextureGlyph(pImageGlyph, pArena);
+            return pTextureGlyph;
+        };
+
+        /*
+         *  A lazily rendered font goes through its cache, one glyph at a time.
+         *  Evicted images may be reallocated at the same address, so the textures
+         *  are shared by glyph data there.
+         */
+        std::unordered_map<const GlyphData *, GLTextureGlyph *, SameGlyphHash, SameGlyphEqual> cachedGlyphs;
+
+        try
+        {
+            for (const auto &pair : pImageFont->mGlyphs)
+            {
+                const UTF8Char c = std::get<0>(pair);
+                const ImageGlyph *pImageGlyph = std::get<1>(pair);
+
+                pTextureFont->mGlyphs[c] = MakeSharedTextureGlyph(pImageGlyph);
+            }
+
+            if (pImageFont->mCache != NULL)
+            {
+                for (const auto &pair : pImageFont->mCache->GetCharacters())
+                {
+                    const UTF8Char c = std::get<0>(pair);
+                    const GlyphCache::Character &character = std::get<1>(pair);
+
+                    // Rendering may throw here.
+                    GLTextureGlyph *&pTextureGlyph = cachedGlyphs[character.pGlyphData];
+                    if (pTextureGlyph == NULL)
+                        pTextureGlyph = MakeGLTextureGlyph(pImageFont->mCache->GetGlyph(character), pArena);
 
-            pTextureFont->mGlyphs[c] = MakeGLTextureGlyph(pImageGlyph);
+                    pTextureFont->mGlyphs[c] = pTextureGlyph;
+                }
+            }
+
+            if (pImageFont->mMissingGlyph != NULL)
+                pTextureFont->mMissingGlyph = MakeSharedTextureGlyph(pImageFont->mMissingGlyph);
+        }
+        catch (...)
+        {
+            std::vector<GLuint> textures;
+            for (const auto &pair : textureGlyphs)
+            {
+                if (pair.second != NULL)
+                    textures.push_back(pair.second->GetTexture());
+            }
+            for (const auto &pair : cachedGlyphs)
+            {
+                if (pair.second != NULL)
+                    textures.push_back(pair.second->GetTexture());
+            }
+
+            glDeleteTextures(textures.size(), textures.data());
+            delete pTextureFont->mArena;
+            delete pTextureFont;
+            throw;
         }
 
         return pTextureFont;
     }
+    GLTextureFont *MakeGLTextureFont(const FontBundle &bundle)
+    {
+        GLTextureFont *pTextureFont = new GLTextureFont;
+        pTextureFont->mUnscaled = bundle.mUnscaled;
+        pTextureFont->mScale = bundle.mScale;
+        pTextureFont->mMetrics = bundle.mMetrics;
+        pTextureFont->style = bundle.mStyle;
+
+        // A subset's bundle only kept the kerning between its own characters, so there's nothing left to filter.
+        pTextureFont->mSubset = false;
+
+        pTextureFont->mArena = new Arena;
+
+        std::vector<GLuint> textures;
+        try
+        {
+            for (const FontBundleImage &image : bundle.mImages)
+            {
+                textures.push_back(MakeGLTexture());
+
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height,
+                             0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, image.pixels.data());
+                CHECK_GL();
+            }
+
+            glBindTexture(GL_TEXTURE_2D, 0);
+            CHECK_GL();
+        }
+        catch (...)
+        {
+            glDeleteTextures(textures.size(), textures.data());
+            delete pTextureFont->mArena;
+            delete pTextureFont;
+            throw;
+        }
+
+        Arena *pArena = pTextureFont->mArena;
+        auto MakeAtlasGlyph = [pArena, &textures](const FontBundleGlyph &glyph)
+        {
+            GLTextureGlyph *pTextureGlyph = new (pArena->Allocate(sizeof(GLTextureGlyph), alignof(GLTextureGlyph)))
+                                            GLTextureGlyph;
+            pTextureGlyph->mMetrics = glyph.mMetrics;
+
+            // Glyphs with nothing to draw still need a texture to bind, any will do.
+            const AtlasRect &rect = glyph.mRect;
+            pTextureGlyph->texture = textures.empty() ? 0 : textures[rect.width > 0 ? rect.image : 0];
+
+            pTextureGlyph->textureWidth = rect.imageWidth;
+            pTextureGlyph->textureHeight = rect.imageHeight;
+            pTextureGlyph->rectX = rect.offsetX;
+            pTextureGlyph->rectY = rect.offsetY;
+            pTextureGlyph->rectWidth = rect.width;
+            pTextureGlyph->rectHeight = rect.height;
+            pTextureGlyph->u0 = rect.u0;
+            pTextureGlyph->v0 = rect.v0;
+            pTextureGlyph->u1 = rect.u1;
+            pTextureGlyph->v1 = rect.v1;
+
+            return pTextureGlyph;
+        };
+
+        pTextureFont->mGlyphs.reserve(bundle.mGlyphs.size());
+        for (const auto &pair : bundle.mGlyphs)
+            pTextureFont->mGlyphs[pair.first] = MakeAtlasGlyph(pair.second);
+
+        if (bundle.mHasMissingGlyph)
+            pTextureFont->mMissingGlyph = MakeAtlasGlyph(bundle.mMissingGlyph);
+
+        return pTextureFont;
+    }
     void DestroyGLTextureFont(GLTextureFont *pTextureFont)
     {
+        // Glyphs may be shared by several characters.
+        std::unordered_set<GLTextureGlyph *> glyphs;
         for (const auto &pair : pTextureFont->mGlyphs)
         {
-            DestroyGLTextureGlyph(std::get<1>(pair));
+            glyphs.insert(std::get<1>(pair));
         }
 
+        if (pTextureFont->mMissingGlyph != NULL)
+            glyphs.insert(pTextureFont->mMissingGlyph);
+
+        // The glyphs themselves are all in the arena, only their textures need deleting. Those may be shared too.
+        std::unordered_set<GLuint> uniqueTextures;
+        for (GLTextureGlyph *pGlyph : glyphs)
+            uniqueTextures.insert(pGlyph->texture);
+
+        std::vector<GLuint> textures(uniqueTextures.begin(), uniqueTextures.end());
+        glDeleteTextures(textures.size(), textures.data());
+        CHECK_GL();
+
+        delete pTextureFont->mArena;
         delete pTextureFont;
     }
+    void UploadGlyphAtlas(DynamicGlyphAtlas *pAtlas, std::vector<GLuint> &textures)
+    {
+        for (const AtlasDirtyRect &dirty : pAtlas->TakeDirtyRects())
+        {
+            const Image *pImage = pAtlas->GetImage(dirty.image);
+            size_t w, h;
+            pImage->GetDimensions(w, h);
+
+            while (textures.size() <= dirty.image)
+            {
+                textures.push_back(MakeGLTexture());
+
+                // Allocated here, filled in below.
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, NULL);
+                CHECK_GL();
+            }
+
+            glBindTexture(GL_TEXTURE_2D, textures[dirty.image]);
+            CHECK_GL();
+
+            // Only the dirty rows and columns are read from the atlas image.
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, w);
+            CHECK_GL();
+
+            const uint32_t *pixels = (const uint32_t *)pImage->GetData();
+            glTexSubImage2D(GL_TEXTURE_2D, 0, dirty.x, dirty.y, dirty.width, dirty.height,
+                            GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, pixels + dirty.y * w + dirty.x);
+            CHECK_GL();
+
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            CHECK_GL();
+        }
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        CHECK_GL();
+    }
     const GlyphMetrics *GLTextureGlyph::GetMetrics(void) const
     {
         return &mMetrics;
@@ -138,6 +348,20 @@ namespace TextGL
         width = textureWidth;
         height = textureHeight;
     }
+    void GLTextureGlyph::GetTextureRect(GLsizei &x, GLsizei &y, GLsizei &width, GLsizei &height) const
+    {
+        x = rectX;
+        y = rectY;
+        width = rectWidth;
+        height = rectHeight;
+    }
+    void GLTextureGlyph::GetTextureCoords(GLfloat &u0, GLfloat &v0, GLfloat &u1, GLfloat &v1) const
+    {
+        u0 = this->u0;
+        v0 = this->v0;
+        u1 = this->u1;
+        v1 = this->v1;
+    }
     const FontMetrics *GLTextureFont::GetMetrics(void) const
     {
         return &mMetrics;
@@ -153,12 +377,32 @@ namespace TextGL
 
         return mGlyphs.at(c);
     }
+    const GLTextureGlyph *GLTextureFont::FindGlyph(const UTF8Char c) const noexcept
+    {
+        auto it = mGlyphs.find(c);
+        if (it == mGlyphs.end())
+            return mMissingGlyph;
+
+        return it->second;
+    }
     const GlyphMetrics *GLTextureFont::GetGlyphMetrics(const UTF8Char c) const
     {
         return GetGlyph(c)->GetMetrics();
     }
-    const KernTable *GLTextureFont::GetHorizontalKernTable(void) const
+    const GlyphMetrics *GLTextureFont::FindGlyphMetrics(const UTF8Char c) const noexcept
     {
-        return &mHorizontalKernTable;
+        const GLTextureGlyph *pGlyph = FindGlyph(c);
+        if (pGlyph == NULL)
+            return NULL;
+
+        return pGlyph->GetMetrics();
+    }
+    double GLTextureFont::GetHorizontalKern(const UTF8Char c1, const UTF8Char c2) const
+    {
+        double k = GetKernValue(mUnscaled->mHorizontalKernTable, c1, c2);
+        if (k == 0.0 || (mSubset && (mGlyphs.count(c1) == 0 || mGlyphs.count(c2) == 0)))
+            return 0.0;
+
+        return k * mScale;
     }
 }
@@ -14,6 +14,15 @@
   3. This notice may not be removed or altered from any source distribution.
 */
 
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
 #include "text.h"
 
 
@@ -33,192 +42,316 @@ namespace TextGL
         details.descent = pFont->GetMetrics()->descent;
     }
 
-    void SetGlyphQuad(const GLTextureFont *pFont, const UTF8Char c,
+    void SetGlyphQuad(const GLTextureFont *pFont, const GLTextureGlyph *pGlyph,
                       const GLfloat x, const GLfloat y,
                       GlyphQuad &quad)
     {
-        const GLTextureGlyph *pGlyph = pFont->GetGlyph(c);
         const GlyphMetrics *pGlyphMetrics = pGlyph->GetMetrics();
         const FontMetrics *pFontMetrics = pFont->GetMetrics();
 
         quad.texture = pGlyph->GetTexture();
 
-        GLsizei tw, th;
+        GLsizei tw, th, rx, ry, rw, rh;
         pGlyph->GetTextureDimensions(tw, th);
+        pGlyph->GetTextureRect(rx, ry, rw, rh);
+
+        GLfloat u0, v0, u1, v1;
+        pGlyph->GetTextureCoords(u0, v0, u1, v1);
+
+        // Only the part of the glyph's image that's in the texture is drawn, its rows count from the bottom.
+        GLfloat left = x + pFontMetrics->bbox.left + pGlyphMetrics->bearingX + rx,
+                bottom = y + pFontMetrics->bbox.top + pGlyphMetrics->bearingY - th + ry;
 
         // top left
-        quad.vertices[3].x = x + pFontMetrics->bbox.left + pGlyphMetrics->bearingX;
-        quad.vertices[3].y = y + pFontMetrics->bbox.top + pGlyphMetrics->bearingY;
-        quad.vertices[3].tx = 0.0f;
-        quad.vertices[3].ty = 1.0f;
+        quad.vertices[3].x = left;
+        quad.vertices[3].y = bottom + rh;
+        quad.vertices[3].tx = u0;
+        quad.vertices[3].ty = v1;
 
         // top right
-        quad.vertices[2].x = quad.vertices[3].x + tw;
+        quad.vertices[2].x = left + rw;
         quad.vertices[2].y = quad.vertices[3].y;
-        quad.vertices[2].tx = 1.0f;
-        quad.vertices[2].ty = 1.0f;
+        quad.vertices[2].tx = u1;
+        quad.vertices[2].ty = v1;
 
         // bottom right
         quad.vertices[1].x = quad.vertices[2].x;
-        quad.vertices[1].y = quad.vertices[2].y - th;
-        quad.vertices[1].tx = 1.0f;
-        quad.vertices[1].ty = 0.0f;
+        quad.vertices[1].y = bottom;
+        quad.vertices[1].tx = u1;
+        quad.vertices[1].ty = v0;
 
         // bottom left
-        quad.vertices[0].x = quad.vertices[3].x;
-        quad.vertices[0].y = quad.vertices[3].y - th;
-        quad.vertices[0].tx = 0.0f;
-        quad.vertices[0].ty = 0.0f;
+        quad.vertices[0].x = left;
+        quad.vertices[0].y = bottom;
+        quad.vertices[0].tx = u0;
+        quad.vertices[0].ty = v0;
     }
 
     double GetKernValue(const KernTable &kernTable, const UTF8Char c1, const UTF8Char c2)
     {
-        if (kernTable.find(c1) == kernTable.end())
+        auto it1 = kernTable.find(c1);
+        if (it1 == kernTable.end())
             return 0.0;
 
-        const auto &m2 = kernTable.at(c1);
-
-        if (m2.find(c2) == m2.end())
+        auto it2 = it1->second.find(c2);
+        if (it2 == it1->second.end())
             return 0.0;
 
-        return m2.at(c2);
+        return it2->second;
     }
 
-    bool IsSpace(const UTF8Char c)
+    /**
+     *  Layout must not be interrupted by bad input, so invalid utf-8
+     *  comes out as UTF8_REPLACEMENT_CHAR here.
+     */
+    const int8_t *NextChar(const int8_t *p, UTF8Char &c)
     {
-        return c == ' ' || c == '\t';
+        bool valid;
+        return NextUTF8Char(p, c, valid);
     }
 
-    const int8_t *SkipSpaces(const int8_t *p)
+    /**
+     *  Counts the characters from p up to (not including) end.
+     */
+    size_t CountChars(const int8_t *p, const int8_t *end)
     {
-        const int8_t *next;
+        size_t n = 0;
         UTF8Char c;
+        while (p < end)
+        {
+            p = NextChar(p, c);
+            n++;
+        }
+        return n;
+    }
 
-        while (true)
+    /**
+     *  Characters without glyph and without missing glyph take no space.
+     */
+    GLfloat GetAdvance(const Font *pFont, const UTF8Char c)
+    {
+        const GlyphMetrics *pMetrics = pFont->FindGlyphMetrics(c);
+        if (pMetrics == NULL)
+            return 0.0f;
+
+        return pMetrics->advanceX;
+    }
+
+    /**
+     *  One bit per byte of the text. Bytes of multibyte utf-8 characters
+     *  never equal these ascii values, so the text needn't be decoded to find them.
+     */
+    struct TextBreaks
+    {
+        size_t length;  // in bytes, the offset of the terminating NULL
+        std::vector<uint64_t> spaceBits,  // ' ' and '\t'
+                              lineBits;  // '\n' and '\r'
+    };
+
+    void ScanTextBreaks(const int8_t *text, TextBreaks &breaks)
+    {
+        size_t i = 0,
+               n = strlen((const char *)text);
+
+        // Always have room for the bit at the terminating NULL.
+        breaks.length = n;
+        breaks.spaceBits.assign(n / 64 + 1, 0);
+        breaks.lineBits.assign(n / 64 + 1, 0);
+
+    #ifdef __SSE2__
+        const __m128i spaces = _mm_set1_epi8(' '),
+                      tabs = _mm_set1_epi8('\t'),
+                      newlines = _mm_set1_epi8('\n'),
+                      returns = _mm_set1_epi8('\r');
+
+        // 16 bytes at a time, four blocks per 64-bit word.
+        for (; (i + 16) <= n; i += 16)
         {
-            next = NextUTF8Char(p, c);
-            if (c == NULL || !IsSpace(c))
-                return p;
-            else
-                p = next;
+            __m128i bytes = _mm_loadu_si128((const __m128i *)(text + i));
+
+            uint64_t s = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, spaces),
+                                                        _mm_cmpeq_epi8(bytes, tabs))),
+                     l = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, newlines),
+                                                        _mm_cmpeq_epi8(bytes, returns)));
+
+            breaks.spaceBits[i / 64] |= s << (i % 64);
+            breaks.lineBits[i / 64] |= l << (i % 64);
+        }
+    #endif  // __SSE2__
+
+        for (; i < n; i++)
+        {
+            uint64_t bit = uint64_t(1) << (i % 64);
+
+            if (text[i] == ' ' || text[i] == '\t')
+                breaks.spaceBits[i / 64] |= bit;
+            else if (text[i] == '\n' || text[i] == '\r')
+                breaks.lineBits[i / 64] |= bit;
         }
     }
 
-    bool AtLineEnding(const int8_t *p, const int8_t *&past)
+    /**
+     *  returns the offset of the first space or line break at or after i,
+     *  or the text length if there's none.
+     */
+    size_t NextBreak(const TextBreaks &breaks, size_t i)
     {
-        UTF8Char c;
+        size_t w = i / 64;
+        uint64_t word = (breaks.spaceBits[w] | breaks.lineBits[w]) & (~uint64_t(0) << (i % 64));
 
-        past = NextUTF8Char(p, c);
-        if (c == '\n')
-            return true;
-        else if (c == '\r')  // Detect windows line endings.
+        while (word == 0)
         {
-            past = NextUTF8Char(p, c);
-            if (c == '\n')
-                return true;
+            w++;
+            if (w >= breaks.spaceBits.size())
+                return breaks.length;
+
+            word = breaks.spaceBits[w] | breaks.lineBits[w];
         }
-        return false;
+
+        return std::min(w * 64 + __builtin_ctzll(word), breaks.length);
     }
 
-    bool AtStringEnding(const int8_t *p)
+    /**
+     *  returns the offset of the first byte at or after i, that's not a space.
+     */
+    size_t SkipSpaces(const TextBreaks &breaks, size_t i)
     {
-        UTF8Char c;
+        size_t w = i / 64;
 
-        NextUTF8Char(p, c);
+        // The bits past the text length are never set, so this always ends.
+        uint64_t word = ~breaks.spaceBits[w] & (~uint64_t(0) << (i % 64));
+        while (word == 0)
+        {
+            w++;
+            word = ~breaks.spaceBits[w];
+        }
+
+        return std::min(w * 64 + __builtin_ctzll(word), breaks.length);
+    }
+
+    bool IsLineBreak(const TextBreaks &breaks, const size_t i)
+    {
+        return (breaks.lineBits[i / 64] >> (i % 64)) & 1;
+    }
+
+    /**
+     *  Takes "\n", "\r\n" (windows) and "\r" (old mac) as line endings.
+     */
+    bool AtLineEnding(const int8_t *text, const TextBreaks &breaks, const size_t i, size_t &past)
+    {
+        if (i >= breaks.length || !IsLineBreak(breaks, i))
+            return false;
 
-        return c == NULL;
+        if (text[i] == '\r' && text[i + 1] == '\n')
+            past = i + 2;
+        else
+            past = i + 1;
+
+        return true;
     }
 
-    GLfloat NextWordWidth(const Font *pFont, const int8_t *text, const int8_t *&pEnd)
+    GLfloat MeasureWidth(const Font *pFont, const int8_t *p, const int8_t *end)
     {
         GLfloat w = 0.0f;
         UTF8Char c, cPrev = NULL;
-        const int8_t *p = text, *next;
 
-        // First read all the whitespaces preceeding the word.
-        while (true)
+        while (p < end)
         {
-            next = NextUTF8Char(p, c);
-            if (AtStringEnding(p) || AtLineEnding(p, next))
-            {
-                // Don't count "  \n" as a word.
-                pEnd = p;
-                return 0.0f;
-            }
-            else if (!IsSpace(c))
-                break;
+            p = NextChar(p, c);
+
+            // Like IterateText, skip characters without glyph when kerning.
+            if (pFont->FindGlyphMetrics(c) == NULL)
+                continue;
 
             if (cPrev != NULL)
-                w += GetKernValue(*(pFont->GetHorizontalKernTable()), cPrev, c);
+                w += pFont->GetHorizontalKern(cPrev, c);
 
-            w += pFont->GetGlyphMetrics(c)->advanceX;
+            w += GetAdvance(pFont, c);
 
-            p = next;
             cPrev = c;
         }
 
-        // Next read until the first whitespace.
-        while (true)
+        return w;
+    }
+
+    /**
+     *  A word includes the spaces preceeding it.
+     */
+    GLfloat NextWordWidth(const Font *pFont, const int8_t *text, const TextBreaks &breaks,
+                          WordWidthCache *pCache, const size_t start, size_t &end)
+    {
+        size_t i = SkipSpaces(breaks, start);
+        if (i >= breaks.length || IsLineBreak(breaks, i))
         {
-            next = NextUTF8Char(p, c);
-            if (AtStringEnding(p) || AtLineEnding(p, next) || IsSpace(c))
-            {
-                pEnd = p;
-                return w;
-            }
+            // Don't count "  \n" as a word.
+            end = i;
+            return 0.0f;
+        }
 
-            if (cPrev != NULL)
-                w += GetKernValue(*(pFont->GetHorizontalKernTable()), cPrev, c);
+        end = NextBreak(breaks, i);
 
-            w += pFont->GetGlyphMetrics(c)->advanceX;
+        if (pCache == NULL)
+            return MeasureWidth(pFont, text + start, text + end);
 
-            p = next;
-            cPrev = c;
+        GLfloat w;
+        if (!pCache->Find(pFont, text + start, text + end, w))
+        {
+            w = MeasureWidth(pFont, text + start, text + end);
+            pCache->Insert(pFont, text + start, text + end, w);
         }
+
+        return w;
     }
 
-    GLfloat NextLineWidth(const Font *pFont, const int8_t *text, const GLfloat maxLineWidth, const int8_t *&pLineEnd)
+    GLfloat NextLineWidth(const Font *pFont, const int8_t *text, const TextBreaks &breaks, WordWidthCache *pCache,
+                          const GLfloat maxLineWidth, const size_t start, size_t &lineEnd)
     {
         GLfloat lineWidth = 0.0f, wordWidth;
-        const int8_t *p = SkipSpaces(text),
-                     *pWordEnd, *past;
-        UTF8Char c = NULL;
+        size_t i = SkipSpaces(breaks, start),
+               wordEnd;
         while (true)
         {
-            wordWidth = NextWordWidth(pFont, p, pWordEnd);
+            wordWidth = NextWordWidth(pFont, text, breaks, pCache, i, wordEnd);
             if (wordWidth > maxLineWidth)
-                throw TextFormatError("Next word of \"%s\" doesn't fit in line width %f", text, maxLineWidth);
+                throw TextFormatError("Next word of \"%s\" doesn't fit in line width %f", text + start, maxLineWidth);
             else if ((lineWidth + wordWidth) > maxLineWidth)
             {
-                pLineEnd = p;
+                lineEnd = i;
                 return lineWidth;
             }
 
             lineWidth += wordWidth;
-            p = pWordEnd;
+            i = wordEnd;
 
-            // Check what character ended the word.
-            if (AtStringEnding(p) || AtLineEnding(p, past))
+            // Check what ended the word.
+            if (i >= breaks.length || IsLineBreak(breaks, i))
             {
-                pLineEnd = p;
+                lineEnd = i;
                 return lineWidth;
             }
         }
     }
 
-    void GLTextLeftToRightIterator::IterateText(const GLTextureFont *pFont, const int8_t *text, const TextParams &params)
+    void GLTextLeftToRightIterator::IterateText(const GLTextureFont *pFont, const int8_t *text, const TextParams &params,
+                                                WordWidthCache *pCache)
     {
         GlyphQuad quad;
         TextSelectionDetails glyphSelection, lineSelection;
         GLfloat x, y = params.startY, x0,
                 lineWidth;
 
-        size_t count;
-        const int8_t *p = text, *next, *pLineEnd;
+        TextBreaks breaks;
+        ScanTextBreaks(text, breaks);
+
+        size_t i = 0,  // byte offset in the text
+               position = 0,  // character position at i
+               lineStart, lineEnd, lineEndPosition, past;
+        const int8_t *p, *next;
+        const GLTextureGlyph *pGlyph;
         UTF8Char c, cPrev;
-        while (!AtStringEnding(p))
+        while (i < breaks.length)
         {
-            lineWidth = NextLineWidth(pFont, p, params.maxWidth, pLineEnd);
+            lineWidth = NextLineWidth(pFont, text, breaks, pCache, params.maxWidth, i, lineEnd);
             cPrev = NULL;
             if (params.align == TEXTALIGN_CENTER)
                 x = params.startX - lineWidth / 2;
@@ -229,41 +362,53 @@ namespace TextGL
             else  // default TEXTALIGN_LEFT
                 x = params.startX;
 
-            p = SkipSpaces(p);
+            // Spaces are one byte each.
+            lineStart = SkipSpaces(breaks, i);
+            position += lineStart - i;
+            lineEndPosition = position + CountChars(text + lineStart, text + lineEnd);
 
             SetTextSelection(pFont,
-                             CountCharsUTF8(text, p), CountCharsUTF8(text, pLineEnd),
+                             position, lineEndPosition,
                              x, x + lineWidth, y, lineSelection);
             OnLine(lineSelection);
 
-            while (p < pLineEnd)
+            for (p = text + lineStart; p < text + lineEnd; p = next)
             {
                 x0 = x;
 
-                next = NextUTF8Char(p, c);
+                next = NextChar(p, c);
 
-                if (cPrev != NULL)
-                    x += GetKernValue(*(pFont->GetHorizontalKernTable()), cPrev, c);
+                pGlyph = pFont->FindGlyph(c);
+                if (pGlyph != NULL)  // Otherwise, leave the character out.
+                {
+                    if (cPrev != NULL)
+                        x += pFont->GetHorizontalKern(cPrev, c);
 
-                SetGlyphQuad(pFont, c, x, y, quad);
+                    SetGlyphQuad(pFont, pGlyph, x, y, quad);
 
-                x += pFont->GetGlyph(c)->GetMetrics()->advanceX;
+                    x += pGlyph->GetMetrics()->advanceX;
 
-                SetTextSelection(pFont,
-                                 CountCharsUTF8(text, p), CountCharsUTF8(text, next),
-                                 x0, x, y, glyphSelection);
-                OnGlyph(c, quad, glyphSelection);
+                    SetTextSelection(pFont,
+                                     position, position + 1,
+                                     x0, x, y, glyphSelection);
+                    OnGlyph(c, quad, glyphSelection);
 
-                cPrev = c;
-                p = next;
+                    cPrev = c;
+                }
+
+                position++;
             }
 
-            // See what character ended the line.
-            if (AtStringEnding(p))
+            // See what ended the line.
+            i = lineEnd;
+            if (i >= breaks.length)
                 return;
 
-            else if (AtLineEnding(p, next))
-                p = next;
+            else if (AtLineEnding(text, breaks, i, past))
+            {
+                position += past - i;
+                i = past;
+            }
 
             // Otherwise it was just a whitespace.
 
@@ -271,25 +416,27 @@ namespace TextGL
         }
     }
 
-    size_t CountLines(const Font *pFont, const int8_t *text, const TextParams &params)
+    size_t CountLines(const Font *pFont, const int8_t *text, const TextParams &params, WordWidthCache *pCache)
     {
-        const int8_t *p = text, *next;
-        size_t count = 0;
+        TextBreaks breaks;
+        ScanTextBreaks(text, breaks);
 
-        while (!AtStringEnding(p))
+        size_t i = 0, lineEnd, past,
+               count = 0;
+        while (i < breaks.length)
         {
             count++;
 
-            NextLineWidth(pFont, p, params.maxWidth, next);
+            NextLineWidth(pFont, text, breaks, pCache, params.maxWidth, i, lineEnd);
 
-            p = next;
+            i = lineEnd;
 
-            // See what character ended the line.
-            if (AtStringEnding(p))
+            // See what ended the line.
+            if (i >= breaks.length)
                 break;
 
-            else if (AtLineEnding(p, next))
-                p = next;
+            else if (AtLineEnding(text, breaks, i, past))
+                i = past;
 
             // Otherwise it was just a whitespace.
         }
@@ -297,6 +444,451 @@ namespace TextGL
         return count;
     }
 
+    Fixed26_6 ToFixed26_6(const double d)
+    {
+        // Widths like FLT_MAX, meaning no limit, must stay the largest.
+        double scaled = d * 64;
+        if (scaled >= INT32_MAX)
+            return INT32_MAX;
+        else if (scaled <= INT32_MIN)
+            return INT32_MIN;
+
+        return (Fixed26_6)lround(scaled);
+    }
+
+    double FromFixed26_6(const Fixed26_6 f)
+    {
+        return f / 64.0;
+    }
+
+    bool IsSpace(const UTF8Char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    bool IsLineBreak(const UTF8Char c)
+    {
+        return c == '\n' || c == '\r';
+    }
+
+    /**
+     *  Sums up glyphs first to end, where the first glyph's kerning doesn't count.
+     */
+    template <typename Number>
+    Number SumShapedWidth(const std::vector<ShapedGlyph> &glyphs, const size_t first, const size_t end,
+                          Number ShapedGlyph::*advance, Number ShapedGlyph::*kern)
+    {
+        Number w = 0;
+        bool hasGlyphs = false;
+        for (size_t i = first; i < end; i++)
+        {
+            if (hasGlyphs)
+                w += glyphs[i].*kern;
+
+            w += glyphs[i].*advance;
+
+            hasGlyphs = hasGlyphs || glyphs[i].hasGlyph;
+        }
+        return w;
+    }
+
+    void ShapeText(const Font *pFont, const int8_t *text, ShapedRun &run, const bool fixedPoint)
+    {
+        run.pFont = pFont;
+        run.fixedPoint = fixedPoint;
+        run.glyphs.clear();
+        run.words.clear();
+
+        const int8_t *p = text;
+        UTF8Char c, cPrev = 0;
+        while (*p)
+        {
+            ShapedGlyph glyph;
+            glyph.offset = p - text;
+
+            p = NextChar(p, c);
+
+            // Characters without glyph are left out, so kern with the last one that has a glyph.
+            glyph.c = c;
+            glyph.hasGlyph = pFont->FindGlyphMetrics(c) != NULL;
+            glyph.advance = GetAdvance(pFont, c);
+            glyph.kern = (glyph.hasGlyph && cPrev != 0) ? pFont->GetHorizontalKern(cPrev, c) : 0.0f;
+
+            // Round once here, so that layout only needs to add integers.
+            glyph.fixedAdvance = ToFixed26_6(glyph.advance);
+            glyph.fixedKern = ToFixed26_6(glyph.kern);
+
+            run.glyphs.push_back(glyph);
+            if (glyph.hasGlyph)
+                cPrev = c;
+        }
+
+        // Split up in words, the same way NextWordWidth does.
+        const std::vector<ShapedGlyph> &glyphs = run.glyphs;
+        size_t i = 0, n = glyphs.size();
+        while (i < n)
+        {
+            ShapedWord word;
+            word.start = i;
+
+            while (i < n && IsSpace(glyphs[i].c))
+                i++;
+            word.wordStart = i;
+
+            if (i >= n || IsLineBreak(glyphs[i].c))
+            {
+                // Don't count "  \n" as a word.
+                word.end = i;
+                word.width = word.trimmedWidth = 0.0f;
+                word.fixedWidth = word.fixedTrimmedWidth = 0;
+                word.endsLine = true;
+            }
+            else
+            {
+                while (i < n && !IsSpace(glyphs[i].c) && !IsLineBreak(glyphs[i].c))
+                    i++;
+
+                word.end = i;
+                word.width = SumShapedWidth(glyphs, word.start, word.end, &ShapedGlyph::advance, &ShapedGlyph::kern);
+                word.trimmedWidth = SumShapedWidth(glyphs, word.wordStart, word.end, &ShapedGlyph::advance, &ShapedGlyph::kern);
+                word.fixedWidth = SumShapedWidth(glyphs, word.start, word.end, &ShapedGlyph::fixedAdvance, &ShapedGlyph::fixedKern);
+                word.fixedTrimmedWidth = SumShapedWidth(glyphs, word.wordStart, word.end, &ShapedGlyph::fixedAdvance, &ShapedGlyph::fixedKern);
+                word.endsLine = i >= n || IsLineBreak(glyphs[i].c);
+            }
+            run.words.push_back(word);
+
+            // Past the line ending.
+            if (i < n && IsLineBreak(glyphs[i].c))
+            {
+                if (glyphs[i].c == '\r' && (i + 1) < n && glyphs[i + 1].c == '\n')
+                    i += 2;
+                else
+                    i++;
+            }
+        }
+    }
+
+    /**
+     *  Fits words on a line, starting from 'firstWord', the way NextLineWidth does.
+     *  Sets the range of glyphs on the line and returns the index of the next line's first word.
+     */
+    template <typename Number>
+    size_t FitWords(const ShapedRun &run, const size_t firstWord, const Number maxLineWidth,
+                    Number ShapedWord::*width, Number ShapedWord::*trimmedWidth,
+                    Number &lineWidth, size_t &lineStart, size_t &lineEnd)
+    {
+        Number wordWidth;
+        size_t w;
+
+        lineWidth = 0;
+        lineStart = run.words[firstWord].wordStart;
+        for (w = firstWord; w < run.words.size(); w++)
+        {
+            const ShapedWord &word = run.words[w];
+
+            wordWidth = w == firstWord ? word.*trimmedWidth : word.*width;
+            if (wordWidth > maxLineWidth)
+                throw TextFormatError("Word at character %u doesn't fit in line width %f",
+                                      (unsigned int)word.wordStart, (double)maxLineWidth);
+            else if ((lineWidth + wordWidth) > maxLineWidth)
+            {
+                lineEnd = word.start;
+                return w;
+            }
+
+            lineWidth += wordWidth;
+
+            if (word.endsLine)
+            {
+                lineEnd = word.end;
+                return w + 1;
+            }
+        }
+
+        // Not reached, the last word always ends the line.
+        lineEnd = run.glyphs.size();
+        return w;
+    }
+
+    /**
+     *  Sets the line width in both representations, but only calculates in the run's own.
+     */
+    size_t FitShapedLine(const ShapedRun &run, const size_t firstWord, const TextParams &params,
+                         GLfloat &lineWidth, Fixed26_6 &fixedLineWidth,
+                         size_t &lineStart, size_t &lineEnd)
+    {
+        size_t next;
+        if (run.fixedPoint)
+        {
+            next = FitWords(run, firstWord, ToFixed26_6(params.maxWidth),
+                            &ShapedWord::fixedWidth, &ShapedWord::fixedTrimmedWidth,
+                            fixedLineWidth, lineStart, lineEnd);
+            lineWidth = FromFixed26_6(fixedLineWidth);
+        }
+        else
+        {
+            next = FitWords(run, firstWord, params.maxWidth,
+                            &ShapedWord::width, &ShapedWord::trimmedWidth,
+                            lineWidth, lineStart, lineEnd);
+            fixedLineWidth = ToFixed26_6(lineWidth);
+        }
+        return next;
+    }
+
+    template <typename Number>
+    Number GetAlignedStartX(const TextAlign align, const Number startX, const Number lineWidth)
+    {
+        if (align == TEXTALIGN_CENTER)
+            return startX - lineWidth / 2;
+
+        else if (align == TEXTALIGN_RIGHT)
+            return startX - lineWidth;
+
+        else  // default TEXTALIGN_LEFT
+            return startX;
+    }
+
+    void GLTextLeftToRightIterator::IterateText(const GLTextureFont *pFont, const ShapedRun &run, const TextParams &params)
+    {
+        GlyphQuad quad;
+        TextSelectionDetails glyphSelection, lineSelection;
+        GLfloat x, y = params.startY, x0,
+                lineWidth;
+        Fixed26_6 fixedX, fixedY = ToFixed26_6(params.startY),
+                  fixedLineWidth;
+        size_t w = 0, i, lineStart, lineEnd;
+        const GLTextureGlyph *pGlyph;
+        bool lineHasGlyphs;
+
+        while (w < run.words.size())
+        {
+            w = FitShapedLine(run, w, params, lineWidth, fixedLineWidth, lineStart, lineEnd);
+            if (run.fixedPoint)
+            {
+                fixedX = GetAlignedStartX(params.align, ToFixed26_6(params.startX), fixedLineWidth);
+                x = FromFixed26_6(fixedX);
+                y = FromFixed26_6(fixedY);
+            }
+            else
+                x = GetAlignedStartX(params.align, params.startX, lineWidth);
+
+            SetTextSelection(pFont,
+                             lineStart, lineEnd,
+                             x, x + lineWidth, y, lineSelection);
+            OnLine(lineSelection);
+
+            lineHasGlyphs = false;
+            for (i = lineStart; i < lineEnd; i++)
+            {
+                const ShapedGlyph &glyph = run.glyphs[i];
+
+                pGlyph = pFont->FindGlyph(glyph.c);
+                if (pGlyph == NULL)  // Leave the character out.
+                    continue;
+
+                x0 = x;
+
+                if (run.fixedPoint)
+                {
+                    if (lineHasGlyphs)
+                        fixedX += glyph.fixedKern;
+
+                    SetGlyphQuad(pFont, pGlyph, FromFixed26_6(fixedX), y, quad);
+
+                    fixedX += glyph.fixedAdvance;
+                    x = FromFixed26_6(fixedX);
+                }
+                else
+                {
+                    if (lineHasGlyphs)
+                        x += glyph.kern;
+
+                    SetGlyphQuad(pFont, pGlyph, x, y, quad);
+
+                    x += glyph.advance;
+                }
+
+                SetTextSelection(pFont,
+                                 i, i + 1,
+                                 x0, x, y, glyphSelection);
+                OnGlyph(glyph.c, quad, glyphSelection);
+
+                lineHasGlyphs = true;
+            }
+
+            fixedY -= ToFixed26_6(params.lineSpacing);
+            y -= params.lineSpacing;
+        }
+    }
+
+    size_t CountLines(const ShapedRun &run, const TextParams &params)
+    {
+        GLfloat lineWidth;
+        Fixed26_6 fixedLineWidth;
+        size_t w = 0, lineStart, lineEnd,
+               count = 0;
+
+        while (w < run.words.size())
+        {
+            w = FitShapedLine(run, w, params, lineWidth, fixedLineWidth, lineStart, lineEnd);
+            count++;
+        }
+
+        return count;
+    }
+
+    GLfloat GetTextWidth(const ShapedRun &run, const TextParams &params)
+    {
+        GLfloat lineWidth, maxLineWidth = 0.0f;
+        Fixed26_6 fixedLineWidth;
+        size_t w = 0, lineStart, lineEnd;
+
+        while (w < run.words.size())
+        {
+            w = FitShapedLine(run, w, params, lineWidth, fixedLineWidth, lineStart, lineEnd);
+            maxLineWidth = std::max(maxLineWidth, lineWidth);
+        }
+
+        return maxLineWidth;
+    }
+
+    size_t HitTestText(const ShapedRun &run, const TextParams &params, const GLfloat x, const GLfloat y)
+    {
+        GLfloat lineWidth = 0.0f, lineX,
+                lineTopY = params.startY + run.pFont->GetMetrics()->ascent;
+        Fixed26_6 fixedLineWidth = 0, fixedLineX;
+        size_t w = 0, i, lineStart = 0, lineEnd = 0;
+
+        // Find the line, the last one if the point is below the text.
+        while (w < run.words.size())
+        {
+            w = FitShapedLine(run, w, params, lineWidth, fixedLineWidth, lineStart, lineEnd);
+            if (y > (lineTopY - params.lineSpacing))
+                break;
+
+            lineTopY -= params.lineSpacing;
+        }
+
+        // Find the glyph on the line.
+        bool lineHasGlyphs = false;
+        if (run.fixedPoint)
+        {
+            fixedLineX = GetAlignedStartX(params.align, ToFixed26_6(params.startX), fixedLineWidth);
+            for (i = lineStart; i < lineEnd; i++)
+            {
+                fixedLineX += (lineHasGlyphs ? run.glyphs[i].fixedKern : 0) + run.glyphs[i].fixedAdvance;
+                if (x < FromFixed26_6(fixedLineX))
+                    return i;
+
+                lineHasGlyphs = lineHasGlyphs || run.glyphs[i].hasGlyph;
+            }
+        }
+        else
+        {
+            lineX = GetAlignedStartX(params.align, params.startX, lineWidth);
+            for (i = lineStart; i < lineEnd; i++)
+            {
+                lineX += (lineHasGlyphs ? run.glyphs[i].kern : 0.0f) + run.glyphs[i].advance;
+                if (x < lineX)
+                    return i;
+
+                lineHasGlyphs = lineHasGlyphs || run.glyphs[i].hasGlyph;
+            }
+        }
+
+        return lineEnd;
+    }
+
+    /**
+     *  FNV-1a over the word's bytes, mixed with the font pointer.
+     */
+    uint64_t HashWord(const Font *pFont, const int8_t *p, const int8_t *end)
+    {
+        uint64_t h = 0xcbf29ce484222325;
+        for (; p < end; p++)
+        {
+            h ^= (uint8_t)*p;
+            h *= 0x100000001b3;
+        }
+
+        return h ^ ((uintptr_t)pFont * 0x9e3779b97f4a7c15);
+    }
+
+    WordWidthCache::WordWidthCache(const size_t capacity): mCapacity(capacity), mHits(0), mMisses(0)
+    {
+    }
+    bool WordWidthCache::Find(const Font *pFont, const int8_t *start, const int8_t *end, GLfloat &width)
+    {
+        uint64_t hash = HashWord(pFont, start, end);
+        size_t length = end - start;
+
+        auto range = mIndex.equal_range(hash);
+        for (auto it = range.first; it != range.second; it++)
+        {
+            std::list<Entry>::iterator pEntry = it->second;
+            if (pEntry->pFont == pFont && pEntry->word.size() == length
+                    && memcmp(pEntry->word.data(), start, length) == 0)
+            {
+                // Move to the front, it's now the most recently used.
+                mEntries.splice(mEntries.begin(), mEntries, pEntry);
+
+                width = pEntry->width;
+                mHits++;
+                return true;
+            }
+        }
+
+        mMisses++;
+        return false;
+    }
+    void WordWidthCache::Insert(const Font *pFont, const int8_t *start, const int8_t *end, const GLfloat width)
+    {
+        if (mCapacity == 0)
+            return;
+
+        while (mEntries.size() >= mCapacity)
+        {
+            std::list<Entry>::iterator pLast = std::prev(mEntries.end());
+
+            auto range = mIndex.equal_range(pLast->hash);
+            for (auto it = range.first; it != range.second; it++)
+            {
+                if (it->second == pLast)
+                {
+                    mIndex.erase(it);
+                    break;
+                }
+            }
+
+            mEntries.erase(pLast);
+        }
+
+        uint64_t hash = HashWord(pFont, start, end);
+        mEntries.push_front({pFont, hash, std::string((const char *)start, end - start), width});
+        mIndex.emplace(hash, mEntries.begin());
+    }
+    void WordWidthCache::Clear(void)
+    {
+        mIndex.clear();
+        mEntries.clear();
+    }
+    size_t WordWidthCache::GetSize(void) const
+    {
+        return mEntries.size();
+    }
+    size_t WordWidthCache::GetHitCount(void) const
+    {
+        return mHits;
+    }
+    size_t WordWidthCache::GetMissCount(void) const
+    {
+        return mMisses;
+    }
+    void WordWidthCache::ResetCounts(void)
+    {
+        mHits = mMisses = 0;
+    }
+
     GLfloat GetLineHeight(const GLTextureFont *pFont)
     {
         const FontMetrics *pMetrics = pFont->GetMetrics();
@@ -75,6 +75,41 @@ namespace TextGL
         // Move to the next utf-8 character pointer.
         return bytes + nBytes;
     }
+    const int8_t *NextUTF8Char(const int8_t *bytes, UTF8Char &ch, bool &valid,
+                               const UTF8Char replacement) noexcept
+    {
+        size_t nBytes = CountSuccessiveLeftBits(bytes[0]),
+               i;
+
+        ch = 0x000000ff & bytes[0];
+        valid = true;
+
+        if (nBytes == 0)
+            return bytes + 1;
+
+        // A lone 10?????? byte or a too long sequence.
+        if (nBytes == 1 || nBytes > 4)
+        {
+            valid = false;
+            ch = replacement;
+            return bytes + 1;
+        }
+
+        for (i = 1; i < nBytes; i++)
+        {
+            // Also stops at the terminating NULL.
+            if ((bytes[i] & 0b11000000) != 0b10000000)
+            {
+                valid = false;
+                ch = replacement;
+                return bytes + 1;
+            }
+
+            ch = (ch << 8) | 0x000000ff & bytes[i];
+        }
+
+        return bytes + nBytes;
+    }
     const int8_t *PrevUTF8Char(const int8_t *bytes, UTF8Char &ch)
     {
         size_t nBytes = 0,
@@ -115,6 +150,39 @@ namespace TextGL
         }
         return bytes;
     }
+    UTF8Char CodePointToUTF8Char(const uint32_t codePoint)
+    {
+        if (codePoint < 0x80)
+            return codePoint;
+        else if (codePoint < 0x800)
+            return (0xc0 | (codePoint >> 6)) << 8
+                 | (0x80 | (codePoint & 0x3f));
+        else if (codePoint < 0x10000)
+            return (0xe0 | (codePoint >> 12)) << 16
+                 | (0x80 | ((codePoint >> 6) & 0x3f)) << 8
+                 | (0x80 | (codePoint & 0x3f));
+        else if (codePoint < 0x110000)
+            return (0xf0 | (codePoint >> 18)) << 24
+                 | (0x80 | ((codePoint >> 12) & 0x3f)) << 16
+                 | (0x80 | ((codePoint >> 6) & 0x3f)) << 8
+                 | (0x80 | (codePoint & 0x3f));
+        else
+            throw EncodingError("code point 0x%x is out of unicode range", codePoint);
+    }
+    void AddCharacters(const int8_t *text, CharacterSet &characters)
+    {
+        UTF8Char c;
+        while (*text)
+        {
+            text = NextUTF8Char(text, c);
+            characters.insert(c);
+        }
+    }
+    void AddCharacterRange(const uint32_t first, const uint32_t last, CharacterSet &characters)
+    {
+        for (uint32_t codePoint = first; codePoint <= last; codePoint++)
+            characters.insert(CodePointToUTF8Char(codePoint));
+    }
     size_t CountCharsUTF8(const int8_t *bytes, const int8_t *end)
     {
         size_t n = 0;
@@ -0,0 +1,413 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestAtlas
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include <unordered_set>
+
+#include <text-gl/bundle.h>
+
+#include "style.h"
+
+
+using namespace TextGL;
+
+/**
+ *  Checks that every glyph's image is in the atlas, padded and not overlapping any other.
+ */
+void CheckAtlas(const FontData &fontData, const ImageFont *pFont, const GlyphAtlas *pAtlas, const AtlasParams &params)
+{
+    std::vector<UTF8Char> characters;
+    for (const auto &pair : fontData.mGlyphs)
+        characters.push_back(pair.first);
+
+    std::unordered_set<const AtlasRect *> rects;
+    for (const UTF8Char c : characters)
+    {
+        const AtlasRect *pRect = pAtlas->GetRect(c);
+        const Image *pGlyphImage = pFont->GetGlyph(c)->GetImage();
+
+        size_t w, h;
+        pGlyphImage->GetDimensions(w, h);
+        const uint32_t *glyphPixels = (const uint32_t *)pGlyphImage->GetData();
+
+        if (!params.trim)
+        {
+            BOOST_CHECK_EQUAL(pRect->width, w);
+            BOOST_CHECK_EQUAL(pRect->height, h);
+        }
+        if (pRect->width == 0)
+        {
+            for (size_t i = 0; i < w * h; i++)
+                BOOST_REQUIRE_EQUAL(glyphPixels[i], 0);
+            continue;
+        }
+        rects.insert(pRect);
+
+        BOOST_REQUIRE(pRect->image < pAtlas->GetImageCount());
+        size_t atlasWidth, atlasHeight;
+        pAtlas->GetImage(pRect->image)->GetDimensions(atlasWidth, atlasHeight);
+        const uint32_t *atlasPixels = (const uint32_t *)pAtlas->GetImage(pRect->image)->GetData();
+
+        BOOST_REQUIRE(pRect->x >= params.padding && pRect->x + pRect->width + params.padding <= atlasWidth);
+        BOOST_REQUIRE(pRect->y >= params.padding && pRect->y + pRect->height + params.padding <= atlasHeight);
+        BOOST_CHECK_CLOSE(pRect->u0 * atlasWidth, pRect->x, 0.01);
+        BOOST_CHECK_CLOSE(pRect->v1 * atlasHeight, pRect->y + pRect->height, 0.01);
+
+        // Only transparent pixels may be left out.
+        for (size_t y = 0; y < h; y++)
+        {
+            for (size_t x = 0; x < w; x++)
+            {
+                uint32_t pixel = glyphPixels[y * w + x];
+                if (x >= pRect->offsetX && x < pRect->offsetX + pRect->width &&
+                        y >= pRect->offsetY && y < pRect->offsetY + pRect->height)
+                    BOOST_REQUIRE_EQUAL(atlasPixels[(pRect->y + y - pRect->offsetY) * atlasWidth + pRect->x + x - pRect->offsetX], pixel);
+                else
+                    BOOST_REQUIRE_EQUAL(pixel, 0);
+            }
+        }
+    }
+
+    for (const AtlasRect *pRect1 : rects)
+    {
+        for (const AtlasRect *pRect2 : rects)
+        {
+            if (pRect1 == pRect2 || pRect1->image != pRect2->image)
+                continue;
+
+            BOOST_REQUIRE(pRect1->x + pRect1->width + params.padding <= pRect2->x ||
+                          pRect2->x + pRect2->width + params.padding <= pRect1->x ||
+                          pRect1->y + pRect1->height + params.padding <= pRect2->y ||
+                          pRect2->y + pRect2->height + params.padding <= pRect1->y);
+        }
+    }
+
+    GlyphAtlasStats stats = pAtlas->GetStats();
+    BOOST_CHECK_EQUAL(stats.imageCount, pAtlas->GetImageCount());
+    BOOST_CHECK(stats.glyphCount >= rects.size());
+    BOOST_CHECK(stats.glyphPixels < stats.atlasPixels);
+}
+
+BOOST_AUTO_TEST_CASE(atlas_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    FontStyle style = MakeFillStyle(32.0);
+    ImageFont *pFont = MakeImageFont(fontData, style),
+              *pLazyFont = MakeLazyImageFont(fontData, style);
+
+    AtlasParams params;
+    params.padding = 2;
+    for (const ImageFont *pImageFont : {pFont, pLazyFont})
+    {
+        GlyphAtlas *pAtlas = MakeGlyphAtlas(pImageFont, params);
+
+        BOOST_CHECK_EQUAL(pAtlas->GetImageCount(), 1);
+        CheckAtlas(fontData, pImageFont, pAtlas, params);
+
+        // Trimming should pack the glyphs tightly.
+        GlyphAtlasStats stats = pAtlas->GetStats();
+        BOOST_CHECK(stats.glyphPixels > stats.atlasPixels / 2);
+
+        // The missing glyph stands in for characters that have none.
+        BOOST_CHECK(pAtlas->FindRect(0x10FFFF) != NULL);
+        BOOST_CHECK_THROW(pAtlas->GetRect(0x10FFFF), MissingGlyphError);
+
+        DestroyGlyphAtlas(pAtlas);
+    }
+
+    params.trim = false;
+    GlyphAtlas *pAtlas = MakeGlyphAtlas(pFont, params);
+    CheckAtlas(fontData, pFont, pAtlas, params);
+    DestroyGlyphAtlas(pAtlas);
+
+    DestroyImageFont(pFont);
+    DestroyImageFont(pLazyFont);
+}
+
+BOOST_AUTO_TEST_CASE(pages_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    ImageFont *pFont = MakeImageFont(fontData, MakeFillStyle(32.0));
+
+    AtlasParams params;
+    params.maxWidth = 128;
+    params.maxHeight = 128;
+    GlyphAtlas *pAtlas = MakeGlyphAtlas(pFont, params);
+
+    BOOST_CHECK(pAtlas->GetImageCount() > 1);
+    for (size_t i = 0; i < pAtlas->GetImageCount(); i++)
+    {
+        size_t w, h;
+        pAtlas->GetImage(i)->GetDimensions(w, h);
+        BOOST_CHECK(w <= params.maxWidth && h <= params.maxHeight);
+    }
+    CheckAtlas(fontData, pFont, pAtlas, params);
+    DestroyGlyphAtlas(pAtlas);
+
+    // A glyph that doesn't fit at all.
+    params.maxWidth = 8;
+    BOOST_CHECK_THROW(MakeGlyphAtlas(pFont, params), FontImageError);
+
+    DestroyImageFont(pFont);
+}
+
+/**
+ *  Stands in for the textures: only gets the dirty rectangles.
+ */
+void CopyDirtyRects(const DynamicGlyphAtlas &atlas, const std::vector<AtlasDirtyRect> &dirtyRects,
+                    std::vector<std::vector<uint32_t>> &textures)
+{
+    for (const AtlasDirtyRect &dirty : dirtyRects)
+    {
+        size_t w, h;
+        atlas.GetImage(dirty.image)->GetDimensions(w, h);
+        BOOST_REQUIRE(dirty.x + dirty.width <= w && dirty.y + dirty.height <= h);
+
+        if (textures.size() <= dirty.image)
+            textures.resize(dirty.image + 1, std::vector<uint32_t>(w * h, 0xdeadbeef));
+
+        const uint32_t *pixels = (const uint32_t *)atlas.GetImage(dirty.image)->GetData();
+        for (size_t y = dirty.y; y < dirty.y + dirty.height; y++)
+            std::copy(pixels + y * w + dirty.x, pixels + y * w + dirty.x + dirty.width, textures[dirty.image].data() + y * w + dirty.x);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(dynamic_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    ImageFont *pFont = MakeLazyImageFont(fontData, MakeFillStyle(16.0), 64 * 1024);
+
+    std::vector<UTF8Char> characters;
+    for (const auto &pair : fontData.mGlyphs)
+        characters.push_back(pair.first);
+    characters.push_back(0x10FFFF);  // gets the missing glyph
+
+    DynamicAtlasParams params;
+    params.width = 128;
+    params.height = 128;
+    params.maxImageCount = 2;
+    params.padding = 2;
+    DynamicGlyphAtlas atlas(pFont, params);
+
+    // Each frame shows a window of characters, that moves along.
+    std::vector<std::vector<uint32_t>> textures;
+    const size_t windowSize = 40;
+    for (size_t start = 0; start < characters.size(); start += windowSize / 4)
+    {
+        std::vector<const AtlasRect *> rects;
+        for (size_t i = start; i < std::min(start + windowSize, characters.size()); i++)
+            rects.push_back(atlas.FindRect(characters[i]));
+
+        CopyDirtyRects(atlas, atlas.TakeDirtyRects(), textures);
+        BOOST_REQUIRE_EQUAL(textures.size(), atlas.GetImageCount());
+
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            size_t w, h;
+            atlas.GetImage(i)->GetDimensions(w, h);
+            BOOST_REQUIRE(memcmp(textures[i].data(), atlas.GetImage(i)->GetData(), w * h * sizeof(uint32_t)) == 0);
+        }
+
+        for (size_t i = 0; i < rects.size(); i++)
+        {
+            const AtlasRect *pRect = rects[i];
+            const Image *pGlyphImage = pFont->FindGlyph(characters[start + i])->GetImage();
+
+            size_t w, h, atlasWidth, atlasHeight;
+            pGlyphImage->GetDimensions(w, h);
+            const uint32_t *glyphPixels = (const uint32_t *)pGlyphImage->GetData();
+
+            if (pRect->width == 0)
+                continue;
+
+            atlas.GetImage(pRect->image)->GetDimensions(atlasWidth, atlasHeight);
+            const uint32_t *texturePixels = textures[pRect->image].data();
+            for (size_t y = 0; y < pRect->height; y++)
+                for (size_t x = 0; x < pRect->width; x++)
+                    BOOST_REQUIRE_EQUAL(texturePixels[(pRect->y + y) * atlasWidth + pRect->x + x],
+                                        glyphPixels[(pRect->offsetY + y) * w + pRect->offsetX + x]);
+
+            // Nothing else within the padding.
+            for (size_t y = pRect->y - params.padding; y < pRect->y + pRect->height + params.padding; y++)
+                for (size_t x = pRect->x - params.padding; x < pRect->x + pRect->width + params.padding; x++)
+                    if (x < pRect->x || y < pRect->y || x >= pRect->x + pRect->width || y >= pRect->y + pRect->height)
+                        BOOST_REQUIRE_EQUAL(texturePixels[y * atlasWidth + x], 0);
+        }
+
+        pFont->FreeEvictedGlyphs();
+        atlas.NextFrame();
+    }
+
+    DynamicAtlasStats stats = atlas.GetStats();
+    BOOST_CHECK(stats.hits > 0);
+    BOOST_CHECK(stats.evictions > 0);
+    BOOST_CHECK_EQUAL(stats.imageCount, 2);
+
+    // The same characters again, in one frame, only ask for a few small changes.
+    atlas.NextFrame();
+    for (size_t i = 0; i < 10; i++)
+        atlas.FindRect(characters[i]);
+    for (size_t i = 0; i < 10; i++)
+        atlas.FindRect(characters[i]);
+    for (const AtlasDirtyRect &dirty : atlas.TakeDirtyRects())
+        BOOST_CHECK(dirty.width < params.width || dirty.height < params.height);
+    BOOST_CHECK(atlas.TakeDirtyRects().empty());
+
+    DestroyImageFont(pFont);
+}
+
+BOOST_AUTO_TEST_CASE(dynamic_full_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    ImageFont *pFont = MakeImageFont(fontData, MakeFillStyle(32.0));
+
+    DynamicAtlasParams params;
+    params.width = 128;
+    params.height = 128;
+    DynamicGlyphAtlas atlas(pFont, params);
+
+    // All glyphs in one frame can't fit, nothing may be evicted.
+    BOOST_CHECK_THROW(
+        for (const auto &pair : fontData.mGlyphs)
+            atlas.FindRect(pair.first),
+        FontImageError);
+    BOOST_CHECK_EQUAL(atlas.GetStats().evictions, 0);
+
+    // In the next frame, those glyphs can go.
+    atlas.NextFrame();
+    for (const auto &pair : fontData.mGlyphs)
+    {
+        atlas.FindRect(pair.first);
+        atlas.NextFrame();
+    }
+    BOOST_CHECK(atlas.GetStats().evictions > 0);
+
+    DestroyImageFont(pFont);
+}
+
+void CheckEqualRects(const AtlasRect &rect1, const AtlasRect &rect2)
+{
+    BOOST_CHECK_EQUAL(rect1.image, rect2.image);
+    BOOST_CHECK_EQUAL(rect1.x, rect2.x);
+    BOOST_CHECK_EQUAL(rect1.y, rect2.y);
+    BOOST_CHECK_EQUAL(rect1.width, rect2.width);
+    BOOST_CHECK_EQUAL(rect1.height, rect2.height);
+    BOOST_CHECK_EQUAL(rect1.offsetX, rect2.offsetX);
+    BOOST_CHECK_EQUAL(rect1.offsetY, rect2.offsetY);
+    BOOST_CHECK_EQUAL(rect1.imageWidth, rect2.imageWidth);
+    BOOST_CHECK_EQUAL(rect1.imageHeight, rect2.imageHeight);
+    BOOST_CHECK_EQUAL(rect1.u0, rect2.u0);
+    BOOST_CHECK_EQUAL(rect1.v1, rect2.v1);
+}
+
+BOOST_AUTO_TEST_CASE(bundle_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    ImageFont *pFont = MakeImageFont(fontData, MakeFillStyle(32.0));
+
+    FontBundle bundle;
+    MakeFontBundle(pFont, bundle);
+
+    std::ostringstream os;
+    WriteFontBundle(os, bundle);
+    std::string data = os.str();
+
+    FontBundle read;
+    ReadFontBundle(data.data(), data.size(), read);
+
+    BOOST_CHECK_EQUAL(read.mStyle.size, 32.0);
+    BOOST_CHECK_EQUAL(read.mStyle.rasterizer, RASTERIZER_NATIVE);
+    BOOST_CHECK_EQUAL(read.mMetrics.ascent, pFont->GetMetrics()->ascent);
+    BOOST_CHECK_EQUAL(read.mMetrics.bbox.left, pFont->GetMetrics()->bbox.left);
+
+    // The glyphs are in the atlas, as they were rendered.
+    BOOST_REQUIRE_EQUAL(read.mGlyphs.size(), fontData.mGlyphs.size());
+    for (const auto &pair : fontData.mGlyphs)
+    {
+        const FontBundleGlyph &glyph = read.mGlyphs.at(pair.first);
+        CheckEqualRects(glyph.mRect, bundle.mGlyphs.at(pair.first).mRect);
+        BOOST_CHECK_EQUAL(glyph.mMetrics.advanceX, pFont->GetGlyphMetrics(pair.first)->advanceX);
+
+        const Image *pImage = pFont->GetGlyph(pair.first)->GetImage();
+        size_t w, h;
+        pImage->GetDimensions(w, h);
+        BOOST_REQUIRE_EQUAL(glyph.mRect.imageWidth, w);
+        BOOST_REQUIRE_EQUAL(glyph.mRect.imageHeight, h);
+
+        const uint32_t *glyphPixels = (const uint32_t *)pImage->GetData();
+        for (size_t y = 0; y < glyph.mRect.height; y++)
+        {
+            const FontBundleImage &image = read.mImages[glyph.mRect.image];
+            BOOST_REQUIRE(memcmp(image.pixels.data() + (glyph.mRect.y + y) * image.width + glyph.mRect.x,
+                                 glyphPixels + (glyph.mRect.offsetY + y) * w + glyph.mRect.offsetX,
+                                 glyph.mRect.width * sizeof(uint32_t)) == 0);
+        }
+    }
+    BOOST_CHECK_EQUAL(read.mHasMissingGlyph, fontData.mHasMissingGlyph);
+    CheckEqualRects(read.mMissingGlyph.mRect, bundle.mMissingGlyph.mRect);
+
+    size_t nPairs = 0;
+    for (const auto &row : fontData.mHorizontalKernTable)
+    {
+        for (const auto &pair : row.second)
+        {
+            BOOST_CHECK_EQUAL(GetKernValue(read.mUnscaled->mHorizontalKernTable, row.first, pair.first) * read.mScale,
+                              pFont->GetHorizontalKern(row.first, pair.first));
+            nPairs++;
+        }
+    }
+    BOOST_CHECK(nPairs > 0);
+
+    // Writing it again gives the same data.
+    std::ostringstream osAgain;
+    WriteFontBundle(osAgain, read);
+    BOOST_CHECK(osAgain.str() == data);
+
+    for (size_t length : {(size_t)0, (size_t)10, data.size() / 2, data.size() - 1})
+        BOOST_CHECK_THROW(ReadFontBundle(data.data(), length, read), FontParseError);
+
+    data[0] = 'X';
+    BOOST_CHECK_THROW(ReadFontBundle(data.data(), data.size(), read), FontParseError);
+
+    DestroyImageFont(pFont);
+}
+
+BOOST_AUTO_TEST_CASE(bundle_subset_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    CharacterSet characters;
+    AddCharacters((const int8_t *)"AVATAR To", characters);
+
+    ImageFont *pFont = MakeImageFont(fontData, MakeFillStyle(16.0), &characters);
+
+    FontBundle bundle;
+    MakeFontBundle(pFont, bundle);
+
+    BOOST_CHECK(bundle.mGlyphs.size() <= characters.size());
+    for (const auto &row : bundle.mUnscaled->mHorizontalKernTable)
+    {
+        BOOST_CHECK(characters.count(row.first) == 1);
+        for (const auto &pair : row.second)
+            BOOST_CHECK(characters.count(pair.first) == 1);
+    }
+    BOOST_CHECK(GetKernValue(bundle.mUnscaled->mHorizontalKernTable, 'R', 'V') != 0.0);
+
+    DestroyImageFont(pFont);
+}
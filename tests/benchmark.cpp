@@ -0,0 +1,788 @@
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+#include <unordered_set>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <boost/format.hpp>
+
+#include <zlib.h>
+
+#include <text-gl/text.h>
+#include <text-gl/bundle.h>
+
+#include "style.h"
+
+using namespace TextGL;
+
+
+/**
+ *  returns the average time per call in milliseconds.
+ */
+double TimeRepeated(const size_t repeats, const std::function<void(void)> &f)
+{
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < repeats; i++)
+        f();
+
+    std::chrono::duration<double, std::milli> delta = std::chrono::steady_clock::now() - tStart;
+    return delta.count() / repeats;
+}
+
+/**
+ *  Counts every operator new in the program, including those in the library.
+ *  Allocations that cairo makes with malloc aren't counted.
+ */
+std::atomic<size_t> nAllocations(0);
+
+void *operator new(size_t size)
+{
+    nAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+long GetPeakRSSKB(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ *  returns 0 where /proc isn't available.
+ */
+long GetCurrentRSSKB(void)
+{
+    std::ifstream is("/proc/self/statm");
+    long size, resident;
+    if (!(is >> size >> resident))
+        return 0;
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void BenchmarkParse(const std::string &svg, const char *path)
+{
+    long rssBefore = GetPeakRSSKB();
+
+    double ms = TimeRepeated(20, [&svg]()
+    {
+        std::istringstream is(svg);
+        FontData fontData;
+        ParseSVGFontData(is, fontData);
+    });
+
+    std::cout << boost::format("ParseSVGFontData(istream): %1$.3f ms, peak RSS grew %2% KB") % ms % (GetPeakRSSKB() - rssBefore) << std::endl;
+
+    ms = TimeRepeated(20, [&svg]()
+    {
+        FontData fontData;
+        ParseSVGFontData(svg.data(), svg.size(), fontData);
+    });
+
+    std::cout << boost::format("ParseSVGFontData(memory): %1$.3f ms") % ms << std::endl;
+
+    ms = TimeRepeated(20, [path]()
+    {
+        FontData fontData;
+        ParseSVGFontFile(path, fontData);
+    });
+
+    std::cout << boost::format("ParseSVGFontFile: %1$.3f ms") % ms << std::endl;
+
+    ms = TimeRepeated(20, [&svg]()
+    {
+        FontParseParams params;
+        params.lazyPaths = true;
+
+        FontData fontData;
+        ParseSVGFontData(svg.data(), svg.size(), fontData, params);
+
+        // Draw a short text: only these paths get parsed.
+        for (const char c : std::string("Hello"))
+        {
+            auto it = fontData.mGlyphs.find(c);
+            if (it != fontData.mGlyphs.end())
+                GetGlyphPath(fontData, it->second);
+        }
+    });
+
+    std::cout << boost::format("ParseSVGFontData(memory, lazy) + 5 paths: %1$.3f ms") % ms << std::endl;
+
+    // Glyphs with the same outline share their path.
+    FontData fontData;
+    ParseSVGFontData(svg.data(), svg.size(), fontData);
+
+    std::unordered_set<uint32_t> distinctPaths;
+    for (const auto &pair : fontData.mGlyphs)
+        distinctPaths.insert(pair.second.mPath.firstCoord);
+
+    std::cout << boost::format("%1% glyphs, %2% distinct paths, %3% bytes of path store")
+                    % fontData.mGlyphs.size() % distinctPaths.size()
+                    % (fontData.mPathStore.mElementTypes.size() + fontData.mPathStore.mCoords.size() * sizeof(float)) << std::endl;
+}
+
+/**
+ *  Compares ParseDouble to strtod, on numbers like those in glyph paths.
+ */
+void BenchmarkNumbers(void)
+{
+    std::string numbers;
+    char buf[32];
+    for (int i = 0; i < 100000; i++)
+    {
+        snprintf(buf, sizeof(buf), "%.6g ", (i * 7919 % 200003 - 100000) / 97.0);
+        numbers += buf;
+    }
+    const char *start = numbers.c_str(),
+               *end = start + numbers.size();
+
+    double sum;
+    double ms = TimeRepeated(20, [start, end, &sum]()
+    {
+        sum = 0.0;
+        double d;
+        for (const char *p = start; (p = ParseDouble(p, end, d)); p++)
+            sum += d;
+    });
+
+    std::cout << boost::format("ParseDouble: %1$.3f ms per 100000 numbers") % ms << std::endl;
+
+    ms = TimeRepeated(20, [start, &sum]()
+    {
+        sum = 0.0;
+        char *p = (char *)start, *q;
+        for (;;)
+        {
+            double d = strtod(p, &q);
+            if (q == p)
+                break;
+            sum += d;
+            p = q;
+        }
+    });
+
+    std::cout << boost::format("strtod: %1$.3f ms per 100000 numbers") % ms << std::endl;
+}
+
+void BenchmarkBinary(const std::string &svg)
+{
+    FontData parsed;
+    ParseSVGFontData(svg.data(), svg.size(), parsed);
+
+    std::ostringstream os;
+    WriteBinaryFontData(os, parsed);
+    std::string binary = os.str();
+
+    double ms = TimeRepeated(20, [&binary]()
+    {
+        FontData fontData;
+        ReadBinaryFontData(binary.data(), binary.size(), fontData);
+    });
+
+    std::cout << boost::format("ReadBinaryFontData: %1$.3f ms, %2% bytes") % ms % binary.size() << std::endl;
+}
+
+
+std::string Gzip(const std::string &data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+    std::string compressed(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = (Bytef *)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *)&compressed[0];
+    stream.avail_out = compressed.size();
+    deflate(&stream, Z_FINISH);
+
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+void BenchmarkGzip(const std::string &svg)
+{
+    std::string svgz = Gzip(svg);
+
+    std::cout << boost::format("gzip: %1% bytes to %2% bytes") % svg.size() % svgz.size() << std::endl;
+
+    // Throughput in uncompressed megabytes per second.
+    double mb = svg.size() / 1.0e6;
+
+    double ms = TimeRepeated(20, [&svg]()
+    {
+        std::istringstream is(svg);
+        FontData fontData;
+        ParseSVGFontData(is, fontData);
+    });
+
+    std::cout << boost::format("ParseSVGFontData(istream, svg): %1$.3f ms, %2$.1f MB/s") % ms % (mb * 1000 / ms) << std::endl;
+
+    ms = TimeRepeated(20, [&svgz]()
+    {
+        std::istringstream is(svgz);
+        FontData fontData;
+        ParseSVGFontData(is, fontData);
+    });
+
+    std::cout << boost::format("ParseSVGFontData(istream, svgz): %1$.3f ms, %2$.1f MB/s") % ms % (mb * 1000 / ms) << std::endl;
+
+    ms = TimeRepeated(20, [&svg]()
+    {
+        FontData fontData;
+        ParseSVGFontData(svg.data(), svg.size(), fontData);
+    });
+
+    std::cout << boost::format("ParseSVGFontData(memory, svg): %1$.3f ms, %2$.1f MB/s") % ms % (mb * 1000 / ms) << std::endl;
+
+    ms = TimeRepeated(20, [&svgz]()
+    {
+        FontData fontData;
+        ParseSVGFontData(svgz.data(), svgz.size(), fontData);
+    });
+
+    std::cout << boost::format("ParseSVGFontData(memory, svgz): %1$.3f ms, %2$.1f MB/s") % ms % (mb * 1000 / ms) << std::endl;
+}
+
+void BenchmarkRaster(const std::string &svg)
+{
+    FontData fontData;
+    ParseSVGFontData(svg.data(), svg.size(), fontData);
+
+    // Fill only, so that the native rasterizer is used for every glyph.
+    FontStyle style = MakeFillStyle(32.0);
+
+    double scale = style.size / fontData.mMetrics.unitsPerEM;
+    const FontBoundingBox &bbox = fontData.mMetrics.bbox;
+    size_t w = ceil((bbox.right - bbox.left) * scale),
+           h = ceil((bbox.top - bbox.bottom) * scale);
+    std::vector<uint8_t> coverage(w * h);
+
+    double ms = TimeRepeated(20, [&]()
+    {
+        for (const auto &pair : fontData.mGlyphs)
+            RasterizePathCoverage(GetGlyphPath(fontData, pair.second), scale, -bbox.left * scale, -bbox.bottom * scale,
+                                  w, h, coverage.data(), w);
+    });
+
+    std::cout << boost::format("RasterizePathCoverage: %1$.2f us per %2%x%3% glyph")
+                    % (ms * 1000 / fontData.mGlyphs.size()) % w % h << std::endl;
+
+    for (GlyphRasterizer rasterizer : {RASTERIZER_CAIRO, RASTERIZER_NATIVE})
+    {
+        style.rasterizer = rasterizer;
+
+        ms = TimeRepeated(5, [&fontData, &style]()
+        {
+            DestroyImageFont(MakeImageFont(fontData, style));
+        });
+
+        size_t nBefore = nAllocations;
+        DestroyImageFont(MakeImageFont(fontData, style));
+        size_t nFontAllocations = nAllocations - nBefore;
+
+        std::cout << boost::format("MakeImageFont(%1%): %2$.3f ms, %3$.2f us and %4$.2f allocations per glyph")
+                        % (rasterizer == RASTERIZER_CAIRO ? "cairo" : "native") % ms
+                        % (ms * 1000 / fontData.mGlyphs.size())
+                        % ((double)nFontAllocations / fontData.mGlyphs.size()) << std::endl;
+    }
+}
+
+/**
+ *  Makes a font the size of a CJK font out of the paths in the given one:
+ *  nGlyphs glyphs from U+4E00 on, each kerned with the next.
+ */
+/**
+ *  1, 2, 4 .. threads, up to the number of cores.
+ */
+std::vector<unsigned int> GetThreadCounts(void)
+{
+    unsigned int nCores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int n = 1; n < nCores; n *= 2)
+        threadCounts.push_back(n);
+    threadCounts.push_back(nCores);
+    return threadCounts;
+}
+
+void BenchmarkLazyFont(const std::string &svg)
+{
+    FontData fontData;
+    ParseSVGFontData(svg.data(), svg.size(), fontData);
+
+    FontStyle style = MakeFillStyle(32.0);
+
+    // Time to the first line of text: all glyphs up front or only the ones on the line.
+    const int8_t text[] = "Hello, world!";
+    auto GetTextGlyphs = [&text](const ImageFont *pFont)
+    {
+        const int8_t *p = text;
+        while (*p)
+        {
+            UTF8Char c;
+            p = NextUTF8Char(p, c);
+            pFont->FindGlyph(c);
+        }
+    };
+
+    double ms = TimeRepeated(5, [&]()
+    {
+        ImageFont *pFont = MakeImageFont(fontData, style);
+        GetTextGlyphs(pFont);
+        DestroyImageFont(pFont);
+    });
+    std::cout << boost::format("first text, MakeImageFont: %1$.3f ms") % ms << std::endl;
+
+    ms = TimeRepeated(5, [&]()
+    {
+        ImageFont *pFont = MakeLazyImageFont(fontData, style);
+        GetTextGlyphs(pFont);
+        DestroyImageFont(pFont);
+    });
+    std::cout << boost::format("first text, MakeLazyImageFont: %1$.3f ms") % ms << std::endl;
+
+    // Going through all glyphs in order, with a budget too small for all of them.
+    for (size_t maxBytes : {(size_t)0, (size_t)256 * 1024, (size_t)64 * 1024})
+    {
+        ImageFont *pFont = MakeLazyImageFont(fontData, style, maxBytes);
+        ms = TimeRepeated(5, [&fontData, pFont]()
+        {
+            for (const auto &pair : fontData.mGlyphs)
+                pFont->GetGlyph(pair.first);
+            pFont->FreeEvictedGlyphs();
+        });
+
+        GlyphCacheStats stats = pFont->GetCacheStats();
+        std::cout << boost::format("all glyphs, budget %1% KB: %2$.3f ms per pass, %3% hits, %4% misses, "
+                                   "%5% evictions, %6% KB held")
+                        % (maxBytes / 1024) % ms % stats.hits % stats.misses % stats.evictions
+                        % (stats.bytes / 1024) << std::endl;
+
+        DestroyImageFont(pFont);
+    }
+
+    std::vector<UTF8Char> characters;
+    for (const auto &pair : fontData.mGlyphs)
+        characters.push_back(pair.first);
+
+    for (unsigned int nThreads : GetThreadCounts())
+    {
+        // All threads start on an empty cache and ask for the same glyphs.
+        ImageFont *pFont = NULL;
+        ms = TimeRepeated(5, [&]()
+        {
+            DestroyImageFont(pFont);
+            pFont = MakeLazyImageFont(fontData, style);
+
+            std::vector<std::thread> threads;
+            for (unsigned int i = 0; i < nThreads; i++)
+                threads.emplace_back([pFont, &characters]()
+                {
+                    for (UTF8Char c : characters)
+                        pFont->GetGlyph(c);
+                });
+            for (std::thread &thread : threads)
+                thread.join();
+        });
+
+        GlyphCacheStats stats = pFont->GetCacheStats();
+        std::cout << boost::format("all glyphs, %1% threads, cold: %2$.3f ms, %3% misses")
+                        % nThreads % ms % stats.misses << std::endl;
+
+        // Then they're all there, lookups only.
+        const size_t nLookups = 1000000;
+        ms = TimeRepeated(5, [&]()
+        {
+            std::vector<std::thread> threads;
+            for (unsigned int i = 0; i < nThreads; i++)
+                threads.emplace_back([pFont, &characters, i]()
+                {
+                    size_t j = i;
+                    for (size_t n = 0; n < nLookups; n++, j += 7)
+                        pFont->GetGlyph(characters[j % characters.size()]);
+                });
+            for (std::thread &thread : threads)
+                thread.join();
+        });
+
+        std::cout << boost::format("all glyphs, %1% threads, warm: %2$.1f M lookups per second")
+                        % nThreads % (nThreads * nLookups / ms / 1000) << std::endl;
+
+        DestroyImageFont(pFont);
+    }
+}
+void BenchmarkSizeAnimation(const std::string &svg)
+{
+    FontData fontData;
+    ParseSVGFontData(svg.data(), svg.size(), fontData);
+
+    FontStyle style = MakeFillStyle(16.0);  // sized per frame
+
+    // Text that grows from 16 to 48 and back, over 120 frames.
+    const int8_t text[] = "Hello, world!";
+    const size_t nFrames = 120;
+    auto GetFrameSize = [nFrames](const size_t frame)
+    {
+        return 32.0 - 16.0 * cos(2 * M_PI * frame / nFrames);
+    };
+    auto DrawText = [&text](const ImageFont *pFont)
+    {
+        for (const int8_t *p = text; *p; p++)
+            pFont->FindGlyph(*p);
+    };
+
+    double ms = TimeRepeated(1, [&]()
+    {
+        for (size_t frame = 0; frame < nFrames; frame++)
+        {
+            style.size = GetFrameSize(frame);
+            ImageFont *pFont = MakeLazyImageFont(fontData, style);
+            DrawText(pFont);
+            DestroyImageFont(pFont);
+        }
+    });
+    std::cout << boost::format("size animation, a font per frame: %1$.3f ms per frame") % (ms / nFrames) << std::endl;
+
+    for (double maxReuseScale : {1.0, 1.25})
+    {
+        ImageFontCache cache(1024 * 1024, 8, maxReuseScale);
+        ms = TimeRepeated(1, [&]()
+        {
+            for (size_t frame = 0; frame < nFrames; frame++)
+            {
+                style.size = GetFrameSize(frame);
+                DrawText(cache.GetFont(fontData, style).pFont);
+                cache.Trim();
+            }
+        });
+
+        ImageFontCacheStats stats = cache.GetStats();
+        std::cout << boost::format("size animation, ImageFontCache(reuse up to %1%x): %2$.3f ms per frame, "
+                                   "%3% fonts made, %4% reused, %5% KB held")
+                        % maxReuseScale % (ms / nFrames) % stats.misses % stats.reuses
+                        % (stats.bytes / 1024) << std::endl;
+    }
+}
+/**
+ *  Loads and destroys many fonts, like a game does between levels.
+ */
+void BenchmarkFontMemory(const std::string &large, const char *label)
+{
+    const size_t nFonts = 20;
+    std::vector<FontData *> fonts;
+
+    long rssBefore = GetCurrentRSSKB();
+    size_t nAllocationsBefore = nAllocations.load();
+    double ms = TimeRepeated(1, [&]()
+    {
+        for (size_t i = 0; i < nFonts; i++)
+        {
+            FontData *pFontData = new FontData;
+            ParseSVGFontData(large.data(), large.size(), *pFontData);
+            fonts.push_back(pFontData);
+        }
+    });
+    long rss = GetCurrentRSSKB() - rssBefore;
+    size_t nFontAllocations = nAllocations.load() - nAllocationsBefore;
+
+    std::cout << boost::format("%1%: load %2$.3f ms, %3% KB resident, %4% allocations per font")
+                    % label % (ms / nFonts) % (rss / nFonts) % (nFontAllocations / nFonts) << std::endl;
+
+    ms = TimeRepeated(1, [&fonts]()
+    {
+        for (FontData *pFontData : fonts)
+            delete pFontData;
+    });
+    fonts.clear();
+
+    std::cout << boost::format("%1%: destroy %2$.3f ms") % label % (ms / nFonts) << std::endl;
+
+    FontData fontData;
+    ParseSVGFontData(large.data(), large.size(), fontData);
+
+    FontStyle style = MakeFillStyle(16.0);
+
+    std::vector<ImageFont *> imageFonts;
+    for (size_t i = 0; i < nFonts; i++)
+        imageFonts.push_back(MakeImageFont(fontData, style));
+
+    ms = TimeRepeated(1, [&imageFonts]()
+    {
+        for (ImageFont *pFont : imageFonts)
+            DestroyImageFont(pFont);
+    });
+
+    std::cout << boost::format("%1%: DestroyImageFont %2$.3f ms") % label % (ms / nFonts) << std::endl;
+}
+
+void BenchmarkAtlas(const std::string &svg, const char *label, const double size)
+{
+    FontData fontData;
+    ParseSVGFontData(svg.data(), svg.size(), fontData);
+
+    FontStyle style = MakeFillStyle(size);
+
+    ImageFont *pFont = MakeImageFont(fontData, style);
+
+    for (size_t padding : {0, 1, 2})
+    {
+        AtlasParams params;
+        params.padding = padding;
+
+        GlyphAtlas *pAtlas = NULL;
+        double ms = TimeRepeated(1, [&]()
+        {
+            pAtlas = MakeGlyphAtlas(pFont, params);
+        });
+
+        GlyphAtlasStats stats = pAtlas->GetStats();
+        std::cout << boost::format("MakeGlyphAtlas(%1%, size %2%, padding %3%): %4$.3f ms, "
+                                   "%5% glyphs on %6% images, %7$.1f%% filled")
+                        % label % size % padding % ms % stats.glyphCount % stats.imageCount
+                        % (100.0 * stats.glyphPixels / stats.atlasPixels) << std::endl;
+
+        DestroyGlyphAtlas(pAtlas);
+    }
+
+    DestroyImageFont(pFont);
+}
+
+/**
+ *  Loading a baked bundle, against parsing, rasterizing and packing at startup.
+ */
+void BenchmarkBundle(const std::string &svg, const double size)
+{
+    FontStyle style = MakeFillStyle(size);
+
+    double msStartup = TimeRepeated(5, [&]()
+    {
+        FontData fontData;
+        ParseSVGFontData(svg.data(), svg.size(), fontData);
+
+        ImageFont *pFont = MakeImageFont(fontData, style);
+        GlyphAtlas *pAtlas = MakeGlyphAtlas(pFont);
+
+        DestroyGlyphAtlas(pAtlas);
+        DestroyImageFont(pFont);
+    });
+
+    FontData fontData;
+    ParseSVGFontData(svg.data(), svg.size(), fontData);
+    ImageFont *pFont = MakeImageFont(fontData, style);
+
+    FontBundle baked;
+    MakeFontBundle(pFont, baked);
+    DestroyImageFont(pFont);
+
+    std::ostringstream os;
+    WriteFontBundle(os, baked);
+    std::string data = os.str();
+
+    double msBundle = TimeRepeated(20, [&data]()
+    {
+        FontBundle bundle;
+        ReadFontBundle(data.data(), data.size(), bundle);
+    });
+
+    std::cout << boost::format("Parse, MakeImageFont and MakeGlyphAtlas(size %1%): %2$.3f ms, "
+                               "ReadFontBundle: %3$.3f ms, %4% bytes")
+                    % size % msStartup % msBundle % data.size() << std::endl;
+}
+
+/**
+ *  Chat messages of random characters, some far more common than others.
+ */
+void BenchmarkDynamicAtlas(const std::string &large)
+{
+    FontData fontData;
+    ParseSVGFontData(large.data(), large.size(), fontData);
+
+    FontStyle style = MakeFillStyle(16.0);
+
+    ImageFont *pFont = MakeLazyImageFont(fontData, style, 256 * 1024);
+
+    std::vector<UTF8Char> characters;
+    for (const auto &pair : fontData.mGlyphs)
+        characters.push_back(pair.first);
+    std::sort(characters.begin(), characters.end());
+
+    std::mt19937 generator(1);
+    std::exponential_distribution<double> distribution(30.0);
+
+    DynamicAtlasParams params;
+    params.width = 512;
+    params.height = 512;
+    DynamicGlyphAtlas atlas(pFont, params);
+
+    const size_t nFrames = 1000, nCharactersPerFrame = 50;
+    size_t nUploadedPixels = 0;
+    double ms = TimeRepeated(1, [&]()
+    {
+        for (size_t frame = 0; frame < nFrames; frame++)
+        {
+            for (size_t i = 0; i < nCharactersPerFrame; i++)
+            {
+                size_t index = std::min((size_t)(distribution(generator) * characters.size()), characters.size() - 1);
+                atlas.FindRect(characters[index]);
+            }
+
+            for (const AtlasDirtyRect &dirty : atlas.TakeDirtyRects())
+                nUploadedPixels += dirty.width * dirty.height;
+
+            pFont->FreeEvictedGlyphs();
+            atlas.NextFrame();
+        }
+    });
+
+    DynamicAtlasStats stats = atlas.GetStats();
+    std::cout << boost::format("DynamicGlyphAtlas(%1%x%2%, %3% characters per frame): %4$.3f ms per frame, "
+                               "%5$.1f%% hits, %6% evictions, %7% KB uploaded per frame instead of %8% KB")
+                    % params.width % params.height % nCharactersPerFrame % (ms / nFrames)
+                    % (100.0 * stats.hits / (stats.hits + stats.misses)) % stats.evictions
+                    % (nUploadedPixels * 4 / 1024 / nFrames) % (params.width * params.height * 4 / 1024) << std::endl;
+
+    DestroyImageFont(pFont);
+}
+
+std::string MakeLargeFont(const std::string &svg, const size_t nGlyphs)
+{
+    std::vector<std::string> paths;
+    size_t start = 0;
+    while ((start = svg.find("d=\"", start)) != std::string::npos)
+    {
+        start += 3;
+        if (!isspace(svg[start - 4]))
+            continue;
+
+        size_t end = svg.find('"', start);
+        paths.push_back(svg.substr(start, end - start));
+        start = end;
+    }
+    if (paths.empty())
+        paths.push_back("M0 0h10v10h-10z");
+
+    std::ostringstream os;
+    os << "<svg xmlns=\"http://www.w3.org/2000/svg\"><defs><font horiz-adv-x=\"64\">"
+       << "<font-face units-per-em=\"64\" ascent=\"50\" descent=\"-14\" bbox=\"0 -14 64 50\"/>" << std::endl;
+
+    // Every glyph gets a different outline, or they would share their paths.
+    for (size_t i = 0; i < nGlyphs; i++)
+        os << boost::format("<glyph glyph-name=\"cjk%1%\" unicode=\"&#x%2$X;\" d=\"M%1% 0%3%\"/>")
+                % i % (0x4E00 + i) % paths[i % paths.size()] << std::endl;
+
+    for (size_t i = 0; i + 1 < nGlyphs; i++)
+        os << boost::format("<hkern g1=\"cjk%1%\" g2=\"cjk%2%\" k=\"%3%\"/>") % i % (i + 1) % (i % 7) << std::endl;
+
+    os << "</font></defs></svg>" << std::endl;
+    return os.str();
+}
+
+void BenchmarkParallelParse(const std::string &svg)
+{
+    std::string large = MakeLargeFont(svg, 20000);
+
+    for (unsigned int nThreads : GetThreadCounts())
+    {
+        double ms = TimeRepeated(5, [&large, nThreads]()
+        {
+            FontParseParams params;
+            params.nThreads = nThreads;
+
+            FontData fontData;
+            ParseSVGFontData(large.data(), large.size(), fontData, params);
+        });
+
+        std::cout << boost::format("ParseSVGFontData(20000 glyphs, %1% threads): %2$.3f ms") % nThreads % ms << std::endl;
+    }
+
+    // A screen that only shows a few hundred of these characters.
+    CharacterSet characters;
+    AddCharacterRange(0x4E00, 0x4E00 + 299, characters);
+
+    double ms = TimeRepeated(5, [&large, &characters]()
+    {
+        FontParseParams params;
+        params.pCharacters = &characters;
+
+        FontData fontData;
+        ParseSVGFontData(large.data(), large.size(), fontData, params);
+    });
+
+    std::cout << boost::format("ParseSVGFontData(20000 glyphs, 300 characters kept): %1$.3f ms") % ms << std::endl;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << boost::format("Usage: %1% font_path") % argv[0] << std::endl;
+        return 1;
+    }
+
+    // Read the whole file first, so that disk access isn't measured.
+    std::ifstream is(argv[1]);
+    if (!is.good())
+    {
+        std::cerr << "Error opening " << argv[1] << std::endl;
+        return 1;
+    }
+    std::stringstream ss;
+    ss << is.rdbuf();
+    std::string svg = ss.str();
+
+    try
+    {
+        BenchmarkParse(svg, argv[1]);
+        BenchmarkGzip(svg);
+        BenchmarkRaster(svg);
+        BenchmarkLazyFont(svg);
+        BenchmarkSizeAnimation(svg);
+        BenchmarkParallelParse(svg);
+        BenchmarkFontMemory(svg, "FontData(sample)");
+        BenchmarkFontMemory(MakeLargeFont(svg, 20000), "FontData(20000 glyphs)");
+        BenchmarkAtlas(svg, "sample", 32.0);
+        BenchmarkAtlas(MakeLargeFont(svg, 20000), "20000 glyphs", 16.0);
+        BenchmarkDynamicAtlas(MakeLargeFont(svg, 20000));
+        BenchmarkBundle(svg, 32.0);
+        BenchmarkBinary(svg);
+        BenchmarkNumbers();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestBinary
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+#include <text-gl/font.h>
+
+
+using namespace TextGL;
+
+void CheckEqualGlyphs(const FontData &font1, const GlyphData &glyph1,
+                      const FontData &font2, const GlyphData &glyph2)
+{
+    BOOST_CHECK_EQUAL(glyph1.mMetrics.bearingX, glyph2.mMetrics.bearingX);
+    BOOST_CHECK_EQUAL(glyph1.mMetrics.bearingY, glyph2.mMetrics.bearingY);
+    BOOST_CHECK_EQUAL(glyph1.mMetrics.width, glyph2.mMetrics.width);
+    BOOST_CHECK_EQUAL(glyph1.mMetrics.height, glyph2.mMetrics.height);
+    BOOST_CHECK_EQUAL(glyph1.mMetrics.advanceX, glyph2.mMetrics.advanceX);
+
+    GlyphPathView path1 = GetGlyphPath(font1, glyph1),
+                  path2 = GetGlyphPath(font2, glyph2);
+
+    BOOST_REQUIRE_EQUAL(path1.elementCount, path2.elementCount);
+
+    const float *pCoords1 = path1.pCoords,
+                *pCoords2 = path2.pCoords;
+    for (uint32_t i = 0; i < path1.elementCount; i++)
+    {
+        uint8_t type = path1.pElementTypes[i];
+        BOOST_REQUIRE_EQUAL(type, path2.pElementTypes[i]);
+
+        for (uint8_t j = 0; j < PATH_ELEMENT_COORD_COUNTS[type]; j++)
+            BOOST_CHECK_EQUAL(*pCoords1++, *pCoords2++);
+    }
+}
+
+void CheckEqualFonts(const FontData &font1, const FontData &font2)
+{
+    BOOST_CHECK_EQUAL(font1.mMetrics.unitsPerEM, font2.mMetrics.unitsPerEM);
+    BOOST_CHECK_EQUAL(font1.mMetrics.ascent, font2.mMetrics.ascent);
+    BOOST_CHECK_EQUAL(font1.mMetrics.descent, font2.mMetrics.descent);
+    BOOST_CHECK_EQUAL(font1.mMetrics.bbox.left, font2.mMetrics.bbox.left);
+    BOOST_CHECK_EQUAL(font1.mMetrics.bbox.bottom, font2.mMetrics.bbox.bottom);
+    BOOST_CHECK_EQUAL(font1.mMetrics.bbox.right, font2.mMetrics.bbox.right);
+    BOOST_CHECK_EQUAL(font1.mMetrics.bbox.top, font2.mMetrics.bbox.top);
+
+    BOOST_REQUIRE_EQUAL(font1.mGlyphs.size(), font2.mGlyphs.size());
+    for (const auto &pair : font1.mGlyphs)
+    {
+        BOOST_REQUIRE(font2.mGlyphs.find(pair.first) != font2.mGlyphs.end());
+        CheckEqualGlyphs(font1, pair.second, font2, font2.mGlyphs.at(pair.first));
+    }
+
+    BOOST_REQUIRE_EQUAL(font1.mHasMissingGlyph, font2.mHasMissingGlyph);
+    if (font1.mHasMissingGlyph)
+        CheckEqualGlyphs(font1, font1.mMissingGlyph, font2, font2.mMissingGlyph);
+
+    BOOST_REQUIRE_EQUAL(font1.mHorizontalKernTable.size(), font2.mHorizontalKernTable.size());
+    for (const auto &firstPair : font1.mHorizontalKernTable)
+    {
+        BOOST_REQUIRE(font2.mHorizontalKernTable.find(firstPair.first) != font2.mHorizontalKernTable.end());
+
+        const auto &row2 = font2.mHorizontalKernTable.at(firstPair.first);
+        BOOST_REQUIRE_EQUAL(firstPair.second.size(), row2.size());
+        for (const auto &secondPair : firstPair.second)
+        {
+            BOOST_REQUIRE(row2.find(secondPair.first) != row2.end());
+            BOOST_CHECK_EQUAL(secondPair.second, row2.at(secondPair.first));
+        }
+    }
+}
+
+void CheckRoundTrip(const char *svgPath)
+{
+    FontData parsed;
+    ParseSVGFontFile(svgPath, parsed);
+
+    std::ostringstream os;
+    WriteBinaryFontData(os, parsed);
+    std::string binary = os.str();
+
+    FontData loaded;
+    ReadBinaryFontData(binary.data(), binary.size(), loaded);
+    CheckEqualFonts(parsed, loaded);
+
+    // The same data must give the same bytes.
+    std::ostringstream os2;
+    WriteBinaryFontData(os2, loaded);
+    BOOST_CHECK(os2.str() == binary);
+}
+
+BOOST_AUTO_TEST_CASE(round_trip_test)
+{
+    CheckRoundTrip("data/sample1.svg");
+    CheckRoundTrip("data/sample2.svg");
+}
+
+BOOST_AUTO_TEST_CASE(lazy_test)
+{
+    FontData parsed, lazy;
+    ParseSVGFontFile("data/sample1.svg", parsed);
+
+    FontParseParams params;
+    params.lazyPaths = true;
+    ParseSVGFontFile("data/sample1.svg", lazy, params);
+
+    // Paths that weren't parsed yet, must be parsed while writing.
+    std::ostringstream os;
+    WriteBinaryFontData(os, lazy);
+    std::string binary = os.str();
+
+    FontData loaded;
+    ReadBinaryFontData(binary.data(), binary.size(), loaded);
+    CheckEqualFonts(parsed, loaded);
+}
+
+BOOST_AUTO_TEST_CASE(file_test)
+{
+    FontData parsed;
+    ParseSVGFontFile("data/sample1.svg", parsed);
+
+    const char *binaryPath = "test_binary.tglf";
+    {
+        std::ofstream os(binaryPath, std::ios::binary);
+        WriteBinaryFontData(os, parsed);
+    }
+
+    FontData loaded;
+    ReadBinaryFontFile(binaryPath, loaded);
+    std::remove(binaryPath);
+
+    CheckEqualFonts(parsed, loaded);
+}
+
+BOOST_AUTO_TEST_CASE(truncated_test)
+{
+    FontData parsed;
+    ParseSVGFontFile("data/sample2.svg", parsed);
+
+    std::ostringstream os;
+    WriteBinaryFontData(os, parsed);
+    std::string binary = os.str();
+
+    FontData loaded;
+    BOOST_CHECK_THROW(ReadBinaryFontData(binary.data(), binary.size() - 1, loaded), FontParseError);
+    BOOST_CHECK_THROW(ReadBinaryFontData(binary.data(), 10, loaded), FontParseError);
+
+    binary[0] = 'X';
+    BOOST_CHECK_THROW(ReadBinaryFontData(binary.data(), binary.size(), loaded), FontParseError);
+}
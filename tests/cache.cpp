@@ -0,0 +1,422 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestCache
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <text-gl/image.h>
+
+#include "style.h"
+
+
+using namespace TextGL;
+
+size_t GetImageBytes(const ImageGlyph *pGlyph)
+{
+    size_t w, h;
+    pGlyph->GetImage()->GetDimensions(w, h);
+    return w * h * 4;
+}
+
+BOOST_AUTO_TEST_CASE(lazy_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    FontStyle style = MakeFillStyle(32.0);
+    ImageFont *pFont = MakeImageFont(fontData, style),
+              *pLazyFont = MakeLazyImageFont(fontData, style);
+
+    // Metrics come without rendering.
+    for (const auto &pair : fontData.mGlyphs)
+    {
+        const GlyphMetrics *pMetrics = pFont->GetGlyphMetrics(pair.first),
+                           *pLazyMetrics = pLazyFont->GetGlyphMetrics(pair.first);
+        BOOST_CHECK_EQUAL(pMetrics->advanceX, pLazyMetrics->advanceX);
+        BOOST_CHECK_EQUAL(pMetrics->bearingY, pLazyMetrics->bearingY);
+    }
+    BOOST_CHECK_EQUAL(pLazyFont->GetCacheStats().misses, 0);
+
+    // Rendered when asked for, the same as up front.
+    for (const auto &pair : fontData.mGlyphs)
+    {
+        const ImageGlyph *pGlyph = pFont->GetGlyph(pair.first),
+                         *pLazyGlyph = pLazyFont->GetGlyph(pair.first);
+
+        size_t bytes = GetImageBytes(pGlyph);
+        BOOST_REQUIRE_EQUAL(bytes, GetImageBytes(pLazyGlyph));
+        BOOST_CHECK(memcmp(pGlyph->GetImage()->GetData(), pLazyGlyph->GetImage()->GetData(), bytes) == 0);
+    }
+
+    GlyphCacheStats stats = pLazyFont->GetCacheStats();
+    BOOST_CHECK(stats.misses > 0);
+    BOOST_CHECK_EQUAL(stats.evictions, 0);
+    BOOST_CHECK_EQUAL(stats.glyphCount, stats.misses);
+
+    // The second time, they're all in the cache.
+    pLazyFont->ResetCacheStats();
+    for (const auto &pair : fontData.mGlyphs)
+        pLazyFont->GetGlyph(pair.first);
+
+    stats = pLazyFont->GetCacheStats();
+    BOOST_CHECK_EQUAL(stats.misses, 0);
+    BOOST_CHECK_EQUAL(stats.hits, fontData.mGlyphs.size());
+
+    BOOST_CHECK_THROW(pLazyFont->GetGlyph(0x01), MissingGlyphError);
+
+    DestroyImageFont(pFont);
+    DestroyImageFont(pLazyFont);
+}
+
+BOOST_AUTO_TEST_CASE(budget_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    const size_t maxBytes = 16 * 1024;
+    ImageFont *pFont = MakeLazyImageFont(fontData, MakeFillStyle(32.0), maxBytes);
+
+    const UTF8Char pinned = 'A';
+    pFont->PinGlyph(pinned);
+    const ImageGlyph *pPinnedGlyph = pFont->GetGlyph(pinned);
+    size_t pinnedBytes = GetImageBytes(pPinnedGlyph);
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (const auto &pair : fontData.mGlyphs)
+        {
+            const ImageGlyph *pGlyph = pFont->GetGlyph(pair.first);
+
+            // The cache may only go over budget, to hold the glyph that was just asked for.
+            GlyphCacheStats stats = pFont->GetCacheStats();
+            BOOST_CHECK(stats.bytes <= maxBytes + pinnedBytes + GetImageBytes(pGlyph));
+        }
+    }
+
+    GlyphCacheStats stats = pFont->GetCacheStats();
+    BOOST_CHECK(stats.evictions > 0);
+    BOOST_CHECK(stats.evictedBytes > 0);
+
+    pFont->FreeEvictedGlyphs();
+    BOOST_CHECK_EQUAL(pFont->GetCacheStats().evictedBytes, 0);
+
+    // Pinned glyphs are never evicted.
+    BOOST_CHECK_EQUAL(pFont->GetGlyph(pinned), pPinnedGlyph);
+
+    pFont->UnpinGlyph(pinned);
+    BOOST_CHECK_THROW(pFont->PinGlyph(0x01), MissingGlyphError);
+
+    DestroyImageFont(pFont);
+}
+
+/**
+ *  Lets several threads ask for the same glyphs at the same time.
+ */
+void RunThreads(const size_t nThreads, const std::function<void(size_t)> &f)
+{
+    std::atomic<size_t> nWaiting(nThreads);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nThreads; i++)
+    {
+        threads.emplace_back([&nWaiting, &f, i]()
+        {
+            nWaiting--;
+            while (nWaiting > 0)
+                std::this_thread::yield();
+
+            f(i);
+        });
+    }
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+BOOST_AUTO_TEST_CASE(race_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    std::vector<UTF8Char> characters;
+    for (const auto &pair : fontData.mGlyphs)
+        characters.push_back(pair.first);
+
+    ImageFont *pFont = MakeLazyImageFont(fontData, MakeFillStyle(32.0));
+
+    const size_t nThreads = 8;
+    std::vector<std::vector<const ImageGlyph *>> threadGlyphs(nThreads);
+    RunThreads(nThreads, [&](size_t i)
+    {
+        for (UTF8Char c : characters)
+            threadGlyphs[i].push_back(pFont->GetGlyph(c));
+    });
+
+    // Every thread got the same glyphs, each rendered only once.
+    for (size_t i = 1; i < nThreads; i++)
+        BOOST_CHECK(threadGlyphs[i] == threadGlyphs[0]);
+
+    GlyphCacheStats stats = pFont->GetCacheStats();
+    BOOST_CHECK_EQUAL(stats.misses, stats.glyphCount);
+    BOOST_CHECK_EQUAL(stats.hits + stats.misses, nThreads * characters.size());
+
+    DestroyImageFont(pFont);
+}
+
+BOOST_AUTO_TEST_CASE(stress_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    std::vector<UTF8Char> characters;
+    for (const auto &pair : fontData.mGlyphs)
+        characters.push_back(pair.first);
+
+    FontStyle style = MakeFillStyle(24.0);
+    ImageFont *pFont = MakeImageFont(fontData, style),
+              *pLazyFont = MakeLazyImageFont(fontData, style, 32 * 1024);
+
+    const UTF8Char pinned = 'A';
+    pLazyFont->PinGlyph(pinned);
+    const ImageGlyph *pPinnedGlyph = pLazyFont->GetGlyph(pinned);
+
+    // Small budget, so that glyphs are evicted and rendered again while other threads read them.
+    const size_t nThreads = 8, nRounds = 4;
+    std::atomic<size_t> nWrong(0);
+    for (size_t round = 0; round < nRounds; round++)
+    {
+        RunThreads(nThreads, [&](size_t i)
+        {
+            unsigned int seed = i * nRounds + round;
+            for (size_t j = 0; j < 2000; j++)
+            {
+                UTF8Char c = characters[rand_r(&seed) % characters.size()];
+
+                const ImageGlyph *pGlyph = pFont->GetGlyph(c),
+                                 *pLazyGlyph = pLazyFont->GetGlyph(c);
+
+                size_t bytes = GetImageBytes(pGlyph);
+                if (bytes != GetImageBytes(pLazyGlyph)
+                        || memcmp(pGlyph->GetImage()->GetData(), pLazyGlyph->GetImage()->GetData(), bytes) != 0)
+                    nWrong++;
+
+                if (pLazyFont->GetGlyph(pinned) != pPinnedGlyph)
+                    nWrong++;
+            }
+        });
+
+        // Between rounds, no thread holds glyphs.
+        pLazyFont->FreeEvictedGlyphs();
+    }
+
+    BOOST_CHECK_EQUAL(nWrong, 0);
+
+    GlyphCacheStats stats = pLazyFont->GetCacheStats();
+    BOOST_TEST_MESSAGE(stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions << " evictions");
+    BOOST_CHECK(stats.evictions > 0);
+    BOOST_CHECK_EQUAL(stats.evictedBytes, 0);
+
+    pLazyFont->UnpinGlyph(pinned);
+
+    DestroyImageFont(pFont);
+    DestroyImageFont(pLazyFont);
+}
+
+BOOST_AUTO_TEST_CASE(size_bucket_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    // No reuse, only rounding to buckets of a quarter octave.
+    ImageFontCache cache(0, 4, 1.0);
+
+    SizedImageFont font32 = cache.GetFont(fontData, MakeFillStyle(32.0)),
+                   font33 = cache.GetFont(fontData, MakeFillStyle(33.0)),
+                   font40 = cache.GetFont(fontData, MakeFillStyle(40.0));
+
+    BOOST_CHECK_EQUAL(font32.pFont, font33.pFont);
+    BOOST_CHECK(font32.pFont != font40.pFont);
+    BOOST_CHECK_CLOSE(font32.pFont->GetStyle()->size, 32.0, 1e-9);
+    BOOST_CHECK_CLOSE(font33.scale, 33.0 / 32.0, 1e-9);
+    BOOST_CHECK_CLOSE(font40.pFont->GetStyle()->size * font40.scale, 40.0, 1e-9);
+
+    // Other styles don't share buckets.
+    FontStyle style = MakeFillStyle(32.0);
+    style.fillColor = {1.0, 0.0, 0.0, 1.0};
+    BOOST_CHECK(cache.GetFont(fontData, style).pFont != font32.pFont);
+
+    ImageFontCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.hits, 1);
+    BOOST_CHECK_EQUAL(stats.misses, 3);
+    BOOST_CHECK_EQUAL(stats.fontCount, 3);
+}
+
+BOOST_AUTO_TEST_CASE(size_reuse_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    ImageFontCache cache(0, 8, 1.25);
+
+    // Growing a little at a time keeps using the first font.
+    SizedImageFont first = cache.GetFont(fontData, MakeFillStyle(32.0));
+    for (double size = 32.0; size < 40.0; size += 0.5)
+    {
+        SizedImageFont font = cache.GetFont(fontData, MakeFillStyle(size));
+        BOOST_CHECK_EQUAL(font.pFont, first.pFont);
+        BOOST_CHECK_CLOSE(font.pFont->GetStyle()->size * font.scale, size, 1e-9);
+    }
+
+    // Too far away, so it needs a font of its own.
+    BOOST_CHECK(cache.GetFont(fontData, MakeFillStyle(48.0)).pFont != first.pFont);
+
+    ImageFontCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.misses, 2);
+    BOOST_CHECK(stats.reuses > 0);
+}
+
+BOOST_AUTO_TEST_CASE(size_budget_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    const size_t maxBytes = 64 * 1024;
+    ImageFontCache cache(maxBytes, 8, 1.0);
+
+    // Pinned glyphs can't be evicted, so only destroying fonts brings those back within the budget.
+    const int8_t text[] = "Hello, world!";
+    for (double size = 16.0; size < 64.0; size *= 1.1)
+    {
+        SizedImageFont font = cache.GetFont(fontData, MakeFillStyle(size));
+        for (const int8_t *p = text; *p; p++)
+            font.pFont->PinGlyph(*p);
+
+        cache.Trim();
+        BOOST_CHECK(cache.GetStats().fontCount == 1 || cache.GetStats().bytes <= maxBytes);
+    }
+
+    ImageFontCacheStats stats = cache.GetStats();
+    BOOST_CHECK(stats.evictions > 0);
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.GetStats().fontCount, 0);
+}
+
+BOOST_AUTO_TEST_CASE(size_shared_budget_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    const size_t maxBytes = 64 * 1024;
+    ImageFontCache cache(maxBytes, 8, 1.0);
+
+    // Without trimming, all sizes stay alive and keep within the budget together.
+    std::vector<SizedImageFont> fonts;
+    for (double size = 16.0; size < 40.0; size *= 1.2)
+    {
+        fonts.push_back(cache.GetFont(fontData, MakeFillStyle(size)));
+        for (const SizedImageFont &font : fonts)
+        {
+            for (const auto &pair : fontData.mGlyphs)
+                font.pFont->FindGlyph(pair.first);
+        }
+
+        BOOST_CHECK(cache.GetStats().bytes <= maxBytes);
+    }
+    BOOST_CHECK_EQUAL(cache.GetStats().fontCount, fonts.size());
+
+    cache.Trim();
+    BOOST_CHECK_EQUAL(cache.GetStats().fontCount, fonts.size());
+    for (const SizedImageFont &font : fonts)
+        BOOST_CHECK_EQUAL(font.pFont->GetCacheStats().evictedBytes, 0);
+}
+
+BOOST_AUTO_TEST_CASE(shared_kern_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    CharacterSet characters;
+    AddCharacterRange('A', 'Z', characters);
+
+    ImageFont *pFont16 = MakeLazyImageFont(fontData, MakeFillStyle(16.0)),
+              *pFont32 = MakeLazyImageFont(fontData, MakeFillStyle(32.0)),
+              *pSubsetFont = MakeImageFont(fontData, MakeFillStyle(32.0), &characters);
+
+    // All sizes refer to the same unscaled table.
+    BOOST_CHECK_EQUAL(fontData.mMetricsStore.use_count(), 4);
+
+    size_t nPairs = 0;
+    for (const auto &row : fontData.mHorizontalKernTable)
+    {
+        UTF8Char c1 = row.first;
+        for (const auto &pair : row.second)
+        {
+            UTF8Char c2 = pair.first;
+            double k = pair.second / fontData.mMetrics.unitsPerEM;
+
+            BOOST_CHECK_CLOSE(pFont16->GetHorizontalKern(c1, c2), k * 16.0, 1e-9);
+            BOOST_CHECK_CLOSE(pFont32->GetHorizontalKern(c1, c2), k * 32.0, 1e-9);
+
+            if (characters.count(c1) > 0 && characters.count(c2) > 0)
+                BOOST_CHECK_CLOSE(pSubsetFont->GetHorizontalKern(c1, c2), k * 32.0, 1e-9);
+            else
+                BOOST_CHECK_EQUAL(pSubsetFont->GetHorizontalKern(c1, c2), 0.0);
+
+            nPairs++;
+        }
+    }
+    BOOST_CHECK(nPairs > 0);
+
+    DestroyImageFont(pFont16);
+    DestroyImageFont(pFont32);
+    DestroyImageFont(pSubsetFont);
+
+    BOOST_CHECK_EQUAL(fontData.mMetricsStore.use_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(reload_kern_test)
+{
+    FontData original;
+    ParseSVGFontFile("data/sample1.svg", original);
+
+    const double k = GetKernValue(original.mHorizontalKernTable, 'R', 'V') / original.mMetrics.unitsPerEM;
+    BOOST_REQUIRE(k != 0.0);
+
+    std::ostringstream os;
+    WriteBinaryFontData(os, original);
+    std::string binary = os.str();
+
+    // Kerning that the loaders must replace, in data that a font was already made from.
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+    fontData.mHorizontalKernTable['R']['V'] = 1000.0;
+
+    ImageFont *pFont = MakeLazyImageFont(fontData, MakeFillStyle(16.0));
+    BOOST_CHECK_CLOSE(pFont->GetHorizontalKern('R', 'V'), 1000.0 / fontData.mMetrics.unitsPerEM * 16.0, 1e-9);
+    DestroyImageFont(pFont);
+
+    ReadBinaryFontData(binary.data(), binary.size(), fontData);
+
+    pFont = MakeLazyImageFont(fontData, MakeFillStyle(16.0));
+    BOOST_CHECK_CLOSE(pFont->GetHorizontalKern('R', 'V'), k * 16.0, 1e-9);
+    DestroyImageFont(pFont);
+
+    fontData.mHorizontalKernTable['R']['V'] = 1000.0;
+    fontData.mMetricsStore.reset();
+
+    pFont = MakeLazyImageFont(fontData, MakeFillStyle(16.0));
+    BOOST_CHECK_CLOSE(pFont->GetHorizontalKern('R', 'V'), 1000.0 / fontData.mMetrics.unitsPerEM * 16.0, 1e-9);
+    DestroyImageFont(pFont);
+
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    pFont = MakeLazyImageFont(fontData, MakeFillStyle(16.0));
+    BOOST_CHECK_CLOSE(pFont->GetHorizontalKern('R', 'V'), k * 16.0, 1e-9);
+    DestroyImageFont(pFont);
+}
@@ -40,3 +40,57 @@ BOOST_AUTO_TEST_CASE(next_test)
     BOOST_CHECK_EQUAL(characters[3], 'Ж');
     BOOST_CHECK_EQUAL(characters[7], 'a');
 }
+
+BOOST_AUTO_TEST_CASE(replace_test)
+{
+    const int8_t text[] = {'a', (int8_t)0xd0, 'b', (int8_t)0x91, (int8_t)0xd0, (int8_t)0x91, 0};
+    UTF8Char c;
+    bool valid;
+
+    const int8_t *p = NextUTF8Char(text, c, valid);
+    BOOST_CHECK(valid);
+    BOOST_CHECK_EQUAL(c, 'a');
+
+    // Truncated two byte sequence.
+    p = NextUTF8Char(p, c, valid);
+    BOOST_CHECK(!valid);
+    BOOST_CHECK_EQUAL(c, UTF8_REPLACEMENT_CHAR);
+    BOOST_CHECK_EQUAL(p, text + 2);
+
+    p = NextUTF8Char(p, c, valid);
+    BOOST_CHECK_EQUAL(c, 'b');
+
+    // Lone continuation byte.
+    p = NextUTF8Char(p, c, valid, '?');
+    BOOST_CHECK(!valid);
+    BOOST_CHECK_EQUAL(c, '?');
+
+    p = NextUTF8Char(p, c, valid);
+    BOOST_CHECK(valid);
+    BOOST_CHECK_EQUAL(c, 'Б');
+    BOOST_CHECK_EQUAL(*p, NULL);
+}
+
+BOOST_AUTO_TEST_CASE(code_point_test)
+{
+    const int8_t text[] = "aБ€😀";
+    const uint32_t codePoints[] = {0x61, 0x411, 0x20ac, 0x1f600};
+
+    const int8_t *p = text;
+    UTF8Char c;
+    for (const uint32_t codePoint : codePoints)
+    {
+        p = NextUTF8Char(p, c);
+        BOOST_CHECK_EQUAL(CodePointToUTF8Char(codePoint), c);
+    }
+
+    BOOST_CHECK_THROW(CodePointToUTF8Char(0x110000), EncodingError);
+
+    CharacterSet characters;
+    AddCharacters((const int8_t *)"abba", characters);
+    BOOST_CHECK_EQUAL(characters.size(), 2u);
+
+    AddCharacterRange(0x61, 0x7a, characters);
+    BOOST_CHECK_EQUAL(characters.size(), 26u);
+    BOOST_CHECK(characters.count('z') == 1);
+}
@@ -0,0 +1,500 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestParse
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#include <text-gl/font.h>
+
+
+using namespace TextGL;
+
+void CheckEqualPaths(const GlyphPathView &path1, const GlyphPathView &path2)
+{
+    BOOST_REQUIRE_EQUAL(path1.elementCount, path2.elementCount);
+
+    const float *pCoords1 = path1.pCoords,
+                *pCoords2 = path2.pCoords;
+    for (uint32_t i = 0; i < path1.elementCount; i++)
+    {
+        uint8_t type = path1.pElementTypes[i];
+        BOOST_REQUIRE_EQUAL(type, path2.pElementTypes[i]);
+
+        for (uint8_t j = 0; j < PATH_ELEMENT_COORD_COUNTS[type]; j++)
+            BOOST_CHECK_EQUAL(*pCoords1++, *pCoords2++);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lazy_test)
+{
+    FontData parsed, lazy;
+    ParseSVGFontFile("data/sample2.svg", parsed);
+
+    FontParseParams params;
+    params.lazyPaths = true;
+    ParseSVGFontFile("data/sample2.svg", lazy, params);
+
+    BOOST_CHECK(parsed.mPathText.empty());
+    BOOST_CHECK(lazy.mPathStore.mElementTypes.empty());
+
+    BOOST_REQUIRE_EQUAL(parsed.mGlyphs.size(), lazy.mGlyphs.size());
+    for (const auto &pair : parsed.mGlyphs)
+    {
+        const GlyphData &glyph = lazy.mGlyphs.at(pair.first);
+
+        BOOST_CHECK_EQUAL(pair.second.mMetrics.advanceX, glyph.mMetrics.advanceX);
+
+        CheckEqualPaths(GetGlyphPath(parsed, pair.second), GetGlyphPath(lazy, glyph));
+
+        // The second time, the same parsed path must be returned.
+        BOOST_CHECK_EQUAL(GetGlyphPath(lazy, glyph).pElementTypes, GetGlyphPath(lazy, glyph).pElementTypes);
+    }
+
+    BOOST_REQUIRE_EQUAL(parsed.mHasMissingGlyph, lazy.mHasMissingGlyph);
+    if (parsed.mHasMissingGlyph)
+        CheckEqualPaths(GetGlyphPath(parsed, parsed.mMissingGlyph), GetGlyphPath(lazy, lazy.mMissingGlyph));
+}
+
+BOOST_AUTO_TEST_CASE(lazy_threads_test)
+{
+    FontData lazy;
+    FontParseParams params;
+    params.lazyPaths = true;
+    ParseSVGFontFile("data/sample1.svg", lazy, params);
+
+    std::vector<const GlyphData *> glyphs;
+    for (const auto &pair : lazy.mGlyphs)
+        glyphs.push_back(&pair.second);
+
+    // Every thread gets all paths, so that they race on each first use.
+    const size_t nThreads = 8;
+    std::vector<std::vector<GlyphPathView>> results(nThreads);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nThreads; i++)
+    {
+        threads.emplace_back([&lazy, &glyphs, &results, i]()
+        {
+            for (const GlyphData *pGlyph : glyphs)
+                results[i].push_back(GetGlyphPath(lazy, *pGlyph));
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    for (size_t i = 1; i < nThreads; i++)
+    {
+        for (size_t j = 0; j < glyphs.size(); j++)
+            BOOST_CHECK_EQUAL(results[i][j].pElementTypes, results[0][j].pElementTypes);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_test)
+{
+    for (const char *path : {"data/sample1.svg", "data/sample2.svg"})
+    {
+        FontData sequential;
+        ParseSVGFontFile(path, sequential);
+
+        for (unsigned int nThreads : {2, 3, 8})
+        {
+            FontData parallel;
+            FontParseParams params;
+            params.nThreads = nThreads;
+            ParseSVGFontFile(path, parallel, params);
+
+            // Not just the same paths, but the same store.
+            BOOST_CHECK(parallel.mPathStore.mElementTypes == sequential.mPathStore.mElementTypes);
+            BOOST_CHECK(parallel.mPathStore.mCoords == sequential.mPathStore.mCoords);
+
+            BOOST_REQUIRE_EQUAL(parallel.mGlyphs.size(), sequential.mGlyphs.size());
+            for (const auto &pair : sequential.mGlyphs)
+            {
+                const GlyphPath &path1 = pair.second.mPath,
+                                &path2 = parallel.mGlyphs.at(pair.first).mPath;
+                BOOST_CHECK_EQUAL(path1.firstElement, path2.firstElement);
+                BOOST_CHECK_EQUAL(path1.elementCount, path2.elementCount);
+                BOOST_CHECK_EQUAL(path1.firstCoord, path2.firstCoord);
+            }
+
+            BOOST_CHECK_EQUAL(parallel.mMissingGlyph.mPath.firstElement, sequential.mMissingGlyph.mPath.firstElement);
+            BOOST_CHECK_EQUAL(parallel.mMissingGlyph.mPath.elementCount, sequential.mMissingGlyph.mPath.elementCount);
+
+            BOOST_CHECK(parallel.mHorizontalKernTable == sequential.mHorizontalKernTable);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shared_path_test)
+{
+    // Latin, Cyrillic and Greek 'A' have the same outline in this font.
+    const UTF8Char characters[] = {'A', CodePointToUTF8Char(0x410), CodePointToUTF8Char(0x391)};
+
+    for (bool lazyPaths : {false, true})
+    {
+        for (unsigned int nThreads : {1, 4})
+        {
+            FontParseParams params;
+            params.lazyPaths = lazyPaths;
+            params.nThreads = nThreads;
+
+            FontData fontData;
+            ParseSVGFontFile("data/sample1.svg", fontData, params);
+
+            const GlyphPath &path = fontData.mGlyphs.at(characters[0]).mPath;
+            for (const UTF8Char c : characters)
+            {
+                const GlyphPath &other = fontData.mGlyphs.at(c).mPath;
+                BOOST_CHECK_EQUAL(other.firstElement, path.firstElement);
+                BOOST_CHECK_EQUAL(other.firstCoord, path.firstCoord);
+                BOOST_CHECK_EQUAL(other.textOffset, path.textOffset);
+
+                BOOST_CHECK_EQUAL(GetGlyphPath(fontData, fontData.mGlyphs.at(c)).pCoords,
+                                  GetGlyphPath(fontData, fontData.mGlyphs.at(characters[0])).pCoords);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(subset_test)
+{
+    FontData full;
+    ParseSVGFontFile("data/sample1.svg", full);
+
+    CharacterSet characters;
+    AddCharacters((const int8_t *)"AVATAR To", characters);
+
+    for (unsigned int nThreads : {1, 4})
+    {
+        FontParseParams params;
+        params.pCharacters = &characters;
+        params.nThreads = nThreads;
+
+        FontData subset;
+        ParseSVGFontFile("data/sample1.svg", subset, params);
+
+        BOOST_CHECK(subset.mPathStore.mCoords.size() < full.mPathStore.mCoords.size());
+        BOOST_CHECK_EQUAL(subset.mHasMissingGlyph, full.mHasMissingGlyph);
+
+        for (const UTF8Char c : characters)
+        {
+            BOOST_REQUIRE_EQUAL(subset.mGlyphs.count(c), full.mGlyphs.count(c));
+            if (full.mGlyphs.count(c) > 0)
+                CheckEqualPaths(GetGlyphPath(full, full.mGlyphs.at(c)), GetGlyphPath(subset, subset.mGlyphs.at(c)));
+        }
+        BOOST_CHECK(subset.mGlyphs.size() <= characters.size());
+
+        // Only the kerning between the characters must remain.
+        size_t nPairs = 0;
+        for (const UTF8Char c1 : characters)
+        {
+            for (const UTF8Char c2 : characters)
+            {
+                double k = GetKernValue(full.mHorizontalKernTable, c1, c2);
+                BOOST_CHECK_EQUAL(GetKernValue(subset.mHorizontalKernTable, c1, c2), k);
+                if (k != 0.0)
+                    nPairs++;
+            }
+        }
+        BOOST_CHECK(nPairs > 0);
+
+        for (const auto &row : subset.mHorizontalKernTable)
+        {
+            BOOST_CHECK(characters.count(row.first) == 1);
+            for (const auto &pair : row.second)
+                BOOST_CHECK(characters.count(pair.first) == 1);
+        }
+    }
+}
+
+/**
+ *  The first hkern names a glyph that follows it, the last one overrides it.
+ */
+const char FORWARD_KERN_SVG[] = R"(<svg><defs><font horiz-adv-x="500">
+<font-face units-per-em="1000" ascent="800" descent="-200" bbox="0 -200 500 800"/>
+<hkern u1="A" g2="gb" k="10"/>
+<hkern u1="B" g2="ga" k="30"/>
+<glyph unicode="A" glyph-name="ga"/>
+<glyph unicode="B" glyph-name="gb"/>
+<hkern u1="A" u2="B" k="20"/>
+</font></defs></svg>)";
+
+BOOST_AUTO_TEST_CASE(forward_kern_test)
+{
+    FontData fontData;
+    ParseSVGFontData(FORWARD_KERN_SVG, strlen(FORWARD_KERN_SVG), fontData);
+
+    BOOST_CHECK_EQUAL(GetKernValue(fontData.mHorizontalKernTable, 'A', 'B'), 20.0);
+    BOOST_CHECK_EQUAL(GetKernValue(fontData.mHorizontalKernTable, 'B', 'A'), 30.0);
+
+    // A name that never comes is still an error.
+    std::string svg = FORWARD_KERN_SVG;
+    svg.replace(svg.find("g2=\"gb\""), 7, "g2=\"gc\"");
+    BOOST_CHECK_THROW(ParseSVGFontData(svg.data(), svg.size(), fontData), FontParseError);
+}
+
+BOOST_AUTO_TEST_CASE(forward_kern_threads_test)
+{
+    FontData sequential;
+    ParseSVGFontData(FORWARD_KERN_SVG, strlen(FORWARD_KERN_SVG), sequential);
+
+    for (unsigned int nThreads : {2, 4, 8})
+    {
+        FontData parallel;
+        FontParseParams params;
+        params.nThreads = nThreads;
+        ParseSVGFontData(FORWARD_KERN_SVG, strlen(FORWARD_KERN_SVG), parallel, params);
+
+        BOOST_CHECK(parallel.mHorizontalKernTable == sequential.mHorizontalKernTable);
+        BOOST_CHECK_EQUAL(GetKernValue(parallel.mHorizontalKernTable, 'A', 'B'), 20.0);
+    }
+}
+
+std::string ReadFile(const char *path)
+{
+    std::ifstream is(path, std::ios::binary);
+    std::stringstream ss;
+    ss << is.rdbuf();
+    return ss.str();
+}
+
+std::string Gzip(const std::string &data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    BOOST_REQUIRE_EQUAL(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY), Z_OK);
+
+    std::string compressed(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = (Bytef *)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *)&compressed[0];
+    stream.avail_out = compressed.size();
+    BOOST_REQUIRE_EQUAL(deflate(&stream, Z_FINISH), Z_STREAM_END);
+
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+void CheckSameFontData(const FontData &fontData1, const FontData &fontData2)
+{
+    BOOST_CHECK(fontData1.mPathStore.mElementTypes == fontData2.mPathStore.mElementTypes);
+    BOOST_CHECK(fontData1.mPathStore.mCoords == fontData2.mPathStore.mCoords);
+
+    BOOST_REQUIRE_EQUAL(fontData1.mGlyphs.size(), fontData2.mGlyphs.size());
+    for (const auto &pair : fontData1.mGlyphs)
+    {
+        const GlyphData &glyph = fontData2.mGlyphs.at(pair.first);
+        BOOST_CHECK_EQUAL(pair.second.mMetrics.advanceX, glyph.mMetrics.advanceX);
+        BOOST_CHECK_EQUAL(pair.second.mPath.firstElement, glyph.mPath.firstElement);
+        BOOST_CHECK_EQUAL(pair.second.mPath.elementCount, glyph.mPath.elementCount);
+    }
+
+    BOOST_CHECK(fontData1.mHorizontalKernTable == fontData2.mHorizontalKernTable);
+}
+
+BOOST_AUTO_TEST_CASE(arena_test)
+{
+    FontData *pParsed = new FontData;
+    ParseSVGFontFile("data/sample1.svg", *pParsed);
+
+    FontData copy(*pParsed),
+             assigned;
+    assigned = *pParsed;
+
+    // The moved maps keep using the arena of the parsed data, after that's gone.
+    FontData moved(std::move(*pParsed));
+    delete pParsed;
+
+    FontData expected;
+    ParseSVGFontFile("data/sample1.svg", expected);
+
+    for (const FontData *pFontData : {&copy, &assigned, &moved})
+    {
+        BOOST_REQUIRE_EQUAL(pFontData->mGlyphs.size(), expected.mGlyphs.size());
+        for (const auto &pair : expected.mGlyphs)
+            CheckEqualPaths(GetGlyphPath(expected, pair.second), GetGlyphPath(*pFontData, pFontData->mGlyphs.at(pair.first)));
+
+        BOOST_REQUIRE_EQUAL(pFontData->mHorizontalKernTable.size(), expected.mHorizontalKernTable.size());
+        for (const auto &row : expected.mHorizontalKernTable)
+        {
+            for (const auto &pair : row.second)
+                BOOST_CHECK_EQUAL(GetKernValue(pFontData->mHorizontalKernTable, row.first, pair.first), pair.second);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gzip_test)
+{
+    std::string svg = ReadFile("data/sample1.svg"),
+                svgz = Gzip(svg);
+    BOOST_CHECK(svgz.size() < svg.size() / 4);
+
+    FontData plain;
+    ParseSVGFontData(svg.data(), svg.size(), plain);
+
+    FontData fromMemory;
+    ParseSVGFontData(svgz.data(), svgz.size(), fromMemory);
+    CheckSameFontData(plain, fromMemory);
+
+    FontData fromStream;
+    std::istringstream is(svgz);
+    ParseSVGFontData(is, fromStream);
+    CheckSameFontData(plain, fromStream);
+
+    const char *path = "test_parse.svgz";
+    std::ofstream(path, std::ios::binary) << svgz;
+    FontData fromFile;
+    ParseSVGFontFile(path, fromFile);
+    CheckSameFontData(plain, fromFile);
+    remove(path);
+
+    // Two members, like 'cat a.gz b.gz' gives.
+    std::string concatenated = Gzip(svg.substr(0, svg.size() / 2)) + Gzip(svg.substr(svg.size() / 2));
+    FontData fromMembers;
+    ParseSVGFontData(concatenated.data(), concatenated.size(), fromMembers);
+    CheckSameFontData(plain, fromMembers);
+
+    FontData truncated;
+    BOOST_CHECK_THROW(ParseSVGFontData(svgz.data(), svgz.size() / 2, truncated), FontParseError);
+}
+
+/**
+ *  Compares the bits and the end of the number to what strtod gives.
+ *  Only reports failures, there are millions of these checks.
+ */
+bool CheckLikeStrtod(const char *text)
+{
+    char *strtodEnd;
+    double expected = strtod(text, &strtodEnd);
+
+    double d = 0.0;
+    const char *end = ParseDouble(text, text + strlen(text), d);
+
+    if (strtodEnd == text)
+    {
+        if (end != NULL)
+            BOOST_ERROR("expected no number in " << text);
+        return end == NULL;
+    }
+    else if (end != strtodEnd)
+    {
+        BOOST_ERROR("wrong end for " << text);
+        return false;
+    }
+    else if (memcmp(&d, &expected, sizeof(double)) != 0)
+    {
+        BOOST_ERROR(text << ": " << d << " != " << expected);
+        return false;
+    }
+
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(number_cases_test)
+{
+    const char *cases[] = {"0", "-0", "+0", "0.0", ".5", "5.", "-.5e1", "1e", "1e+", "1e-5x",
+                           "12345678", "123456789", "1234567812345678", "0.000000001234567812345678",
+                           "12345678123456781234", "123456781234567812345678.5",
+                           "9007199254740993", "9007199254740992.5", "2.2250738585072011e-308",
+                           "4.9406564584124654e-324", "2.4703282292062327e-324", "1e23", "1e-400", "1e400",
+                           "1.7976931348623157e308", "1.7976931348623159e308", "0.1", "0.3", "8.28613",
+                           "-0.460938", "1-2", "1.5.5", "1,2", "", "-", "+", ".", "-.", "e5", "-e5", ".e5"};
+    size_t nFailures = 0;
+    for (const char *text : cases)
+        nFailures += !CheckLikeStrtod(text);
+
+    BOOST_CHECK_EQUAL(nFailures, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(number_end_test)
+{
+    // Mustn't read past the end, not even in the 8 digit fast path.
+    const char text[] = "1234567890123456";
+
+    double d;
+    BOOST_CHECK_EQUAL(ParseDouble(text, text + 5, d), text + 5);
+    BOOST_CHECK_EQUAL(d, 12345.0);
+    BOOST_CHECK_EQUAL(ParseDouble(text, text + 9, d), text + 9);
+    BOOST_CHECK_EQUAL(d, 123456789.0);
+    BOOST_CHECK(ParseDouble(text, text, d) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(number_exhaustive_test)
+{
+    // Every number of up to 6 digits, with the point in every place.
+    size_t nFailures = 0;
+    char text[16];
+    for (int n = 0; n < 1000000; n++)
+    {
+        snprintf(text, sizeof(text), "%06d", n);
+        for (int point = 0; point <= 6; point++)
+        {
+            char withPoint[16];
+            memcpy(withPoint, text, point);
+            withPoint[point] = '.';
+            strcpy(withPoint + point + 1, text + point);
+
+            nFailures += !CheckLikeStrtod(withPoint);
+        }
+    }
+
+    BOOST_CHECK_EQUAL(nFailures, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(number_random_test)
+{
+    std::mt19937_64 random(36);
+    std::uniform_int_distribution<int> digitCounts(1, 25),
+                                       digits(0, 9),
+                                       exponents(-340, 340),
+                                       precisions(1, 17);
+    size_t nFailures = 0;
+    char text[64];
+
+    // Any double must come back as itself.
+    for (int i = 0; i < 200000; i++)
+    {
+        double d;
+        uint64_t bits = random();
+        memcpy(&d, &bits, sizeof(double));
+        if (!std::isfinite(d))
+            continue;
+
+        snprintf(text, sizeof(text), "%.17g", d);
+        nFailures += !CheckLikeStrtod(text);
+
+        snprintf(text, sizeof(text), "%.*g", precisions(random), d);
+        nFailures += !CheckLikeStrtod(text);
+    }
+
+    // Random digits, with the point anywhere, round like strtod.
+    for (int i = 0; i < 200000; i++)
+    {
+        std::string s;
+        int nDigits = digitCounts(random),
+            point = std::uniform_int_distribution<int>(0, nDigits)(random);
+        for (int j = 0; j < nDigits; j++)
+        {
+            if (j == point)
+                s += '.';
+            s += char('0' + digits(random));
+        }
+        if (i % 2)
+            s += "e" + std::to_string(exponents(random));
+
+        nFailures += !CheckLikeStrtod(s.c_str());
+    }
+
+    BOOST_CHECK_EQUAL(nFailures, 0u);
+}
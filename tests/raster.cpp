@@ -0,0 +1,339 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestRaster
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <text-gl/image.h>
+
+#include "style.h"
+
+
+using namespace TextGL;
+
+/**
+ *  Builds a path out of elements, for the rasterizer to fill.
+ */
+class TestPath
+{
+    private:
+        std::vector<uint8_t> types;
+        std::vector<float> coords;
+    public:
+        TestPath &Add(const GlyphPathElementType type, const std::vector<float> &elementCoords)
+        {
+            types.push_back(type);
+            coords.insert(coords.end(), elementCoords.begin(), elementCoords.end());
+            return *this;
+        }
+
+        TestPath &Rectangle(const float left, const float bottom, const float right, const float top)
+        {
+            return Add(ELEMENT_MOVETO, {left, bottom}).Add(ELEMENT_LINETO, {right, bottom})
+                  .Add(ELEMENT_LINETO, {right, top}).Add(ELEMENT_LINETO, {left, top}).Add(ELEMENT_CLOSEPATH, {});
+        }
+
+        GlyphPathView GetView(void) const
+        {
+            return {types.data(), coords.data(), (uint32_t)types.size()};
+        }
+};
+
+std::vector<uint8_t> Rasterize(const TestPath &path, const size_t w, const size_t h, const double scale=1.0)
+{
+    std::vector<uint8_t> coverage(w * h, 0xaa);
+    RasterizePathCoverage(path.GetView(), scale, 0.0, 0.0, w, h, coverage.data(), w);
+    return coverage;
+}
+
+int GetTotal(const std::vector<uint8_t> &coverage)
+{
+    int total = 0;
+    for (uint8_t c : coverage)
+        total += c;
+    return total;
+}
+
+BOOST_AUTO_TEST_CASE(rectangle_test)
+{
+    // Wide enough for the vectorized part and the remainder.
+    TestPath path;
+    path.Rectangle(1.25f, 2.5f, 9.75f, 6.0f);
+    std::vector<uint8_t> coverage = Rasterize(path, 11, 8);
+
+    for (size_t y = 0; y < 8; y++)
+    {
+        double rowCoverage = y == 2 ? 0.5 : (y > 2 && y < 6 ? 1.0 : 0.0);
+        for (size_t x = 0; x < 11; x++)
+        {
+            double columnCoverage = x == 1 || x == 9 ? 0.75 : (x > 1 && x < 9 ? 1.0 : 0.0);
+            BOOST_CHECK_EQUAL((int)coverage[y * 11 + x], (int)(rowCoverage * columnCoverage * 255 + 0.5));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(triangle_test)
+{
+    // Half of the square, split along the diagonal.
+    TestPath path;
+    path.Add(ELEMENT_MOVETO, {0.0f, 0.0f}).Add(ELEMENT_LINETO, {8.0f, 0.0f}).Add(ELEMENT_LINETO, {8.0f, 8.0f});
+    std::vector<uint8_t> coverage = Rasterize(path, 8, 8);
+
+    for (size_t y = 0; y < 8; y++)
+    {
+        for (size_t x = 0; x < 8; x++)
+        {
+            int expected = x > y ? 255 : (x == y ? 128 : 0);
+            BOOST_CHECK_EQUAL((int)coverage[y * 8 + x], expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(nonzero_test)
+{
+    // Two squares going the same way overlap, the overlap stays filled.
+    TestPath same;
+    same.Rectangle(0.0f, 0.0f, 6.0f, 6.0f).Rectangle(2.0f, 2.0f, 8.0f, 8.0f);
+    std::vector<uint8_t> coverage = Rasterize(same, 8, 8);
+    BOOST_CHECK_EQUAL(coverage[3 * 8 + 3], 255);
+    BOOST_CHECK_EQUAL(coverage[7 * 8 + 7], 255);
+    BOOST_CHECK_EQUAL(coverage[7 * 8 + 0], 0);
+
+    // Going the other way, the inner square makes a hole.
+    TestPath hole;
+    hole.Rectangle(0.0f, 0.0f, 8.0f, 8.0f).Rectangle(2.0f, 6.0f, 6.0f, 2.0f);
+    coverage = Rasterize(hole, 8, 8);
+    BOOST_CHECK_EQUAL(coverage[1 * 8 + 1], 255);
+    BOOST_CHECK_EQUAL(coverage[3 * 8 + 3], 0);
+    BOOST_CHECK_EQUAL(GetTotal(coverage), (64 - 16) * 255);
+}
+
+BOOST_AUTO_TEST_CASE(clip_test)
+{
+    // Sticks out on every side: the image must be filled and nothing written outside.
+    TestPath path;
+    path.Rectangle(-5.5f, -3.0f, 12.5f, 20.0f);
+
+    const size_t w = 9, h = 7, stride = 12;
+    std::vector<uint8_t> coverage(stride * h, 0xaa);
+    RasterizePathCoverage(path.GetView(), 1.0, 0.0, 0.0, w, h, coverage.data(), stride);
+
+    for (size_t y = 0; y < h; y++)
+    {
+        for (size_t x = 0; x < stride; x++)
+            BOOST_CHECK_EQUAL(coverage[y * stride + x], x < w ? 255 : 0xaa);
+    }
+
+    // A slanted edge crossing the left side, only the part inside counts.
+    TestPath slanted;
+    slanted.Add(ELEMENT_MOVETO, {-4.0f, 0.0f}).Add(ELEMENT_LINETO, {8.0f, 0.0f})
+           .Add(ELEMENT_LINETO, {8.0f, 8.0f}).Add(ELEMENT_LINETO, {4.0f, 8.0f});
+    coverage = Rasterize(slanted, 8, 8);
+    BOOST_CHECK_CLOSE((double)GetTotal(coverage), (64.0 - 8.0) * 255, 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(circle_test)
+{
+    /* Two half circle arcs and a curve approximation should both cover pi r squared,
+     * less a little for the lines they're cut into, that are up to 0.1 pixel inside.
+     */
+    const float r = 20.0f;
+    TestPath arcs;
+    arcs.Add(ELEMENT_MOVETO, {2.0f, 22.0f})
+        .Add(ELEMENT_ARCTO, {r, r, 0.0f, 1.0f, 1.0f, 42.0f, 22.0f})
+        .Add(ELEMENT_ARCTO, {r, r, 0.0f, 1.0f, 1.0f, 2.0f, 22.0f});
+    BOOST_CHECK_CLOSE(GetTotal(Rasterize(arcs, 44, 44)) / 255.0, M_PI * r * r, 1.0);
+
+    const float k = 0.5522847f * r;
+    TestPath curves;
+    curves.Add(ELEMENT_MOVETO, {2.0f, 22.0f})
+          .Add(ELEMENT_CURVETO, {2.0f, 22.0f + k, 22.0f - k, 42.0f, 22.0f, 42.0f})
+          .Add(ELEMENT_CURVETO, {22.0f + k, 42.0f, 42.0f, 22.0f + k, 42.0f, 22.0f})
+          .Add(ELEMENT_CURVETO, {42.0f, 22.0f - k, 22.0f + k, 2.0f, 22.0f, 2.0f})
+          .Add(ELEMENT_CURVETO, {22.0f - k, 2.0f, 2.0f, 22.0f - k, 2.0f, 22.0f});
+    BOOST_CHECK_CLOSE(GetTotal(Rasterize(curves, 44, 44)) / 255.0, M_PI * r * r, 1.0);
+}
+
+/**
+ *  Analytic coverage must equal the average coverage of smaller pixels.
+ *  Compares every glyph of the font to a rendering 8 times as large, scaled down.
+ */
+void CheckGlyphsLikeSupersampled(const char *fontPath, const double size)
+{
+    FontData fontData;
+    ParseSVGFontFile(fontPath, fontData);
+
+    const int factor = 8;
+    double scale = size / fontData.mMetrics.unitsPerEM;
+    const FontBoundingBox &bbox = fontData.mMetrics.bbox;
+    size_t w = ceil((bbox.right - bbox.left) * scale),
+           h = ceil((bbox.top - bbox.bottom) * scale);
+
+    std::vector<uint8_t> coverage(w * h), large(w * factor * h * factor);
+    size_t nPixels = 0, nDifferent = 0;
+    double totalDifference = 0.0;
+    for (const auto &pair : fontData.mGlyphs)
+    {
+        GlyphPathView path = GetGlyphPath(fontData, pair.second);
+
+        RasterizePathCoverage(path, scale, -bbox.left * scale, -bbox.bottom * scale, w, h, coverage.data(), w);
+        RasterizePathCoverage(path, scale * factor, -bbox.left * scale * factor, -bbox.bottom * scale * factor,
+                              w * factor, h * factor, large.data(), w * factor);
+
+        for (size_t y = 0; y < h; y++)
+        {
+            for (size_t x = 0; x < w; x++)
+            {
+                int sum = 0;
+                for (size_t j = 0; j < factor; j++)
+                    for (size_t i = 0; i < factor; i++)
+                        sum += large[(y * factor + j) * w * factor + x * factor + i];
+
+                int difference = abs(coverage[y * w + x] - sum / (factor * factor));
+                totalDifference += difference;
+                nPixels++;
+
+                // Where outlines cross within a pixel, the two can differ more.
+                if (difference > 32)
+                    nDifferent++;
+            }
+        }
+    }
+
+    BOOST_TEST_MESSAGE(fontPath << ": mean difference " << totalDifference / nPixels << ", "
+                       << nDifferent << " of " << nPixels << " pixels more than 32 off");
+    BOOST_CHECK(totalDifference / nPixels < 0.5);
+    BOOST_CHECK(nDifferent < nPixels / 10000 + 1);
+}
+
+BOOST_AUTO_TEST_CASE(glyphs_test)
+{
+    CheckGlyphsLikeSupersampled("data/sample1.svg", 32.0);
+    CheckGlyphsLikeSupersampled("data/sample2.svg", 32.0);
+}
+
+BOOST_AUTO_TEST_CASE(cairo_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    FontStyle style = MakeFillStyle(32.0);
+    style.rasterizer = RASTERIZER_CAIRO;
+
+    ImageFont *pCairoFont = MakeImageFont(fontData, style);
+    style.rasterizer = RASTERIZER_NATIVE;
+    ImageFont *pNativeFont = MakeImageFont(fontData, style);
+
+    size_t nPixels = 0, nDifferent = 0;
+    double totalDifference = 0.0;
+    for (const auto &pair : fontData.mGlyphs)
+    {
+        const ImageGlyph *pCairoGlyph = pCairoFont->GetGlyph(pair.first),
+                         *pNativeGlyph = pNativeFont->GetGlyph(pair.first);
+
+        size_t w, h, nativeW, nativeH;
+        pCairoGlyph->GetImage()->GetDimensions(w, h);
+        pNativeGlyph->GetImage()->GetDimensions(nativeW, nativeH);
+        BOOST_REQUIRE_EQUAL(w, nativeW);
+        BOOST_REQUIRE_EQUAL(h, nativeH);
+
+        const uint32_t *cairoPixels = (const uint32_t *)pCairoGlyph->GetImage()->GetData(),
+                       *nativePixels = (const uint32_t *)pNativeGlyph->GetImage()->GetData();
+        for (size_t i = 0; i < w * h; i++)
+        {
+            int difference = abs((int)(cairoPixels[i] >> 24) - (int)(nativePixels[i] >> 24));
+            totalDifference += difference;
+            nPixels++;
+
+            if (difference > 64)
+                nDifferent++;
+        }
+    }
+
+    DestroyImageFont(pCairoFont);
+    DestroyImageFont(pNativeFont);
+
+    BOOST_TEST_MESSAGE("mean difference with cairo " << totalDifference / nPixels << ", "
+                       << nDifferent << " of " << nPixels << " pixels more than 64 off");
+    BOOST_CHECK(totalDifference / nPixels < 2.0);
+    BOOST_CHECK(nDifferent < nPixels / 1000 + 1);
+}
+
+BOOST_AUTO_TEST_CASE(cairo_scratch_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    FontStyle style;
+    style.size = 32.0;
+    style.strokeWidth = 2.0;
+    style.fillColor = {1.0, 1.0, 1.0, 1.0};
+    style.strokeColor = {0.0, 0.0, 0.0, 1.0};
+    style.lineJoin = LINEJOIN_ROUND;
+    style.lineCap = LINECAP_ROUND;
+
+    // Glyphs are drawn on the same surface one after the other, at any size.
+    ImageFont *pFont1 = MakeImageFont(fontData, style);
+    style.size = 16.0;
+    ImageFont *pSmallFont = MakeImageFont(fontData, style);
+    style.size = 32.0;
+    ImageFont *pFont2 = MakeImageFont(fontData, style);
+
+    for (const auto &pair : fontData.mGlyphs)
+    {
+        const Image *pImage1 = pFont1->GetGlyph(pair.first)->GetImage(),
+                    *pImage2 = pFont2->GetGlyph(pair.first)->GetImage();
+
+        size_t w, h, w2, h2;
+        pImage1->GetDimensions(w, h);
+        pImage2->GetDimensions(w2, h2);
+        BOOST_REQUIRE_EQUAL(w, w2);
+        BOOST_REQUIRE_EQUAL(h, h2);
+        BOOST_CHECK(memcmp(pImage1->GetData(), pImage2->GetData(), w * h * 4) == 0);
+    }
+
+    DestroyImageFont(pFont1);
+    DestroyImageFont(pSmallFont);
+    DestroyImageFont(pFont2);
+}
+
+BOOST_AUTO_TEST_CASE(cairo_scratch_size_test)
+{
+    FontData fontData;
+    ParseSVGFontFile("data/sample1.svg", fontData);
+
+    FontStyle style;
+    style.strokeWidth = 2.0;
+    style.fillColor = {1.0, 1.0, 1.0, 1.0};
+    style.strokeColor = {0.0, 0.0, 0.0, 1.0};
+    style.lineJoin = LINEJOIN_ROUND;
+    style.lineCap = LINECAP_ROUND;
+
+    // Cairo reports these, even on a thread's first glyph.
+    for (double size : {-16.0, 0.0})
+    {
+        style.size = size;
+        BOOST_CHECK_THROW(MakeImageFont(fontData, style), FontImageError);
+    }
+
+    // A bounding box without width makes empty images.
+    style.size = 32.0;
+    FontData flatData;
+    ParseSVGFontFile("data/sample1.svg", flatData);
+    flatData.mMetrics.bbox.right = flatData.mMetrics.bbox.left;
+
+    ImageFont *pFlatFont = MakeImageFont(flatData, style);
+    size_t w, h;
+    pFlatFont->GetGlyph('A')->GetImage()->GetDimensions(w, h);
+    BOOST_CHECK_EQUAL(w, 0);
+    DestroyImageFont(pFlatFont);
+
+    // The scratch surface recovers.
+    ImageFont *pFont = MakeImageFont(fontData, style);
+    pFont->GetGlyph('A')->GetImage()->GetDimensions(w, h);
+    BOOST_CHECK(w > 0 && h > 0);
+    DestroyImageFont(pFont);
+}
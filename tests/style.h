@@ -0,0 +1,23 @@
+#ifndef FILL_STYLE_H
+#define FILL_STYLE_H
+
+#include <text-gl/font.h>
+
+
+/**
+ *  Only fill, so that the native rasterizer is used.
+ */
+inline TextGL::FontStyle MakeFillStyle(const double size)
+{
+    TextGL::FontStyle style;
+    style.size = size;
+    style.strokeWidth = 0.0;
+    style.fillColor = {1.0, 1.0, 1.0, 1.0};
+    style.strokeColor = {0.0, 0.0, 0.0, 0.0};
+    style.lineJoin = TextGL::LINEJOIN_MITER;
+    style.lineCap = TextGL::LINECAP_BUTT;
+    style.rasterizer = TextGL::RASTERIZER_NATIVE;
+    return style;
+}
+
+#endif  // FILL_STYLE_H
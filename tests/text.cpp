@@ -0,0 +1,637 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TestText
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define SDL_MAIN_HANDLED
+#include <SDL2/SDL.h>
+
+#include <text-gl/text.h>
+
+#include "style.h"
+
+
+using namespace TextGL;
+
+/**
+ *  Layout only needs the metrics, so the glyphs are never rendered.
+ */
+struct SampleFont
+{
+    FontData fontData;
+    ImageFont *pFont;
+
+    SampleFont(void)
+    {
+        ParseSVGFontFile("data/sample1.svg", fontData);
+
+        pFont = MakeLazyImageFont(fontData, MakeFillStyle(16.0));
+    }
+    ~SampleFont(void)
+    {
+        DestroyImageFont(pFont);
+    }
+};
+
+/**
+ *  Texture fonts need a GL context, the window it's made for is never shown.
+ */
+struct GLContext
+{
+    SDL_Window *pWindow;
+    SDL_GLContext context;
+
+    GLContext(void)
+    {
+        SDL_SetMainReady();
+        if (SDL_Init(SDL_INIT_VIDEO) != 0)
+            throw std::runtime_error(SDL_GetError());
+
+        pWindow = SDL_CreateWindow("test_text", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                   64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+        if (pWindow == NULL)
+        {
+            std::string error = SDL_GetError();
+            SDL_Quit();
+            throw std::runtime_error(error);
+        }
+
+        context = SDL_GL_CreateContext(pWindow);
+        if (context == NULL)
+        {
+            std::string error = SDL_GetError();
+            SDL_DestroyWindow(pWindow);
+            SDL_Quit();
+            throw std::runtime_error(error);
+        }
+    }
+    ~GLContext(void)
+    {
+        SDL_GL_DeleteContext(context);
+        SDL_DestroyWindow(pWindow);
+        SDL_Quit();
+    }
+};
+
+struct SampleTextureFont: public SampleFont
+{
+    GLContext glContext;
+    GLTextureFont *pTextureFont;
+
+    SampleTextureFont(void)
+    {
+        pTextureFont = MakeGLTextureFont(pFont);
+    }
+    ~SampleTextureFont(void)
+    {
+        DestroyGLTextureFont(pTextureFont);
+    }
+};
+
+/**
+ *  Remembers where the glyphs and lines went.
+ */
+class TextRecorder: public GLTextLeftToRightIterator
+{
+    public:
+        struct Placement
+        {
+            UTF8Char c;
+            size_t startPosition, endPosition;
+            GLfloat startX, endX, baseY;
+        };
+
+        std::vector<Placement> glyphs, lines;
+    protected:
+        void OnGlyph(const UTF8Char c, const GlyphQuad &, const TextSelectionDetails &details)
+        {
+            glyphs.push_back({c, details.startPosition, details.endPosition, details.startX, details.endX, details.baseY});
+        }
+
+        void OnLine(const TextSelectionDetails &details)
+        {
+            lines.push_back({0, details.startPosition, details.endPosition, details.startX, details.endX, details.baseY});
+        }
+};
+
+void CheckEqualPlacements(const std::vector<TextRecorder::Placement> &placements1,
+                          const std::vector<TextRecorder::Placement> &placements2,
+                          const GLfloat tolerance=0.0f)
+{
+    BOOST_REQUIRE_EQUAL(placements1.size(), placements2.size());
+    for (size_t i = 0; i < placements1.size(); i++)
+    {
+        BOOST_CHECK_EQUAL(placements1[i].c, placements2[i].c);
+        BOOST_CHECK_EQUAL(placements1[i].startPosition, placements2[i].startPosition);
+        BOOST_CHECK_EQUAL(placements1[i].endPosition, placements2[i].endPosition);
+        BOOST_CHECK_SMALL(placements1[i].startX - placements2[i].startX, tolerance + FLT_MIN);
+        BOOST_CHECK_SMALL(placements1[i].endX - placements2[i].endX, tolerance + FLT_MIN);
+        BOOST_CHECK_EQUAL(placements1[i].baseY, placements2[i].baseY);
+    }
+}
+
+/**
+ *  Random words, spaces and line endings, with some characters that have no glyph.
+ */
+std::string MakeRandomText(std::mt19937 &generator, const size_t maxLength)
+{
+    const std::vector<std::string> pieces = {"m", "a", "V", "A", "R", "o", "\xc3\xa9", "\xd0\x96", "\xe2\x82\xac",
+                                             " ", " ", " ", " ", " ", "  ", "\t", "\n", "\r", "\r\n"};
+
+    std::uniform_int_distribution<size_t> pieceDistribution(0, pieces.size() - 1),
+                                          lengthDistribution(0, maxLength);
+
+    std::string text;
+    for (size_t length = lengthDistribution(generator); text.size() < length;)
+        text += pieces[pieceDistribution(generator)];
+    return text;
+}
+
+TextParams MakeParams(const GLfloat maxWidth, const TextAlign align=TEXTALIGN_LEFT)
+{
+    TextParams params;
+    params.startX = 0.0f;
+    params.startY = 0.0f;
+    params.maxWidth = maxWidth;
+    params.lineSpacing = 20.0f;
+    params.align = align;
+    return params;
+}
+
+size_t CountLines(const Font *pFont, const std::string &text, const GLfloat maxWidth=FLT_MAX)
+{
+    return CountLines(pFont, (const int8_t *)text.c_str(), MakeParams(maxWidth));
+}
+
+/**
+ *  Decodes nothing, only counts "\n", "\r\n" and "\r" and whether text follows the last one.
+ */
+size_t CountLineEndings(const std::string &text)
+{
+    size_t count = 0, i = 0;
+    bool textAfter = false;
+    while (i < text.size())
+    {
+        if (text[i] == '\r' || text[i] == '\n')
+        {
+            count++;
+            textAfter = false;
+            i += (text[i] == '\r' && (i + 1) < text.size() && text[i + 1] == '\n') ? 2 : 1;
+        }
+        else
+        {
+            textAfter = true;
+            i++;
+        }
+    }
+
+    return count + (textAfter ? 1 : 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(line_ending_test, SampleFont)
+{
+    BOOST_CHECK_EQUAL(CountLines(pFont, ""), 0);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a"), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a\n"), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a\nb"), 2);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a\rb"), 2);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a\r\nb"), 2);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a\n\rb"), 3);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a\r\rb"), 3);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a\n\nb"), 3);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "\r"), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "\r\n"), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "\r\n\r\n"), 2);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a\r\n\r\nb\r"), 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(spaces_test, SampleFont)
+{
+    BOOST_CHECK_EQUAL(CountLines(pFont, "   "), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "\t"), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "a \t  \t b"), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "  \n  "), 2);
+
+    // One word fits on a line, two don't.
+    const GlyphMetrics *pMetrics = pFont->GetGlyphMetrics('m');
+    GLfloat wordWidth = 2 * pMetrics->advanceX + pFont->GetHorizontalKern('m', 'm'),
+            maxWidth = 1.5f * wordWidth;
+
+    BOOST_CHECK_EQUAL(CountLines(pFont, "mm", maxWidth), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "mm mm", maxWidth), 2);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "mm\tmm", maxWidth), 2);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "mm mm\tmm", maxWidth), 3);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "mm     mm\t\t mm"), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "   mm   ", maxWidth), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, "mm \r\n mm \r mm", maxWidth), 3);
+    BOOST_CHECK_THROW(CountLines(pFont, "mmmm", maxWidth), TextFormatError);
+}
+
+/**
+ *  The text is scanned 16 bytes at a time, the last (length % 16) bytes one at a time.
+ *  Moving the break through the text puts it in either loop and across block edges.
+ */
+BOOST_FIXTURE_TEST_CASE(block_boundary_test, SampleFont)
+{
+    // Some of these end in a byte that only differs from a break character in the high bit.
+    const std::vector<std::string> fillers = {"m", "\xc2\xa0", "\xc2\x89", "\xc2\x8a", "\xc2\x8d",
+                                              "\xe2\x82\xa0", "\xd0\x96", "\xf0\x9f\x98\x80"};
+    const std::vector<std::string> breaks = {" ", "\t", "   ", "\n", "\r", "\r\n", "\n\r"};
+
+    for (const std::string &filler : fillers)
+    {
+        for (const std::string &b : breaks)
+        {
+            for (size_t offset = 0; offset < 80; offset++)
+            {
+                std::string text;
+                while (text.size() < offset)
+                    text += filler;
+
+                // Growing the text moves the break from the byte loop into the blocks.
+                text += b + "mm";
+                for (size_t n = 0; n < 16; n++)
+                {
+                    BOOST_CHECK_EQUAL(CountLines(pFont, text), CountLineEndings(text));
+                    text += filler;
+                }
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(random_text_test, SampleFont)
+{
+    const std::vector<std::string> pieces = {"m", "a", "\xc3\xa9", "\xd0\x96", "\xe2\x82\xac", "\xf0\x9f\x98\x80",
+                                             " ", "  ", "\t", "\n", "\r", "\r\n"};
+
+    std::mt19937 generator(27);
+    std::uniform_int_distribution<size_t> pieceDistribution(0, pieces.size() - 1),
+                                          lengthDistribution(0, 100);
+
+    for (size_t n = 0; n < 2000; n++)
+    {
+        std::string text;
+        for (size_t length = lengthDistribution(generator); text.size() < length;)
+            text += pieces[pieceDistribution(generator)];
+
+        BOOST_CHECK_EQUAL(CountLines(pFont, text), CountLineEndings(text));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(word_cache_count_test, SampleTextureFont)
+{
+    const int8_t *text = (const int8_t *)"the cat saw the dog and the cat";
+    TextParams params = MakeParams(FLT_MAX);
+
+    // The words include the spaces before them: "the", " cat", " saw", " the", " dog", " and".
+    WordWidthCache cache(100);
+    BOOST_CHECK_EQUAL(CountLines(pTextureFont, text, params, &cache), 1);
+    BOOST_CHECK_EQUAL(cache.GetMissCount(), 6);
+    BOOST_CHECK_EQUAL(cache.GetHitCount(), 2);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 6);
+
+    // Drawing after counting finds every word.
+    TextRecorder cached, uncached;
+    cached.IterateText(pTextureFont, text, params, &cache);
+    BOOST_CHECK_EQUAL(cache.GetMissCount(), 6);
+    BOOST_CHECK_EQUAL(cache.GetHitCount(), 10);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 6);
+
+    uncached.IterateText(pTextureFont, text, params);
+    CheckEqualPlacements(cached.lines, uncached.lines);
+    CheckEqualPlacements(cached.glyphs, uncached.glyphs);
+
+    cache.ResetCounts();
+    BOOST_CHECK_EQUAL(cache.GetMissCount(), 0);
+    BOOST_CHECK_EQUAL(cache.GetHitCount(), 0);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 6);
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.GetSize(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(word_cache_equal_test, SampleTextureFont)
+{
+    std::mt19937 generator(28);
+    std::uniform_real_distribution<GLfloat> widthDistribution(200.0f, 500.0f);
+
+    // Small enough to evict, while the texts are laid out.
+    WordWidthCache cache(20);
+    for (size_t n = 0; n < 200; n++)
+    {
+        std::string text = MakeRandomText(generator, 200);
+        TextParams params = MakeParams(widthDistribution(generator), TEXTALIGN_CENTER);
+
+        BOOST_CHECK_EQUAL(CountLines(pTextureFont, (const int8_t *)text.c_str(), params, &cache),
+                          CountLines(pTextureFont, (const int8_t *)text.c_str(), params));
+
+        TextRecorder cached, uncached;
+        cached.IterateText(pTextureFont, (const int8_t *)text.c_str(), params, &cache);
+        uncached.IterateText(pTextureFont, (const int8_t *)text.c_str(), params);
+        CheckEqualPlacements(cached.lines, uncached.lines);
+        CheckEqualPlacements(cached.glyphs, uncached.glyphs);
+
+        BOOST_CHECK(cache.GetSize() <= 20);
+    }
+    BOOST_CHECK(cache.GetHitCount() > 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(word_cache_eviction_test, SampleFont)
+{
+    const int8_t *a = (const int8_t *)"a", *b = (const int8_t *)"b", *c = (const int8_t *)"c";
+    GLfloat width;
+
+    WordWidthCache cache(2);
+    cache.Insert(pFont, a, a + 1, 1.0f);
+    cache.Insert(pFont, b, b + 1, 2.0f);
+
+    // Now "b" is the least recently used.
+    BOOST_CHECK(cache.Find(pFont, a, a + 1, width));
+    BOOST_CHECK_EQUAL(width, 1.0f);
+
+    cache.Insert(pFont, c, c + 1, 3.0f);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 2);
+
+    BOOST_CHECK(!cache.Find(pFont, b, b + 1, width));
+    BOOST_CHECK(cache.Find(pFont, a, a + 1, width));
+    BOOST_CHECK_EQUAL(width, 1.0f);
+    BOOST_CHECK(cache.Find(pFont, c, c + 1, width));
+    BOOST_CHECK_EQUAL(width, 3.0f);
+
+    BOOST_CHECK_EQUAL(cache.GetHitCount(), 3);
+    BOOST_CHECK_EQUAL(cache.GetMissCount(), 1);
+
+    // A word's prefix is another word.
+    const int8_t *ab = (const int8_t *)"ab";
+    BOOST_CHECK(!cache.Find(pFont, ab, ab + 2, width));
+}
+
+BOOST_FIXTURE_TEST_CASE(word_cache_zero_test, SampleFont)
+{
+    const int8_t *text = (const int8_t *)"the cat saw the dog";
+    TextParams params = MakeParams(FLT_MAX);
+
+    WordWidthCache cache(0);
+    BOOST_CHECK_EQUAL(CountLines(pFont, text, params, &cache), 1);
+    BOOST_CHECK_EQUAL(CountLines(pFont, text, params, &cache), 1);
+
+    BOOST_CHECK_EQUAL(cache.GetSize(), 0);
+    BOOST_CHECK_EQUAL(cache.GetHitCount(), 0);
+    BOOST_CHECK_EQUAL(cache.GetMissCount(), 10);
+}
+
+BOOST_FIXTURE_TEST_CASE(word_cache_fonts_test, SampleFont)
+{
+    FontStyle style = *(pFont->GetStyle());
+    style.size = 32.0;
+    ImageFont *pLargeFont = MakeLazyImageFont(fontData, style);
+
+    const int8_t *word = (const int8_t *)"mm";
+    GLfloat width,
+            mmWidth = 2 * pFont->GetGlyphMetrics('m')->advanceX + pFont->GetHorizontalKern('m', 'm');
+
+    // The same word is on two lines in the small font, but doesn't fit in the large font.
+    TextParams params = MakeParams(1.5f * mmWidth);
+    WordWidthCache cache(100);
+    BOOST_CHECK_EQUAL(CountLines(pFont, (const int8_t *)"mm mm", params, &cache), 2);
+    BOOST_CHECK_THROW(CountLines(pLargeFont, (const int8_t *)"mm mm", params, &cache), TextFormatError);
+
+    BOOST_REQUIRE(cache.Find(pFont, word, word + 2, width));
+    BOOST_CHECK_CLOSE(width, mmWidth, 1e-4);
+    BOOST_REQUIRE(cache.Find(pLargeFont, word, word + 2, width));
+    BOOST_CHECK_CLOSE(width, 2 * mmWidth, 1e-4);
+
+    DestroyImageFont(pLargeFont);
+}
+
+/**
+ *  Shaping once must lay out the same as the string path, also when characters have no glyph at all.
+ */
+BOOST_FIXTURE_TEST_CASE(shaped_equal_test, SampleTextureFont)
+{
+    fontData.mHasMissingGlyph = false;
+    ImageFont *pNoMissingFont = MakeLazyImageFont(fontData, *(pFont->GetStyle()));
+    GLTextureFont *pNoMissingTextureFont = MakeGLTextureFont(pNoMissingFont);
+
+    std::mt19937 generator(29);
+    std::uniform_real_distribution<GLfloat> widthDistribution(200.0f, 500.0f),
+                                            startDistribution(-100.0f, 100.0f);
+
+    for (const GLTextureFont *pTestFont : {(const GLTextureFont *)pTextureFont, (const GLTextureFont *)pNoMissingTextureFont})
+    {
+        for (TextAlign align : {TEXTALIGN_LEFT, TEXTALIGN_CENTER, TEXTALIGN_RIGHT})
+        {
+            for (size_t n = 0; n < 100; n++)
+            {
+                std::string text = MakeRandomText(generator, 200);
+                TextParams params = MakeParams(widthDistribution(generator), align);
+                params.startX = startDistribution(generator);
+
+                ShapedRun run;
+                ShapeText(pTestFont, (const int8_t *)text.c_str(), run);
+
+                BOOST_CHECK_EQUAL(CountLines(run, params), CountLines(pTestFont, (const int8_t *)text.c_str(), params));
+
+                TextRecorder shaped, unshaped;
+                shaped.IterateText(pTestFont, run, params);
+                unshaped.IterateText(pTestFont, (const int8_t *)text.c_str(), params);
+
+                // The string path adds up kerning in double precision.
+                CheckEqualPlacements(shaped.lines, unshaped.lines, 1e-3f);
+                CheckEqualPlacements(shaped.glyphs, unshaped.glyphs, 1e-3f);
+
+                GLfloat width = 0.0f;
+                for (const TextRecorder::Placement &line : unshaped.lines)
+                    width = std::max(width, line.endX - line.startX);
+                BOOST_CHECK_SMALL(GetTextWidth(run, params) - width, 1e-3f);
+            }
+        }
+    }
+
+    // Left out, without kerning across it.
+    ShapedRun run;
+    ShapeText(pNoMissingTextureFont, (const int8_t *)"R\xe2\x82\xacV", run);
+    BOOST_REQUIRE_EQUAL(run.glyphs.size(), 3);
+    BOOST_CHECK(!run.glyphs[1].hasGlyph);
+    BOOST_CHECK_EQUAL(run.glyphs[1].advance, 0.0f);
+    BOOST_CHECK_EQUAL(run.glyphs[1].kern, 0.0f);
+    BOOST_CHECK(run.glyphs[2].kern != 0.0f);
+    BOOST_CHECK_EQUAL(run.glyphs[2].kern, (GLfloat)pNoMissingTextureFont->GetHorizontalKern('R', 'V'));
+
+    DestroyGLTextureFont(pNoMissingTextureFont);
+    DestroyImageFont(pNoMissingFont);
+}
+
+BOOST_FIXTURE_TEST_CASE(text_width_test, SampleFont)
+{
+    GLfloat mAdvance = pFont->GetGlyphMetrics('m')->advanceX,
+            mmKern = pFont->GetHorizontalKern('m', 'm'),
+            mmWidth = 2 * mAdvance + mmKern;
+
+    ShapedRun run;
+    ShapeText(pFont, (const int8_t *)"", run);
+    BOOST_CHECK_EQUAL(GetTextWidth(run, MakeParams(FLT_MAX)), 0.0f);
+
+    ShapeText(pFont, (const int8_t *)"mm", run);
+    BOOST_CHECK_CLOSE(GetTextWidth(run, MakeParams(FLT_MAX)), mmWidth, 1e-4);
+
+    // The widest line counts, spaces at the start of a line don't.
+    ShapeText(pFont, (const int8_t *)"mm\n   mmmm\r\nmm", run);
+    BOOST_CHECK_CLOSE(GetTextWidth(run, MakeParams(FLT_MAX)), 4 * mAdvance + 3 * mmKern, 1e-4);
+
+    ShapeText(pFont, (const int8_t *)"mm mm mm", run);
+    BOOST_CHECK_CLOSE(GetTextWidth(run, MakeParams(1.5f * mmWidth)), mmWidth, 1e-4);
+    BOOST_CHECK_EQUAL(CountLines(run, MakeParams(1.5f * mmWidth)), 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(hit_test, SampleFont)
+{
+    GLfloat mAdvance = pFont->GetGlyphMetrics('m')->advanceX,
+            mmKern = pFont->GetHorizontalKern('m', 'm'),
+            ascent = pFont->GetMetrics()->ascent;
+
+    // Lines "mmm" (0 to 3) and "m" (5).
+    ShapedRun run;
+    ShapeText(pFont, (const int8_t *)"mmm\nm", run);
+
+    for (TextAlign align : {TEXTALIGN_LEFT, TEXTALIGN_CENTER, TEXTALIGN_RIGHT})
+    {
+        TextParams params = MakeParams(FLT_MAX, align);
+        params.startX = 100.0f;
+
+        // The middle of each line, from top to bottom.
+        GLfloat y0 = ascent - params.lineSpacing / 2,
+                y1 = y0 - params.lineSpacing;
+
+        GLfloat width0 = 3 * mAdvance + 2 * mmKern,
+                x0 = params.startX, x1 = params.startX;
+        if (align == TEXTALIGN_CENTER)
+        {
+            x0 -= width0 / 2;
+            x1 -= mAdvance / 2;
+        }
+        else if (align == TEXTALIGN_RIGHT)
+        {
+            x0 -= width0;
+            x1 -= mAdvance;
+        }
+
+        // Before, on and after the glyphs of the first line.
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x0 - 50.0f, y0), 0);
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x0 + 0.5f * mAdvance, y0), 0);
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x0 + 1.5f * mAdvance + mmKern, y0), 1);
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x0 + 2.5f * mAdvance + 2 * mmKern, y0), 2);
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x0 + width0 + 50.0f, y0), 3);
+
+        // Above the text is on the first line.
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x0 + 0.5f * mAdvance, y0 + 100.0f), 0);
+
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x1 - 50.0f, y1), 4);
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x1 + 0.5f * mAdvance, y1), 4);
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x1 + mAdvance + 50.0f, y1), 5);
+
+        // Below the text is on the last line.
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x1 + 0.5f * mAdvance, y1 - 100.0f), 4);
+        BOOST_CHECK_EQUAL(HitTestText(run, params, x1 + mAdvance + 50.0f, y1 - 100.0f), 5);
+    }
+
+    ShapedRun empty;
+    ShapeText(pFont, (const int8_t *)"", empty);
+    for (TextAlign align : {TEXTALIGN_LEFT, TEXTALIGN_CENTER, TEXTALIGN_RIGHT})
+        BOOST_CHECK_EQUAL(HitTestText(empty, MakeParams(FLT_MAX, align), 0.0f, 0.0f), 0);
+}
+
+BOOST_AUTO_TEST_CASE(fixed_clamp_test)
+{
+    BOOST_CHECK_EQUAL(ToFixed26_6(1.0), 64);
+    BOOST_CHECK_EQUAL(ToFixed26_6(-1.5 / 64), -2);
+    BOOST_CHECK_EQUAL(FromFixed26_6(ToFixed26_6(1000.5)), 1000.5);
+
+    // Beyond about 3.3e7, 26.6 fixed point runs out of bits.
+    BOOST_CHECK_EQUAL(ToFixed26_6(4.0e7), INT32_MAX);
+    BOOST_CHECK_EQUAL(ToFixed26_6(FLT_MAX), INT32_MAX);
+    BOOST_CHECK_EQUAL(ToFixed26_6(-4.0e7), INT32_MIN);
+    BOOST_CHECK_EQUAL(ToFixed26_6(-FLT_MAX), INT32_MIN);
+}
+
+BOOST_FIXTURE_TEST_CASE(fixed_point_test, SampleTextureFont)
+{
+    // At this size, the font's advances and kerning are multiples of 1/4. Rounding them to 1/64 changes nothing.
+    std::mt19937 generator(30);
+    std::uniform_int_distribution<int> widthDistribution(200, 500);
+
+    for (size_t n = 0; n < 200; n++)
+    {
+        std::string text = MakeRandomText(generator, 200);
+
+        ShapedRun run, fixedRun;
+        ShapeText(pTextureFont, (const int8_t *)text.c_str(), run);
+        ShapeText(pTextureFont, (const int8_t *)text.c_str(), fixedRun, true);
+
+        for (GLfloat maxWidth : {widthDistribution(generator) + 0.5f, FLT_MAX})
+        {
+            TextParams params = MakeParams(maxWidth);
+
+            BOOST_CHECK_EQUAL(CountLines(fixedRun, params), CountLines(run, params));
+            BOOST_CHECK_EQUAL(GetTextWidth(fixedRun, params), GetTextWidth(run, params));
+
+            // Only the fixed point start moves the glyphs, all by the same amount.
+            for (TextAlign align : {TEXTALIGN_LEFT, TEXTALIGN_CENTER, TEXTALIGN_RIGHT})
+            {
+                params.align = align;
+                params.startX = 0.0f;
+
+                TextRecorder reference;
+                reference.IterateText(pTextureFont, fixedRun, params);
+                BOOST_CHECK_EQUAL(reference.lines.size(), CountLines(run, params));
+
+                for (GLfloat startX : {0.3f, 100.7f, -20.45f})
+                {
+                    params.startX = startX;
+                    GLfloat shift = FromFixed26_6(ToFixed26_6(startX));
+
+                    TextRecorder shifted;
+                    shifted.IterateText(pTextureFont, fixedRun, params);
+
+                    BOOST_REQUIRE_EQUAL(shifted.glyphs.size(), reference.glyphs.size());
+                    for (size_t i = 0; i < shifted.glyphs.size(); i++)
+                    {
+                        BOOST_CHECK_EQUAL(shifted.glyphs[i].startPosition, reference.glyphs[i].startPosition);
+                        BOOST_CHECK_EQUAL(shifted.glyphs[i].startX - shift, reference.glyphs[i].startX);
+                        BOOST_CHECK_EQUAL(shifted.glyphs[i].endX - shift, reference.glyphs[i].endX);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ *  Paths are only parsed when their glyph is rendered, so the broken one fails in MakeGLTextureFont.
+ */
+BOOST_FIXTURE_TEST_CASE(texture_error_test, GLContext)
+{
+    const std::string svg = "<svg><defs><font horiz-adv-x=\"500\">"
+                            "<font-face units-per-em=\"1000\" ascent=\"800\" descent=\"-200\" bbox=\"0 -200 500 800\"/>"
+                            "<glyph unicode=\"A\" d=\"M 0 0 L 500 0 L 250 700 Z\"/>"
+                            "<glyph unicode=\"B\" d=\"M 0 0 L 500 0 L 500 700 Z\"/>"
+                            "<glyph unicode=\"C\" d=\"M 0 0 A 100 100\"/>"
+                            "<glyph unicode=\"D\" d=\"M 0 0 L 0 700 L 500 350 Z\"/>"
+                            "</font></defs></svg>";
+
+    FontParseParams parseParams;
+    parseParams.lazyPaths = true;
+    FontData fontData;
+    ParseSVGFontData(svg.data(), svg.size(), fontData, parseParams);
+
+    ImageFont *pFont = MakeLazyImageFont(fontData, MakeFillStyle(16.0));
+    BOOST_CHECK_THROW(MakeGLTextureFont(pFont), FontParseError);
+    DestroyImageFont(pFont);
+}
@@ -0,0 +1,123 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <boost/format.hpp>
+
+#include <text-gl/bundle.h>
+
+using namespace TextGL;
+
+
+bool ParseColor(const char *text, Color &color)
+{
+    return sscanf(text, "%f,%f,%f,%f", &color.r, &color.g, &color.b, &color.a) == 4;
+}
+
+void PrintUsage(const char *program)
+{
+    std::cerr << boost::format("Usage: %1% svg_path bundle_path size [options]\n"
+                               "  --fill r,g,b,a           fill color, components from 0 to 1, white by default\n"
+                               "  --stroke width r,g,b,a   stroke width and color, none by default\n"
+                               "  --native                 use the built in rasterizer, for fonts without stroke\n"
+                               "  --padding n              transparent pixels between the glyphs, 1 by default\n"
+                               "  --atlas-size n           maximum width and height of the atlas images, 2048 by default")
+                    % program << std::endl;
+}
+
+/**
+ *  Renders an SVG font in a style, into a bundle for loading with ReadFontBundleFile.
+ */
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    FontStyle style;
+    style.size = atof(argv[3]);
+    style.strokeWidth = 0.0;
+    style.fillColor = {1.0, 1.0, 1.0, 1.0};
+    style.strokeColor = {0.0, 0.0, 0.0, 0.0};
+    style.lineJoin = LINEJOIN_ROUND;
+    style.lineCap = LINECAP_ROUND;
+
+    AtlasParams atlasParams;
+
+    for (int i = 4; i < argc; i++)
+    {
+        bool valid = true;
+        if (strcmp(argv[i], "--fill") == 0 && i + 1 < argc)
+            valid = ParseColor(argv[++i], style.fillColor);
+        else if (strcmp(argv[i], "--stroke") == 0 && i + 2 < argc)
+        {
+            style.strokeWidth = atof(argv[++i]);
+            valid = ParseColor(argv[++i], style.strokeColor);
+        }
+        else if (strcmp(argv[i], "--native") == 0)
+            style.rasterizer = RASTERIZER_NATIVE;
+        else if (strcmp(argv[i], "--padding") == 0 && i + 1 < argc)
+            atlasParams.padding = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--atlas-size") == 0 && i + 1 < argc)
+            atlasParams.maxWidth = atlasParams.maxHeight = atoi(argv[++i]);
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (style.size <= 0.0)
+    {
+        std::cerr << "The size must be positive" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        FontParseParams params;
+        params.nThreads = 0;  // one per core
+
+        FontData fontData;
+        ParseSVGFontFile(argv[1], fontData, params);
+
+        FontBundle bundle;
+        ImageFont *pFont = MakeImageFont(fontData, style);
+        try
+        {
+            MakeFontBundle(pFont, bundle, atlasParams);
+        }
+        catch (...)
+        {
+            DestroyImageFont(pFont);
+            throw;
+        }
+        DestroyImageFont(pFont);
+
+        std::ofstream os(argv[2], std::ios::binary);
+        if (!os.good())
+        {
+            std::cerr << "Error opening " << argv[2] << std::endl;
+            return 1;
+        }
+
+        WriteFontBundle(os, bundle);
+
+        std::cout << boost::format("%1% glyphs on %2% atlas images") % bundle.mGlyphs.size() % bundle.mImages.size()
+                  << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
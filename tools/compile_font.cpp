@@ -0,0 +1,46 @@
+#include <fstream>
+#include <iostream>
+
+#include <boost/format.hpp>
+
+#include <text-gl/font.h>
+
+using namespace TextGL;
+
+
+/**
+ *  Converts an SVG font to the binary format, for loading with ReadBinaryFontFile.
+ */
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << boost::format("Usage: %1% svg_path binary_path") % argv[0] << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        FontParseParams params;
+        params.nThreads = 0;  // one per core
+
+        FontData fontData;
+        ParseSVGFontFile(argv[1], fontData, params);
+
+        std::ofstream os(argv[2], std::ios::binary);
+        if (!os.good())
+        {
+            std::cerr << "Error opening " << argv[2] << std::endl;
+            return 1;
+        }
+
+        WriteBinaryFontData(os, fontData);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}